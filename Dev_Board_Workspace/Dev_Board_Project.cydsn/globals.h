@@ -5,6 +5,18 @@
 
 #include <stdint.h> // For standard types like uint8_t
 
+// Board variant: number of top_plate electrodes. Sensors are read in adjacent
+// pairs (sum in normal mode, difference in shear mode), so it must be even.
+#define SENSOR_COUNT       (8u)
+#define SENSOR_PAIR_COUNT  (SENSOR_COUNT / 2u)
+
+#if (SENSOR_COUNT % 2u) != 0u
+#error "SENSOR_COUNT must be even"
+#endif
+#if defined(CapSense_TOP_PLATE_NUM_SENSORS) && (CapSense_TOP_PLATE_NUM_SENSORS != SENSOR_COUNT)
+#error "SENSOR_COUNT does not match the top_plate widget in the CapSense customizer"
+#endif
+
 // Declare the variable as 'extern'.
 // This tells other files: "This variable exists, but it's defined elsewhere."
 extern volatile uint8_t mode_flag;
@@ -5,6 +5,7 @@
 * Included Headers
 *******************************************************************************/
 #include "project.h"
+#include "globals.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -15,8 +16,9 @@
 #define LED_ON           (0u)
 #define LED_OFF          (1u)
 
-/* Define the size for the serial message buffer */
-#define TX_MESSAGE_SIZE  64
+/* Define the size for the serial message buffer: "\n", mode bit, one value
+*  of up to 6 characters plus separator per pair, "\r", terminating zero */
+#define TX_MESSAGE_SIZE  ((SENSOR_PAIR_COUNT * 7u) + 5u)
 
 /* Calibration Constants */
 #define CALIB_NUM_SAMPLES 50
@@ -32,8 +34,8 @@ void DetectTouchAndDriveLed(void);
 
 
 uint16 raw_count; 
-uint8_t mode_flag = 0; // positive = shear, zero = normal
-int16_t processed_data_array[4];
+volatile uint8_t mode_flag = 0; // positive = shear, zero = normal
+int16_t processed_data_array[SENSOR_PAIR_COUNT];
 
 // Functions
 
@@ -55,7 +57,7 @@ int16_t processed_data_array[4];
  * This function assumes the following are available:
  * - A CapSense widget named "Proximity0" (adjust macro if name is different).
  * - volatile uint8_t mode_flag;
- * - int16_t processed_array[4];
+ * - int16_t processed_array[SENSOR_PAIR_COUNT];
  */
 void Post_Process(void)
 {
@@ -66,7 +68,7 @@ void Post_Process(void)
     if (mode_flag == 0)
     {
 
-        for (i = 0; i < 4; i++)
+        for (i = 0; i < SENSOR_PAIR_COUNT; i++)
         {
              uint8_t base_element_index = i * 2;
             
@@ -81,7 +83,7 @@ void Post_Process(void)
     // --- Mode 1: Read sensor pairs and find the difference ---
     else
     {
-        for (i = 0; i < 4; i++)
+        for (i = 0; i < SENSOR_PAIR_COUNT; i++)
         {
             uint8_t base_element_index = i * 2;
 
@@ -194,12 +196,13 @@ void DetectTouchAndDriveLed(void)
         // Format the string with the mode, electrode index, and processed count
     
         uint mode_bit = (mode_flag == 0) ? 0 : 1;
-        sprintf(txMessage, "\n%u,%d,%d,%d,%d\r", 
-                mode_bit,  
-                processed_data_array[0],
-                processed_data_array[1],
-                processed_data_array[2],
-                processed_data_array[3]);
+        int len = sprintf(txMessage, "\n%u", mode_bit);
+        for (uint8_t i = 0; i < SENSOR_PAIR_COUNT; i++)
+        {
+            len += sprintf(&txMessage[len], ",%d", processed_data_array[i]);
+        }
+        txMessage[len++] = '\r';
+        txMessage[len] = '\0';
         
         // Send the fully formatted string over the UART
         UART_PutString(txMessage);
@@ -0,0 +1,371 @@
+/*******************************************************************************
+* File Name: bench_ingest.c
+*
+* Description: Throughput benchmark for the ingestion library.
+*
+*              Starts N stand-in boards and streams into each one as fast as
+*              the descriptor accepts data, for a fixed time. Each board is a
+*              pseudo-terminal (like a USB serial port) or, with -p, a pipe.
+*              By default every board sends a synthetic mix of
+*              VISUALIZATION_MODE lines, CALIBRATION_MODE rows and binary
+*              frames with occasional corrupted bytes. Recorded captures given
+*              on the command line are replayed in a loop instead.
+*
+*              Usage: bench_ingest [-b boards] [-s seconds] [-t readers] [-p]
+*                                  [-q queue] [recording ...]
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_STREAM_BYTES  (1u << 20)
+
+typedef struct
+{
+    int fd;                     /* write end */
+    const uint8_t *data;
+    size_t length;
+    uint64_t written;
+} bench_writer_t;
+
+static atomic_bool bench_running = true;
+
+
+/*******************************************************************************
+* Function Name: put_frame
+********************************************************************************
+* Summary:
+* Appends a binary frame in the firmware's format (frame.h).
+*******************************************************************************/
+static size_t put_frame(uint8_t *out, uint8_t type, const uint8_t *payload, uint8_t length)
+{
+    uint8_t crc = stream_crc8(stream_crc8(0, type), length);
+    size_t n = 0;
+
+    out[n++] = FRAME_SYNC_0;
+    out[n++] = FRAME_SYNC_1;
+    out[n++] = type;
+    out[n++] = length;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        out[n++] = payload[i];
+        crc = stream_crc8(crc, payload[i]);
+    }
+    out[n++] = crc;
+    return n;
+}
+
+
+/*******************************************************************************
+* Function Name: make_synthetic_stream
+********************************************************************************
+* Summary:
+* Builds a stream that looks like a mix of the firmware's outputs, with one
+* corrupted byte roughly every 64 KiB to exercise resynchronization.
+*******************************************************************************/
+static size_t make_synthetic_stream(uint8_t *out, size_t capacity, unsigned seed)
+{
+    size_t n = 0;
+    unsigned scan = 0;
+
+    while (n + 512 < capacity)
+    {
+        int len;
+
+        if ((scan % 4u) != 3u)
+        {
+            // VISUALIZATION_MODE frame: 8 sensors x 2 modes
+            len = sprintf((char *)&out[n], "\n%d", 1000 + (int)(scan % 97u));
+            for (int i = 1; i < 16; i++)
+            {
+                len += sprintf((char *)&out[n + (size_t)len], ",%d", 1000 + i * 37 + (int)((scan * 7u + (unsigned)i) % 211u));
+            }
+            out[n + (size_t)len++] = '\r';
+            n += (size_t)len;
+        }
+        else
+        {
+            // CALIBRATION_MODE rows and a layout frame
+            static const uint8_t layout[6] = { 1, 8, 2, 1, 4, 8 };
+
+            for (int i = 0; i < 8; i++)
+            {
+                n += (size_t)sprintf((char *)&out[n], "\n%d,%d,%d,%d\r", 1200 + i, (int)(scan & 1u), i, 900 + (int)(scan % 50u) - 25);
+            }
+            n += put_frame(&out[n], FRAME_TYPE_LAYOUT, layout, sizeof(layout));
+        }
+        scan++;
+    }
+
+    for (size_t pos = (seed * 7919u) % 65536u; pos < n; pos += 65536u)
+    {
+        out[pos] ^= 0x5Au;
+    }
+    return n;
+}
+
+
+static uint8_t *load_file(const char *path, size_t *length)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long size;
+
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (size > 0) ? malloc((size_t)size) : NULL;
+    if ((data == NULL) || (fread(data, 1, (size_t)size, f) != (size_t)size))
+    {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *length = (size_t)size;
+    return data;
+}
+
+
+static void *writer_main(void *arg)
+{
+    bench_writer_t *w = arg;
+    size_t pos = 0;
+
+    while (atomic_load_explicit(&bench_running, memory_order_relaxed))
+    {
+        ssize_t put = write(w->fd, w->data + pos, w->length - pos);
+
+        if (put > 0)
+        {
+            w->written += (uint64_t)put;
+            pos += (size_t)put;
+            if (pos == w->length)
+            {
+                pos = 0;
+            }
+        }
+        else if ((put < 0) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            break;
+        }
+    }
+    close(w->fd);
+    return NULL;
+}
+
+
+/*******************************************************************************
+* Function Name: open_board
+********************************************************************************
+* Summary:
+* Creates the stand-in transport of one board and returns its write end. The
+* read end is added to the ingest instance.
+*******************************************************************************/
+static int open_board(ingest_t *ingest, int use_pipe, int index)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "board%02d", index);
+    if (use_pipe)
+    {
+        int fds[2];
+
+        if ((pipe(fds) != 0) || (ingest_add_fd(ingest, fds[0], name) < 0))
+        {
+            return -1;
+        }
+        fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+        return fds[1];
+    }
+    else
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+        if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0) ||
+            (ingest_open(ingest, ptsname(master), 921600) < 0))
+        {
+            return -1;
+        }
+        return master;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    ingest_config_t config = { 0 };
+    int boards = 12;
+    int seconds = 5;
+    int use_pipe = 0;
+    int opt;
+    ingest_t *ingest;
+    bench_writer_t writers[INGEST_MAX_BOARDS];
+    pthread_t writer_threads[INGEST_MAX_BOARDS];
+    uint64_t consumed[INGEST_MAX_BOARDS] = { 0 };
+    uint64_t latency_sum = 0;
+    uint64_t latency_max = 0;
+    uint64_t start;
+    uint64_t deadline;
+    double elapsed;
+
+    while ((opt = getopt(argc, argv, "b:s:t:q:p")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': boards = atoi(optarg); break;
+        case 's': seconds = atoi(optarg); break;
+        case 't': config.reader_threads = (unsigned)atoi(optarg); break;
+        case 'q': config.queue_capacity = (size_t)atol(optarg); break;
+        case 'p': use_pipe = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-b boards] [-s seconds] [-t readers] [-q queue] [-p] [recording ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc)
+    {
+        boards = argc - optind;
+    }
+    if ((boards < 1) || (boards > INGEST_MAX_BOARDS))
+    {
+        fprintf(stderr, "boards must be 1..%d\n", INGEST_MAX_BOARDS);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    ingest = ingest_create(&config);
+    if (ingest == NULL)
+    {
+        fprintf(stderr, "bad configuration (queue must be a power of two)\n");
+        return 1;
+    }
+
+    for (int b = 0; b < boards; b++)
+    {
+        uint8_t *data;
+        size_t length = 0;
+
+        if (optind < argc)
+        {
+            data = load_file(argv[optind + b], &length);
+            if (data == NULL)
+            {
+                fprintf(stderr, "cannot read %s\n", argv[optind + b]);
+                return 1;
+            }
+        }
+        else
+        {
+            data = malloc(BENCH_STREAM_BYTES);
+            length = make_synthetic_stream(data, BENCH_STREAM_BYTES, (unsigned)b);
+        }
+
+        writers[b].fd = open_board(ingest, use_pipe, b);
+        writers[b].data = data;
+        writers[b].length = length;
+        writers[b].written = 0;
+        if (writers[b].fd < 0)
+        {
+            fprintf(stderr, "cannot create board %d: %s\n", b, strerror(errno));
+            return 1;
+        }
+    }
+
+    if (ingest_start(ingest) != 0)
+    {
+        fprintf(stderr, "cannot start readers\n");
+        return 1;
+    }
+    for (int b = 0; b < boards; b++)
+    {
+        pthread_create(&writer_threads[b], NULL, writer_main, &writers[b]);
+    }
+
+    // consumer: drain every board round-robin
+    start = ingest_now_ns();
+    deadline = start + (uint64_t)seconds * 1000000000u;
+    while (ingest_now_ns() < deadline)
+    {
+        int idle = 1;
+
+        for (int b = 0; b < boards; b++)
+        {
+            const stream_record_t *record;
+
+            while ((record = ingest_peek(ingest, b)) != NULL)
+            {
+                uint64_t latency = ingest_now_ns() - record->rx_time_ns;
+
+                latency_sum += latency;
+                if (latency > latency_max)
+                {
+                    latency_max = latency;
+                }
+                consumed[b]++;
+                ingest_release(ingest, b);
+                idle = 0;
+            }
+        }
+        if (idle)
+        {
+            usleep(100);
+        }
+    }
+    elapsed = (double)(ingest_now_ns() - start) / 1e9;
+
+    atomic_store(&bench_running, false);
+    for (int b = 0; b < boards; b++)
+    {
+        pthread_join(writer_threads[b], NULL);
+    }
+    ingest_stop(ingest);
+
+    {
+        uint64_t total_bytes = 0;
+        uint64_t total_messages = 0;
+        uint64_t total_consumed = 0;
+
+        printf("%-10s %12s %12s %10s %8s %8s %8s\n", "board", "MB/s", "msg/s", "dropped", "crc", "syntax", "skipped");
+        for (int b = 0; b < boards; b++)
+        {
+            ingest_board_stats_t s;
+
+            ingest_get_stats(ingest, b, &s);
+            printf("%-10s %12.2f %12.0f %10llu %8llu %8llu %8llu\n", ingest_board_name(ingest, b),
+                   (double)s.bytes / elapsed / 1e6, (double)s.parser.messages / elapsed,
+                   (unsigned long long)s.dropped, (unsigned long long)s.parser.crc_errors,
+                   (unsigned long long)s.parser.syntax_errors, (unsigned long long)s.parser.skipped_bytes);
+            total_bytes += s.bytes;
+            total_messages += s.parser.messages;
+            total_consumed += consumed[b];
+        }
+        printf("total: %.2f MB/s, %.0f msg/s over %d boards, %u reader thread(s), %s\n",
+               (double)total_bytes / elapsed / 1e6, (double)total_messages / elapsed, boards,
+               config.reader_threads ? config.reader_threads : (unsigned)(boards + 3) / 4u,
+               use_pipe ? "pipes" : "ptys");
+        printf("queue latency: mean %.1f us, max %.1f us over %llu records\n",
+               total_consumed ? (double)latency_sum / (double)total_consumed / 1e3 : 0.0,
+               (double)latency_max / 1e3, (unsigned long long)total_consumed);
+    }
+
+    ingest_destroy(ingest);
+    return 0;
+}
+
+
+/* [] END OF FILE */
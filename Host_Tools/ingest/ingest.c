@@ -0,0 +1,515 @@
+/*******************************************************************************
+* File Name: ingest.c
+*
+* Description: Reader threads, per-board queues and serial port setup for the
+*              multi-board ingestion library. See ingest.h.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+#include "spsc_queue.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INGEST_READ_CHUNK   65536
+#define INGEST_MAX_THREADS  INGEST_MAX_BOARDS
+
+typedef struct
+{
+    int fd;
+    char name[64];
+    spsc_queue_t queue;
+    stream_parser_t parser;
+    stream_record_t scratch;            /* parse target while the queue is full */
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t dropped;
+    _Atomic bool eof;
+    /* parser statistics, published by the reader after every block */
+    _Atomic uint64_t stat_messages;
+    _Atomic uint64_t stat_csv_lines;
+    _Atomic uint64_t stat_frames;
+    _Atomic uint64_t stat_crc_errors;
+    _Atomic uint64_t stat_syntax_errors;
+    _Atomic uint64_t stat_skipped;
+} ingest_board_t;
+
+typedef struct
+{
+    ingest_t *owner;
+    unsigned index;
+    pthread_t thread;
+} ingest_reader_t;
+
+struct ingest
+{
+    ingest_config_t config;
+    int board_count;
+    ingest_board_t *boards[INGEST_MAX_BOARDS];
+    unsigned reader_count;
+    ingest_reader_t readers[INGEST_MAX_THREADS];
+    atomic_bool running;
+};
+
+
+uint64_t ingest_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+* Function Name: board_emit
+********************************************************************************
+* Summary:
+* Parser callback: publishes the record just filled and hands back the next
+* free queue slot, or the scratch record if the queue is full.
+*******************************************************************************/
+static stream_record_t *board_emit(void *context, stream_record_t *record)
+{
+    ingest_board_t *board = context;
+    stream_record_t *next;
+
+    if (record == &board->scratch)
+    {
+        atomic_fetch_add_explicit(&board->dropped, 1, memory_order_relaxed);
+    }
+    else
+    {
+        spsc_commit(&board->queue);
+    }
+
+    next = spsc_reserve(&board->queue);
+    return (next != NULL) ? next : &board->scratch;
+}
+
+
+static void board_publish_stats(ingest_board_t *board)
+{
+    const stream_stats_t *s = &board->parser.stats;
+
+    atomic_store_explicit(&board->stat_messages, s->messages, memory_order_relaxed);
+    atomic_store_explicit(&board->stat_csv_lines, s->csv_lines, memory_order_relaxed);
+    atomic_store_explicit(&board->stat_frames, s->frames, memory_order_relaxed);
+    atomic_store_explicit(&board->stat_crc_errors, s->crc_errors, memory_order_relaxed);
+    atomic_store_explicit(&board->stat_syntax_errors, s->syntax_errors, memory_order_relaxed);
+    atomic_store_explicit(&board->stat_skipped, s->skipped_bytes, memory_order_relaxed);
+}
+
+
+/*******************************************************************************
+* Function Name: reader_main
+********************************************************************************
+* Summary:
+* Reader thread: owns boards index, index + readers, ... and parses whatever
+* they have to offer until ingest_stop() is called.
+*******************************************************************************/
+static void *reader_main(void *arg)
+{
+    ingest_reader_t *reader = arg;
+    ingest_t *ingest = reader->owner;
+    struct pollfd fds[INGEST_MAX_BOARDS];
+    ingest_board_t *owned[INGEST_MAX_BOARDS];
+    uint8_t *buffer = malloc(INGEST_READ_CHUNK);
+
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    while (atomic_load_explicit(&ingest->running, memory_order_acquire))
+    {
+        nfds_t count = 0;
+
+        for (int b = (int)reader->index; b < ingest->board_count; b += (int)ingest->reader_count)
+        {
+            if (!atomic_load_explicit(&ingest->boards[b]->eof, memory_order_relaxed))
+            {
+                owned[count] = ingest->boards[b];
+                fds[count].fd = ingest->boards[b]->fd;
+                fds[count].events = POLLIN;
+                fds[count].revents = 0;
+                count++;
+            }
+        }
+        if (count == 0)
+        {
+            break;
+        }
+
+        if (poll(fds, count, ingest->config.poll_timeout_ms) <= 0)
+        {
+            continue;
+        }
+
+        for (nfds_t i = 0; i < count; i++)
+        {
+            ingest_board_t *board = owned[i];
+            ssize_t got;
+
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+            {
+                continue;
+            }
+
+            got = read(board->fd, buffer, INGEST_READ_CHUNK);
+            if (got > 0)
+            {
+                stream_parser_feed(&board->parser, buffer, (size_t)got, ingest_now_ns(),
+                                   board_emit, board);
+                atomic_fetch_add_explicit(&board->bytes, (uint64_t)got, memory_order_relaxed);
+                board_publish_stats(board);
+            }
+            else if ((got == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+            {
+                atomic_store_explicit(&board->eof, true, memory_order_release);
+            }
+        }
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+
+ingest_t *ingest_create(const ingest_config_t *config)
+{
+    ingest_t *ingest = calloc(1, sizeof(*ingest));
+
+    if (ingest == NULL)
+    {
+        return NULL;
+    }
+    if (config != NULL)
+    {
+        ingest->config = *config;
+    }
+    if (ingest->config.queue_capacity == 0)
+    {
+        ingest->config.queue_capacity = 4096;
+    }
+    if (ingest->config.poll_timeout_ms == 0)
+    {
+        ingest->config.poll_timeout_ms = 50;
+    }
+    if ((ingest->config.queue_capacity & (ingest->config.queue_capacity - 1u)) != 0)
+    {
+        free(ingest);
+        return NULL;
+    }
+    atomic_init(&ingest->running, false);
+    return ingest;
+}
+
+
+void ingest_destroy(ingest_t *ingest)
+{
+    if (ingest == NULL)
+    {
+        return;
+    }
+    ingest_stop(ingest);
+    for (int b = 0; b < ingest->board_count; b++)
+    {
+        free(ingest->boards[b]->queue.slots);
+        free(ingest->boards[b]);
+    }
+    free(ingest);
+}
+
+
+/*******************************************************************************
+* Function Name: ingest_add_fd
+********************************************************************************
+* Summary:
+* Adds an already open descriptor as a board. Must be called before
+* ingest_start(). The descriptor is switched to non-blocking mode; the
+* caller keeps ownership and closes it.
+*
+* Return:
+* Board index, or -1 on error.
+*******************************************************************************/
+int ingest_add_fd(ingest_t *ingest, int fd, const char *name)
+{
+    ingest_board_t *board;
+    size_t capacity = ingest->config.queue_capacity;
+    int flags;
+
+    if ((ingest->board_count >= INGEST_MAX_BOARDS) ||
+        atomic_load(&ingest->running))
+    {
+        return -1;
+    }
+
+    board = calloc(1, sizeof(*board));
+    if (board == NULL)
+    {
+        return -1;
+    }
+    board->queue.slots = aligned_alloc(SPSC_CACHE_LINE, capacity * sizeof(stream_record_t));
+    if (board->queue.slots == NULL)
+    {
+        free(board);
+        return -1;
+    }
+    board->queue.mask = capacity - 1u;
+    board->queue.record_size = sizeof(stream_record_t);
+    atomic_init(&board->queue.head, 0);
+    atomic_init(&board->queue.tail, 0);
+
+    board->fd = fd;
+    snprintf(board->name, sizeof(board->name), "%s", (name != NULL) ? name : "board");
+    stream_parser_init(&board->parser, spsc_reserve(&board->queue));
+
+    flags = fcntl(fd, F_GETFL);
+    if (flags >= 0)
+    {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    ingest->boards[ingest->board_count] = board;
+    return ingest->board_count++;
+}
+
+
+static speed_t baud_to_speed(unsigned baud)
+{
+    switch (baud)
+    {
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    case 1000000: return B1000000;
+    default:      return B115200;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: ingest_open
+********************************************************************************
+* Summary:
+* Opens a serial port, FIFO or recorded file and adds it as a board. Terminals
+* are opened for reading and writing (commands) and put in raw 8N1 mode at the
+* requested baud rate. FIFOs and files are opened read-only, so the board
+* reaches end of file when the writer closes the FIFO or the file ends; a FIFO
+* waits here until it has a writer.
+*
+* Return:
+* Board index, or -1 on error.
+*******************************************************************************/
+int ingest_open(ingest_t *ingest, const char *path, unsigned baud)
+{
+    struct stat st;
+    int fd;
+    int board;
+
+    if (stat(path, &st) != 0)
+    {
+        return -1;
+    }
+    if (S_ISCHR(st.st_mode))
+    {
+        fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    }
+    else
+    {
+        // not O_RDWR: a FIFO reader that is also a writer never sees EOF.
+        // Blocking until a writer opens it, or the first read would be EOF.
+        fd = open(path, O_RDONLY | O_NOCTTY);
+        if ((fd >= 0) && (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0))
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (isatty(fd))
+    {
+        struct termios tio;
+
+        if (tcgetattr(fd, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, baud_to_speed(baud));
+            cfsetospeed(&tio, baud_to_speed(baud));
+            tio.c_cflag |= CLOCAL | CREAD;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+
+    board = ingest_add_fd(ingest, fd, path);
+    if (board < 0)
+    {
+        close(fd);
+    }
+    return board;
+}
+
+
+int ingest_start(ingest_t *ingest)
+{
+    unsigned readers = ingest->config.reader_threads;
+
+    if ((ingest->board_count == 0) || atomic_load(&ingest->running))
+    {
+        return -1;
+    }
+    if (readers == 0)
+    {
+        readers = (unsigned)(ingest->board_count + 3) / 4u;
+    }
+    if (readers > (unsigned)ingest->board_count)
+    {
+        readers = (unsigned)ingest->board_count;
+    }
+
+    ingest->reader_count = readers;
+    atomic_store(&ingest->running, true);
+    for (unsigned r = 0; r < readers; r++)
+    {
+        ingest->readers[r].owner = ingest;
+        ingest->readers[r].index = r;
+        if (pthread_create(&ingest->readers[r].thread, NULL, reader_main, &ingest->readers[r]) != 0)
+        {
+            ingest->reader_count = r;
+            ingest_stop(ingest);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+void ingest_stop(ingest_t *ingest)
+{
+    if (!atomic_exchange(&ingest->running, false))
+    {
+        return;
+    }
+    for (unsigned r = 0; r < ingest->reader_count; r++)
+    {
+        pthread_join(ingest->readers[r].thread, NULL);
+    }
+    ingest->reader_count = 0;
+}
+
+
+int ingest_board_count(const ingest_t *ingest)
+{
+    return ingest->board_count;
+}
+
+
+const char *ingest_board_name(const ingest_t *ingest, int board)
+{
+    return ingest->boards[board]->name;
+}
+
+
+/*******************************************************************************
+* Function Name: ingest_write
+********************************************************************************
+* Summary:
+* Writes bytes to a board's descriptor, waiting for room in the driver's
+* transmit buffer if needed.
+*
+* Return:
+* Bytes written, or -1 on error.
+*******************************************************************************/
+ssize_t ingest_write(ingest_t *ingest, int board, const void *data, size_t length)
+{
+    int fd = ingest->boards[board]->fd;
+    const uint8_t *p = data;
+    size_t done = 0;
+
+    while (done < length)
+    {
+        ssize_t n = write(fd, p + done, length - done);
+
+        if (n > 0)
+        {
+            done += (size_t)n;
+        }
+        else if ((n < 0) && (errno == EAGAIN))
+        {
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            poll(&pfd, 1, 10);
+        }
+        else if ((n < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return (ssize_t)done;
+}
+
+
+const stream_record_t *ingest_peek(ingest_t *ingest, int board)
+{
+    return spsc_peek(&ingest->boards[board]->queue);
+}
+
+
+void ingest_release(ingest_t *ingest, int board)
+{
+    spsc_release(&ingest->boards[board]->queue);
+}
+
+
+bool ingest_pop(ingest_t *ingest, int board, stream_record_t *out)
+{
+    const stream_record_t *record = ingest_peek(ingest, board);
+
+    if (record == NULL)
+    {
+        return false;
+    }
+    memcpy(out, record, sizeof(*out));
+    ingest_release(ingest, board);
+    return true;
+}
+
+
+void ingest_get_stats(ingest_t *ingest, int board, ingest_board_stats_t *out)
+{
+    ingest_board_t *b = ingest->boards[board];
+
+    out->bytes = atomic_load_explicit(&b->bytes, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&b->dropped, memory_order_relaxed);
+    out->eof = atomic_load_explicit(&b->eof, memory_order_acquire);
+    out->parser.messages = atomic_load_explicit(&b->stat_messages, memory_order_relaxed);
+    out->parser.csv_lines = atomic_load_explicit(&b->stat_csv_lines, memory_order_relaxed);
+    out->parser.frames = atomic_load_explicit(&b->stat_frames, memory_order_relaxed);
+    out->parser.crc_errors = atomic_load_explicit(&b->stat_crc_errors, memory_order_relaxed);
+    out->parser.syntax_errors = atomic_load_explicit(&b->stat_syntax_errors, memory_order_relaxed);
+    out->parser.skipped_bytes = atomic_load_explicit(&b->stat_skipped, memory_order_relaxed);
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,73 @@
+/*******************************************************************************
+* File Name: ingest.h
+*
+* Description: Host-side ingestion of many sensor boards at once.
+*
+*              Each board is a serial port, pipe or file descriptor. A small
+*              pool of reader threads poll()s the descriptors, parses the
+*              bytes with stream_parser and writes every message straight
+*              into that board's lock-free queue. The application drains the
+*              queues from its own thread(s), one consumer per board.
+*
+*              Readers never wait for the application: when a board's queue is
+*              full the message is counted as dropped and discarded.
+*******************************************************************************/
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "stream_parser.h"
+
+#define INGEST_MAX_BOARDS   64
+
+typedef struct
+{
+    unsigned reader_threads;    /* 0 = one thread per 4 boards */
+    size_t   queue_capacity;    /* records per board, power of two; 0 = 4096 */
+    int      poll_timeout_ms;   /* 0 = 50 ms */
+} ingest_config_t;
+
+typedef struct
+{
+    uint64_t bytes;
+    uint64_t dropped;           /* messages lost to a full queue */
+    bool     eof;
+    stream_stats_t parser;
+} ingest_board_stats_t;
+
+typedef struct ingest ingest_t;
+
+ingest_t *ingest_create(const ingest_config_t *config);
+void      ingest_destroy(ingest_t *ingest);
+
+int  ingest_add_fd(ingest_t *ingest, int fd, const char *name);
+int  ingest_open(ingest_t *ingest, const char *path, unsigned baud);
+
+int  ingest_start(ingest_t *ingest);
+void ingest_stop(ingest_t *ingest);
+
+int  ingest_board_count(const ingest_t *ingest);
+const char *ingest_board_name(const ingest_t *ingest, int board);
+
+/* Sends bytes to a board (commands, time sync pings). Any thread may call
+*  it; it does not interfere with the readers. */
+ssize_t ingest_write(ingest_t *ingest, int board, const void *data, size_t length);
+
+/* Consumer side: peek at the oldest record, then release it */
+const stream_record_t *ingest_peek(ingest_t *ingest, int board);
+void ingest_release(ingest_t *ingest, int board);
+bool ingest_pop(ingest_t *ingest, int board, stream_record_t *out);
+
+void ingest_get_stats(ingest_t *ingest, int board, ingest_board_stats_t *out);
+
+uint64_t ingest_now_ns(void);
+
+#endif /* INGEST_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,80 @@
+/*******************************************************************************
+* File Name: spsc_queue.h
+*
+* Description: Lock-free single-producer / single-consumer ring of fixed-size
+*              records. The producer reserves a slot, fills it in place and
+*              commits it, so records are never copied twice.
+*
+*              Capacity must be a power of two. One reader thread produces,
+*              one application thread consumes.
+*******************************************************************************/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPSC_CACHE_LINE 64
+
+typedef struct
+{
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;   /* next slot to write */
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;   /* next slot to read */
+    _Alignas(SPSC_CACHE_LINE) size_t mask;
+    size_t record_size;
+    unsigned char *slots;
+} spsc_queue_t;
+
+/* Producer: slot to fill, or NULL if the queue is full */
+static inline void *spsc_reserve(spsc_queue_t *q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head - tail > q->mask)
+    {
+        return NULL;
+    }
+    return q->slots + (head & q->mask) * q->record_size;
+}
+
+/* Producer: publish the slot returned by spsc_reserve() */
+static inline void spsc_commit(spsc_queue_t *q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    atomic_store_explicit(&q->head, head + 1u, memory_order_release);
+}
+
+/* Consumer: oldest record, or NULL if empty */
+static inline const void *spsc_peek(spsc_queue_t *q)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail == head)
+    {
+        return NULL;
+    }
+    return q->slots + (tail & q->mask) * q->record_size;
+}
+
+/* Consumer: release the record returned by spsc_peek() */
+static inline void spsc_release(spsc_queue_t *q)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, tail + 1u, memory_order_release);
+}
+
+static inline size_t spsc_count(spsc_queue_t *q)
+{
+    return atomic_load_explicit(&q->head, memory_order_acquire) -
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+#endif /* SPSC_QUEUE_H */
+
+
+/* [] END OF FILE */
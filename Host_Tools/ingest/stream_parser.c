@@ -0,0 +1,319 @@
+/*******************************************************************************
+* File Name: stream_parser.c
+*
+* Description: Resynchronizing parser for mixed CSV / binary sensor streams.
+*              See stream_parser.h.
+*******************************************************************************/
+
+#include "stream_parser.h"
+
+#include <string.h>
+
+enum
+{
+    ST_HUNT = 0,    /* waiting for '\n' or SYNC0 */
+    ST_CSV,         /* inside a CSV line */
+    ST_SYNC1,
+    ST_TYPE,
+    ST_LENGTH,
+    ST_PAYLOAD,
+    ST_CRC
+};
+
+/* INT32 range, for overflow detection while accumulating digits */
+#define CSV_LIMIT   2147483648LL
+
+/* CRC-8, polynomial 0x07 (same as Frame_Crc8Update() in the firmware) */
+static const uint8_t crc8_table[256] =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31,
+    0x24, 0x23, 0x2A, 0x2D, 0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65,
+    0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D, 0xE0, 0xE7, 0xEE, 0xE9,
+    0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1,
+    0xB4, 0xB3, 0xBA, 0xBD, 0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2,
+    0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA, 0xB7, 0xB0, 0xB9, 0xBE,
+    0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16,
+    0x03, 0x04, 0x0D, 0x0A, 0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42,
+    0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A, 0x89, 0x8E, 0x87, 0x80,
+    0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8,
+    0xDD, 0xDA, 0xD3, 0xD4, 0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C,
+    0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44, 0x19, 0x1E, 0x17, 0x10,
+    0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F,
+    0x6A, 0x6D, 0x64, 0x63, 0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B,
+    0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13, 0xAE, 0xA9, 0xA0, 0xA7,
+    0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF,
+    0xFA, 0xFD, 0xF4, 0xF3
+};
+
+
+/*******************************************************************************
+* Function Name: stream_crc8
+********************************************************************************
+* Summary:
+* Folds one byte into the frame CRC.
+*******************************************************************************/
+uint8_t stream_crc8(uint8_t crc, uint8_t value)
+{
+    return crc8_table[crc ^ value];
+}
+
+
+static void csv_begin(stream_parser_t *p)
+{
+    p->state = ST_CSV;
+    p->index = 0;
+    p->negative = 0;
+    p->digits = 0;
+    p->accumulator = 0;
+}
+
+
+/*******************************************************************************
+* Function Name: csv_store
+********************************************************************************
+* Summary:
+* Ends the value being parsed. Returns 0 if the value is empty, out of range
+* or does not fit the record.
+*******************************************************************************/
+static int csv_store(stream_parser_t *p)
+{
+    int64_t value = p->negative ? -p->accumulator : p->accumulator;
+
+    if ((p->digits == 0u) || (p->index >= STREAM_MAX_VALUES) ||
+        (value > (CSV_LIMIT - 1)) || (value < -CSV_LIMIT))
+    {
+        return 0;
+    }
+    p->out->data.values[p->index++] = (int32_t)value;
+    p->negative = 0;
+    p->digits = 0;
+    p->accumulator = 0;
+    return 1;
+}
+
+
+/*******************************************************************************
+* Function Name: abandon
+********************************************************************************
+* Summary:
+* Drops the partial message and restarts from the byte that broke it, which
+* may itself begin the next message.
+*******************************************************************************/
+static void abandon(stream_parser_t *p, uint8_t byte)
+{
+    p->stats.syntax_errors++;
+    if (byte == '\n')
+    {
+        csv_begin(p);
+    }
+    else if (byte == FRAME_SYNC_0)
+    {
+        p->state = ST_SYNC1;
+    }
+    else
+    {
+        p->state = ST_HUNT;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: rescan
+********************************************************************************
+* Summary:
+* Feeds the bytes of a frame that failed its CRC back through the parser. The
+* sync bytes were most likely a coincidence in the data, so a corrupted LEN
+* would otherwise hide the CSV lines and frames within the next 255 bytes.
+* Parsing restarts after SYNC1: the rescanned bytes are strictly fewer each
+* time, so the nesting is bounded.
+*
+* Return:
+* Number of messages emitted.
+*******************************************************************************/
+static size_t rescan(stream_parser_t *p, uint8_t crc_byte, uint64_t rx_time_ns,
+                     stream_emit_fn emit, void *context)
+{
+    uint8_t bytes[FRAME_MAX_PAYLOAD + 3u];
+    size_t length = 0;
+
+    bytes[length++] = p->out->type;
+    bytes[length++] = (uint8_t)p->out->count;
+    memcpy(&bytes[length], p->out->data.payload, p->out->count);
+    length += p->out->count;
+    bytes[length++] = crc_byte;
+
+    p->state = ST_HUNT;
+    return stream_parser_feed(p, bytes, length, rx_time_ns, emit, context);
+}
+
+
+void stream_parser_init(stream_parser_t *parser, stream_record_t *first)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->state = ST_HUNT;
+    parser->out = first;
+}
+
+
+/*******************************************************************************
+* Function Name: stream_parser_feed
+********************************************************************************
+* Summary:
+* Parses a block of received bytes, calling 'emit' for every complete message.
+*
+* Return:
+* Number of messages emitted.
+*******************************************************************************/
+size_t stream_parser_feed(stream_parser_t *p, const uint8_t *data, size_t length,
+                          uint64_t rx_time_ns, stream_emit_fn emit, void *context)
+{
+    size_t emitted = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t byte = data[i];
+
+        switch (p->state)
+        {
+        case ST_HUNT:
+            if (byte == '\n')
+            {
+                csv_begin(p);
+            }
+            else if (byte == FRAME_SYNC_0)
+            {
+                p->state = ST_SYNC1;
+            }
+            else
+            {
+                p->stats.skipped_bytes++;
+            }
+            break;
+
+        case ST_CSV:
+            if ((byte >= '0') && (byte <= '9'))
+            {
+                p->accumulator = (p->accumulator * 10) + (byte - '0');
+                if ((p->accumulator > CSV_LIMIT) || (++p->digits > 10u))
+                {
+                    abandon(p, byte);
+                }
+            }
+            else if ((byte == '-') && (p->digits == 0u) && !p->negative)
+            {
+                p->negative = 1;
+            }
+            else if (byte == ',')
+            {
+                if (!csv_store(p))
+                {
+                    abandon(p, byte);
+                }
+            }
+            else if (byte == '\r')
+            {
+                if ((p->index == 0u) && (p->digits == 0u) && !p->negative)
+                {
+                    p->state = ST_HUNT;     // empty line
+                }
+                else if (!csv_store(p))
+                {
+                    abandon(p, byte);
+                }
+                else
+                {
+                    p->out->kind = STREAM_KIND_CSV;
+                    p->out->type = 0;
+                    p->out->count = p->index;
+                    p->out->rx_time_ns = rx_time_ns;
+                    p->stats.csv_lines++;
+                    p->stats.messages++;
+                    p->out = emit(context, p->out);
+                    emitted++;
+                    p->state = ST_HUNT;
+                }
+            }
+            else
+            {
+                abandon(p, byte);
+            }
+            break;
+
+        case ST_SYNC1:
+            if (byte == FRAME_SYNC_1)
+            {
+                p->state = ST_TYPE;
+            }
+            else
+            {
+                abandon(p, byte);
+            }
+            break;
+
+        case ST_TYPE:
+            p->out->type = byte;
+            p->crc = stream_crc8(0, byte);
+            p->state = ST_LENGTH;
+            break;
+
+        case ST_LENGTH:
+            p->out->count = byte;
+            p->crc = stream_crc8(p->crc, byte);
+            p->index = 0;
+            p->state = (byte == 0u) ? ST_CRC : ST_PAYLOAD;
+            break;
+
+        case ST_PAYLOAD:
+        {
+            // copy as much of the payload as this block holds in one go
+            size_t want = (size_t)(p->out->count - p->index);
+            size_t have = length - i;
+            size_t take = (want < have) ? want : have;
+
+            memcpy(&p->out->data.payload[p->index], &data[i], take);
+            for (size_t k = 0; k < take; k++)
+            {
+                p->crc = stream_crc8(p->crc, data[i + k]);
+            }
+            p->index = (uint16_t)(p->index + take);
+            i += take - 1u;
+            if (p->index == p->out->count)
+            {
+                p->state = ST_CRC;
+            }
+            break;
+        }
+
+        case ST_CRC:
+            if (byte == p->crc)
+            {
+                p->out->kind = STREAM_KIND_FRAME;
+                p->out->rx_time_ns = rx_time_ns;
+                p->stats.frames++;
+                p->stats.messages++;
+                p->out = emit(context, p->out);
+                emitted++;
+                p->state = ST_HUNT;
+            }
+            else
+            {
+                p->stats.crc_errors++;
+                emitted += rescan(p, byte, rx_time_ns, emit, context);
+            }
+            break;
+
+        default:
+            p->state = ST_HUNT;
+            break;
+        }
+    }
+    return emitted;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,81 @@
+/*******************************************************************************
+* File Name: stream_parser.h
+*
+* Description: Resynchronizing byte-stream parser for the sensor UART stream.
+*
+*              Understands both message kinds the firmware sends:
+*                - CSV lines "\n%d,%d,...,%d\r" (CALIBRATION_MODE rows,
+*                  VISUALIZATION_MODE frames and the Dev_Board format)
+*                - binary frames SYNC0 SYNC1 TYPE LEN PAYLOAD CRC8 (frame.h)
+*
+*              The parser keeps no heap state and writes each message straight
+*              into a caller-supplied record. Any byte that does not fit the
+*              grammar drops the partial message and the parser hunts for the
+*              next '\n' or sync byte, so a board that is plugged in mid-line
+*              or corrupts a byte loses only that message. The bytes of a
+*              frame that fails its CRC are parsed again, as its sync may
+*              have been a coincidence in the data.
+*******************************************************************************/
+
+#ifndef STREAM_PARSER_H
+#define STREAM_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+
+/* Most values on one CSV line: 32 sensors in 2 modes */
+#define STREAM_MAX_VALUES   64
+
+#define STREAM_KIND_CSV     1u
+#define STREAM_KIND_FRAME   2u
+
+typedef struct
+{
+    uint64_t rx_time_ns;        /* host receive time of the last byte */
+    uint8_t  kind;              /* STREAM_KIND_CSV or STREAM_KIND_FRAME */
+    uint8_t  type;              /* FRAME_TYPE_* for binary frames */
+    uint16_t count;             /* CSV values or payload bytes */
+    union
+    {
+        int32_t values[STREAM_MAX_VALUES];
+        uint8_t payload[FRAME_MAX_PAYLOAD];
+    } data;
+} stream_record_t;
+
+typedef struct
+{
+    uint64_t messages;          /* complete messages delivered */
+    uint64_t csv_lines;
+    uint64_t frames;
+    uint64_t crc_errors;
+    uint64_t syntax_errors;     /* messages abandoned on an unexpected byte */
+    uint64_t skipped_bytes;     /* bytes discarded while hunting */
+} stream_stats_t;
+
+typedef struct
+{
+    uint8_t  state;
+    uint8_t  negative;
+    uint8_t  digits;
+    uint8_t  crc;
+    uint16_t index;             /* values or payload bytes received */
+    int64_t  accumulator;       /* CSV value being parsed */
+    stream_record_t *out;       /* record being filled */
+    stream_stats_t stats;
+} stream_parser_t;
+
+/* Called for every complete message. Must return the record to fill next
+*  (it may return the same one once it has consumed it). */
+typedef stream_record_t *(*stream_emit_fn)(void *context, stream_record_t *record);
+
+void   stream_parser_init(stream_parser_t *parser, stream_record_t *first);
+size_t stream_parser_feed(stream_parser_t *parser, const uint8_t *data, size_t length,
+                          uint64_t rx_time_ns, stream_emit_fn emit, void *context);
+uint8_t stream_crc8(uint8_t crc, uint8_t value);
+
+#endif /* STREAM_PARSER_H */
+
+
+/* [] END OF FILE */
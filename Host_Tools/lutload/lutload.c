@@ -0,0 +1,339 @@
+/*******************************************************************************
+* File Name: lutload.c
+*
+* Description: Loads linearization tables into a board's flash (firmware
+*              LINEARIZATION, linearize.h).
+*
+*              The table file is CSV, one breakpoint per line:
+*                mode,sensor,count,load
+*              with mode and sensor as in the CALIBRATION_MODE rows, count in
+*              the board's processed counts and load in the output units
+*              (0..65535). Empty lines and lines starting with '#' are
+*              skipped. Breakpoints of a channel may come in any order; they
+*              are sorted by count. To replace a per-unit polynomial, sample
+*              it at LINEARIZE_POINTS counts spread over the range the
+*              channel covers, closer together where it bends most.
+*
+*              Every channel in the file is written and committed in turn,
+*              waiting for the board's LUT_ACK after each command. With -d,
+*              the tables of the channels in the file are removed instead
+*              (count and load may then be left out).
+*
+*              Usage: lutload [-b baud] [-d] port table.csv
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+#include "linearize.h"
+#include "frame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LUTLOAD_ACK_TIMEOUT_NS  (2000000000ull)     /* flash write takes ~20 ms */
+#define LUTLOAD_MAX_CHANNELS    (256)
+
+typedef struct
+{
+    uint8_t  mode;
+    uint8_t  sensor;
+    uint8_t  points;
+    uint16_t counts[LINEARIZE_POINTS];
+    uint16_t loads[LINEARIZE_POINTS];
+} lutload_channel_t;
+
+static const char *const lutload_status_names[] =
+{
+    "ok", "bad channel", "bad length", "bad table", "flash error"
+};
+
+
+/*******************************************************************************
+* Function Name: find_channel
+********************************************************************************
+* Summary:
+* Returns the entry of a channel, adding it if it is new.
+*******************************************************************************/
+static lutload_channel_t *find_channel(lutload_channel_t *channels, int *count, int mode, int sensor)
+{
+    for (int i = 0; i < *count; i++)
+    {
+        if ((channels[i].mode == mode) && (channels[i].sensor == sensor))
+        {
+            return &channels[i];
+        }
+    }
+    if (*count == LUTLOAD_MAX_CHANNELS)
+    {
+        return NULL;
+    }
+    memset(&channels[*count], 0, sizeof(channels[*count]));
+    channels[*count].mode = (uint8_t)mode;
+    channels[*count].sensor = (uint8_t)sensor;
+    return &channels[(*count)++];
+}
+
+
+/*******************************************************************************
+* Function Name: load_table
+********************************************************************************
+* Summary:
+* Reads the CSV file into per-channel breakpoint lists, sorted by count.
+*
+* Return:
+* Number of channels, or -1 after printing the error.
+*******************************************************************************/
+static int load_table(const char *path, lutload_channel_t *channels, int remove)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int count = 0;
+    int number = 0;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        int mode;
+        int sensor;
+        long x = 0;
+        long y = 0;
+        int fields;
+        lutload_channel_t *ch;
+
+        number++;
+        if ((line[0] == '#') || (line[strspn(line, " \t\r\n")] == '\0'))
+        {
+            continue;
+        }
+        fields = sscanf(line, "%d,%d,%ld,%ld", &mode, &sensor, &x, &y);
+        if ((fields < (remove ? 2 : 4)) || (mode < 0) || (mode > 255) || (sensor < 0) || (sensor > 255) ||
+            (x < 0) || (x > 65535) || (y < 0) || (y > 65535))
+        {
+            fprintf(stderr, "%s:%d: expected mode,sensor,count,load\n", path, number);
+            fclose(file);
+            return -1;
+        }
+        ch = find_channel(channels, &count, mode, sensor);
+        if (ch == NULL)
+        {
+            fprintf(stderr, "%s:%d: too many channels\n", path, number);
+            fclose(file);
+            return -1;
+        }
+        if (remove)
+        {
+            continue;
+        }
+        if (ch->points == LINEARIZE_POINTS)
+        {
+            fprintf(stderr, "%s:%d: more than %u breakpoints for mode %d sensor %d\n",
+                    path, number, LINEARIZE_POINTS, mode, sensor);
+            fclose(file);
+            return -1;
+        }
+
+        // insertion sort by count
+        int at = ch->points;
+        while ((at > 0) && (ch->counts[at - 1] > x))
+        {
+            ch->counts[at] = ch->counts[at - 1];
+            ch->loads[at] = ch->loads[at - 1];
+            at--;
+        }
+        ch->counts[at] = (uint16_t)x;
+        ch->loads[at] = (uint16_t)y;
+        ch->points++;
+    }
+    fclose(file);
+
+    for (int i = 0; (i < count) && !remove; i++)
+    {
+        if (channels[i].points < 2u)
+        {
+            fprintf(stderr, "%s: mode %u sensor %u needs at least 2 breakpoints\n",
+                    path, channels[i].mode, channels[i].sensor);
+            return -1;
+        }
+    }
+    return count;
+}
+
+
+/*******************************************************************************
+* Function Name: command
+********************************************************************************
+* Summary:
+* Sends one LUT command and waits for its LUT_ACK, skipping the data the board
+* streams meanwhile.
+*
+* Return:
+* The LUT_ACK status, or -1 on a timeout or write error.
+*******************************************************************************/
+static int command(ingest_t *ingest, uint8_t type, const uint8_t *payload, uint8_t length)
+{
+    uint8_t frame[FRAME_OVERHEAD + FRAME_MAX_PAYLOAD];
+    uint8_t crc = stream_crc8(stream_crc8(0, type), length);
+    size_t n = 0;
+    uint64_t deadline;
+
+    frame[n++] = FRAME_SYNC_0;
+    frame[n++] = FRAME_SYNC_1;
+    frame[n++] = type;
+    frame[n++] = length;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        frame[n++] = payload[i];
+        crc = stream_crc8(crc, payload[i]);
+    }
+    frame[n++] = crc;
+
+    if (ingest_write(ingest, 0, frame, n) != (ssize_t)n)
+    {
+        return -1;
+    }
+
+    deadline = ingest_now_ns() + LUTLOAD_ACK_TIMEOUT_NS;
+    while (ingest_now_ns() < deadline)
+    {
+        stream_record_t record;
+
+        if (!ingest_pop(ingest, 0, &record))
+        {
+            usleep(1000);
+            continue;
+        }
+        if ((record.kind == STREAM_KIND_FRAME) && (record.type == FRAME_TYPE_LUT_ACK) &&
+            (record.count == LINEARIZE_ACK_SIZE) &&
+            (record.data.payload[0] == payload[0]) && (record.data.payload[1] == payload[1]))
+        {
+            return record.data.payload[2];
+        }
+    }
+    return -1;
+}
+
+
+/*******************************************************************************
+* Function Name: report
+********************************************************************************
+* Summary:
+* Prints a failed command.
+*
+* Return:
+* true if the command succeeded.
+*******************************************************************************/
+static bool report(const lutload_channel_t *ch, const char *what, int status)
+{
+    if (status == LINEARIZE_OK)
+    {
+        return true;
+    }
+    fprintf(stderr, "mode %u sensor %u: %s failed: %s\n", ch->mode, ch->sensor, what,
+            (status < 0) ? "no answer (is the board built with LINEARIZATION?)" :
+            ((status < 5) ? lutload_status_names[status] : "unknown status"));
+    return false;
+}
+
+
+int main(int argc, char **argv)
+{
+    ingest_config_t config = { 0 };
+    unsigned baud = 115200;
+    int remove = 0;
+    int opt;
+    int count;
+    int failed = 0;
+    ingest_t *ingest;
+    static lutload_channel_t channels[LUTLOAD_MAX_CHANNELS];
+
+    while ((opt = getopt(argc, argv, "b:d")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': baud = (unsigned)atoi(optarg); break;
+        case 'd': remove = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] [-d] port table.csv\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((argc - optind) != 2)
+    {
+        fprintf(stderr, "usage: %s [-b baud] [-d] port table.csv\n", argv[0]);
+        return 2;
+    }
+
+    count = load_table(argv[optind + 1], channels, remove);
+    if (count < 0)
+    {
+        return 1;
+    }
+
+    ingest = ingest_create(&config);
+    if ((ingest == NULL) || (ingest_open(ingest, argv[optind], baud) < 0) || (ingest_start(ingest) != 0))
+    {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        return 1;
+    }
+
+    for (int c = 0; c < count; c++)
+    {
+        const lutload_channel_t *ch = &channels[c];
+        uint8_t payload[LINEARIZE_WRITE_HEADER + (4u * LINEARIZE_WRITE_POINTS)];
+        bool ok = true;
+
+        payload[0] = ch->mode;
+        payload[1] = ch->sensor;
+
+        for (uint8_t first = 0; ok && (first < ch->points); first += LINEARIZE_WRITE_POINTS)
+        {
+            uint8_t n = (uint8_t)(ch->points - first);
+
+            if (n > LINEARIZE_WRITE_POINTS)
+            {
+                n = LINEARIZE_WRITE_POINTS;
+            }
+            payload[2] = first;
+            for (uint8_t i = 0; i < n; i++)
+            {
+                uint8_t *p = &payload[LINEARIZE_WRITE_HEADER + (4u * i)];
+
+                p[0] = (uint8_t)ch->counts[first + i];
+                p[1] = (uint8_t)(ch->counts[first + i] >> 8);
+                p[2] = (uint8_t)ch->loads[first + i];
+                p[3] = (uint8_t)(ch->loads[first + i] >> 8);
+            }
+            ok = report(ch, "write", command(ingest, FRAME_TYPE_LUT_WRITE, payload,
+                                             (uint8_t)(LINEARIZE_WRITE_HEADER + (4u * n))));
+        }
+
+        if (ok)
+        {
+            payload[2] = ch->points;
+            ok = report(ch, remove ? "remove" : "commit",
+                        command(ingest, FRAME_TYPE_LUT_COMMIT, payload, LINEARIZE_COMMIT_SIZE));
+        }
+        if (ok)
+        {
+            printf("mode %u sensor %u: %s\n", ch->mode, ch->sensor,
+                   remove ? "table removed" : "table stored");
+        }
+        else
+        {
+            failed++;
+        }
+    }
+
+    ingest_stop(ingest);
+    ingest_destroy(ingest);
+    return (failed != 0) ? 1 : 0;
+}
+
+
+/* [] END OF FILE */
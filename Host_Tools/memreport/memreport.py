@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""Static memory report for the PSoC firmware.
+
+Reads the linked ELF and the per-function stack usage (.su files written by
+-fstack-usage next to the object files) and prints:
+
+  - flash and SRAM used, per output section and in total, against the
+    device limits
+  - the largest static objects in SRAM
+  - the worst-case stack depth of main() and of the deepest interrupt
+    handler, from the call graph in the disassembly
+
+Calls through function pointers and functions without a .su entry (library
+and assembly code) cannot be sized; they are listed so the result can be
+judged. Recursion makes the depth unbounded and is reported as such.
+"""
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+SECTION_RE = re.compile(r'^\s*\[\s*\d+\]\s+(\S+)\s+(\S+)\s+([0-9a-f]+)\s+[0-9a-f]+\s+([0-9a-f]+)\s+\S+\s+(\S*)')
+SYMBOL_RE = re.compile(r'^[0-9a-f]+\s+([0-9a-f]+)\s+\S+\s+(\S+)$')
+FUNC_RE = re.compile(r'^[0-9a-f]+ <([^>]+)>:$')
+CALL_RE = re.compile(r'\s(?:bl|blx|b\.w|call|callq|jmp|jmpq)\s+[0-9a-f]+\s+<([^>+]+)>')
+INDIRECT_RE = re.compile(r'\s(?:blx\s+r\d+|call\s+\*|callq\s+\*)')
+
+
+def run(cmd):
+    return subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+
+
+def read_sections(readelf, elf):
+    """Returns [(name, type, addr, size, flags)] of the allocated sections."""
+    sections = []
+    for line in run([readelf, '-S', '-W', elf]).splitlines():
+        m = SECTION_RE.match(line)
+        if m and 'A' in m.group(5):
+            sections.append((m.group(1), m.group(2), int(m.group(3), 16),
+                             int(m.group(4), 16), m.group(5)))
+    return sections
+
+
+def read_stack_usage(su_dirs):
+    """Returns {function: bytes} and the set of functions with dynamic frames."""
+    frames = {}
+    dynamic = set()
+    for d in su_dirs:
+        for path in glob.glob(os.path.join(d, '**', '*.su'), recursive=True):
+            with open(path) as f:
+                for line in f:
+                    parts = line.rstrip('\n').split('\t')
+                    if len(parts) < 3:
+                        continue
+                    name = parts[0].rsplit(':', 1)[-1]
+                    frames[name] = max(frames.get(name, 0), int(parts[1]))
+                    if 'dynamic' in parts[2] and 'bounded' not in parts[2]:
+                        dynamic.add(name)
+    return frames, dynamic
+
+
+def read_call_graph(objdump, elf):
+    """Returns {function: set(callees)} and the set of functions with
+    indirect calls."""
+    graph = {}
+    indirect = set()
+    current = None
+    for line in run([objdump, '-d', '--no-show-raw-insn', elf]).splitlines():
+        m = FUNC_RE.match(line)
+        if m:
+            current = m.group(1)
+            graph.setdefault(current, set())
+            continue
+        if current is None:
+            continue
+        m = CALL_RE.search(line)
+        if m and m.group(1) != current:
+            graph[current].add(m.group(1))
+        elif m:
+            graph[current].add(current)
+        if INDIRECT_RE.search(line):
+            indirect.add(current)
+    return graph, indirect
+
+
+def worst_path(root, graph, frames):
+    """Deepest stack path from root: (bytes, [functions], recursive)."""
+    memo = {}
+
+    def visit(fn, active):
+        if fn in active:
+            return 0, [fn], True
+        if fn in memo:
+            return memo[fn]
+        active.add(fn)
+        best = (0, [], False)
+        for callee in graph.get(fn, ()):
+            depth = visit(callee, active)
+            if depth[0] > best[0] or (depth[2] and not best[2]):
+                best = depth
+        active.discard(fn)
+        result = (frames.get(fn, 0) + best[0], [fn] + best[1], best[2])
+        memo[fn] = result
+        return result
+
+    return visit(root, set())
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('elf')
+    ap.add_argument('--su-dir', action='append', default=[],
+                    help='directory searched for .su files (default: next to the ELF)')
+    ap.add_argument('--cross', default='arm-none-eabi-', help='toolchain prefix')
+    ap.add_argument('--flash-size', type=int, default=32 * 1024)
+    ap.add_argument('--ram-size', type=int, default=4 * 1024)
+    ap.add_argument('--ram-base', type=lambda v: int(v, 0), default=0x20000000)
+    ap.add_argument('--entry', default='main')
+    ap.add_argument('--isr-pattern', default=r'(_Handler|_ISR|_Interrupt|Isr)$',
+                    help='regex for interrupt handler names')
+    ap.add_argument('--top', type=int, default=10, help='largest SRAM objects to list')
+    args = ap.parse_args()
+
+    readelf = args.cross + 'readelf'
+    objdump = args.cross + 'objdump'
+    nm = args.cross + 'nm'
+    su_dirs = args.su_dir or [os.path.dirname(os.path.abspath(args.elf))]
+
+    # sections
+    flash = 0
+    ram = 0
+    reserved = 0
+    print('Sections')
+    for name, kind, addr, size, flags in read_sections(readelf, args.elf):
+        in_ram = addr >= args.ram_base
+        if in_ram:
+            if name in ('.stack', '.heap'):
+                reserved += size
+            else:
+                ram += size
+            if kind != 'NOBITS':
+                flash += size       # initial values are copied from flash
+        else:
+            flash += size
+        print('  %-24s %-6s %8d' % (name, 'SRAM' if in_ram else 'flash', size))
+    print()
+    print('Flash  %6d of %6d bytes (%5.1f%%)' % (flash, args.flash_size, 100.0 * flash / args.flash_size))
+    print('SRAM   %6d of %6d bytes (%5.1f%%) static, %d reserved for stack/heap'
+          % (ram, args.ram_size, 100.0 * ram / args.ram_size, reserved))
+    print()
+
+    # largest static objects
+    objects = []
+    for line in run([nm, '-S', '--size-sort', args.elf]).splitlines():
+        m = SYMBOL_RE.match(line)
+        if m and line.split()[2] in 'bBdD':
+            objects.append((int(m.group(1), 16), m.group(2)))
+    if objects:
+        print('Largest SRAM objects')
+        for size, name in sorted(objects, reverse=True)[:args.top]:
+            print('  %-40s %6d' % (name, size))
+        print()
+
+    # stack
+    frames, dynamic = read_stack_usage(su_dirs)
+    graph, indirect = read_call_graph(objdump, args.elf)
+    if not frames:
+        print('No .su files found: build with -fstack-usage to get the stack depth')
+        return 0
+
+    depth, path, recursive = worst_path(args.entry, graph, frames)
+    isr_re = re.compile(args.isr_pattern)
+    isr_best = (0, [], False)
+    for fn in graph:
+        if isr_re.search(fn):
+            candidate = worst_path(fn, graph, frames)
+            if candidate[0] > isr_best[0]:
+                isr_best = candidate
+
+    print('Worst-case stack')
+    print('  %-10s %6d bytes%s  %s' % (args.entry, depth, ' (recursive, unbounded)' if recursive else '',
+                                      ' > '.join(path)))
+    if isr_best[1]:
+        print('  %-10s %6d bytes%s  %s' % ('interrupt', isr_best[0],
+                                          ' (recursive, unbounded)' if isr_best[2] else '',
+                                          ' > '.join(isr_best[1])))
+    print('  %-10s %6d bytes (plus 32 bytes of exception frame per nesting level)'
+          % ('total', depth + isr_best[0]))
+
+    reachable = set()
+    stack = [args.entry] + [fn for fn in graph if isr_re.search(fn)]
+    while stack:
+        fn = stack.pop()
+        if fn not in reachable:
+            reachable.add(fn)
+            stack.extend(graph.get(fn, ()))
+    unsized = sorted(fn for fn in reachable if fn not in frames)
+    if unsized:
+        print('  unsized (no .su entry, counted as 0): ' + ', '.join(unsized))
+    for label, names in (('indirect calls in', indirect), ('dynamic frames in', dynamic)):
+        hits = sorted(reachable & names)
+        if hits:
+            print('  %s: %s' % (label, ', '.join(hits)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,274 @@
+/*******************************************************************************
+* File Name: bench_recfile.c
+*
+* Description: Size and seek benchmark of the recording format.
+*
+*              Writes a synthetic CALIBRATION_MODE session of the given
+*              length (two modes, rows with the rate column, presses every
+*              few seconds, the tick counter wrapping as on the board)
+*              through calib_rows and the writer, and reports the write
+*              speed and the size against the CSV text the same rows make.
+*              Then pulls random windows out of it: each query opens the
+*              file, finds the window and decodes every record in it, once
+*              after dropping the file from the page cache (cold) and once
+*              more (warm). -k keeps the file.
+*
+*              Usage: bench_recfile [-H hours] [-r scans_per_s] [-n sensors]
+*                                   [-w window_s] [-q queries] [-k] path
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "recfile.h"
+#include "calib_rows.h"
+#include "clock.h"
+#include "sensor_config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint32_t bench_seed = 12345u;
+
+
+static uint32_t next_random(void)
+{
+    bench_seed = (bench_seed * 1103515245u) + 12345u;
+    return bench_seed >> 8;
+}
+
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+
+/* Characters of "%d" */
+static unsigned int_chars(int32_t v)
+{
+    unsigned n = (v < 0) ? 2u : 1u;
+    uint32_t u = (v < 0) ? (uint32_t)(-(int64_t)v) : (uint32_t)v;
+
+    while (u >= 10u)
+    {
+        u /= 10u;
+        n++;
+    }
+    return n;
+}
+
+
+static bool count_record(void *context, int64_t time_ns, uint8_t key, const int32_t *values)
+{
+    uint64_t *sum = context;
+
+    (void)key;
+    *sum += (uint64_t)time_ns + (uint64_t)values[0];
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: query
+********************************************************************************
+* Summary:
+* Opens the recording and decodes one window.
+*
+* Return:
+* Milliseconds taken, or -1 on error.
+*******************************************************************************/
+static double query(const char *path, double from_s, double window_s, int64_t *records)
+{
+    double t0 = now_s();
+    rec_reader_t *reader = rec_reader_open(path);
+    int64_t start;
+    int64_t unused;
+    uint64_t sum = 0;
+
+    if (reader == NULL)
+    {
+        return -1.0;
+    }
+    rec_reader_chunk_span(reader, 0, &start, &unused);
+    *records = rec_reader_window(reader, start + (int64_t)(from_s * 1e9),
+                                 start + (int64_t)((from_s + window_s) * 1e9), REC_ALL_CHANNELS,
+                                 count_record, &sum);
+    rec_reader_close(reader);
+    return (*records < 0) ? -1.0 : (now_s() - t0) * 1e3;
+}
+
+
+int main(int argc, char **argv)
+{
+    double hours = 24.0;
+    double scan_rate = 250.0;
+    unsigned sensors = 8;
+    double window_s = 60.0;
+    int queries = 20;
+    bool keep = false;
+    const char *path;
+    calib_rows_t rows;
+    calib_scan_t scan;
+    rec_info_t info = { 0 };
+    rec_writer_t *writer;
+    uint64_t scans;
+    uint64_t text_bytes = 0;
+    uint64_t counter = 0;       /* board clock, ticks */
+    uint32_t last_count = 0;
+    double ticks_per_row;
+    double carry = 0.0;
+    struct stat st;
+    double t0;
+    double t1;
+    double cold_sum = 0.0;
+    double cold_max = 0.0;
+    double warm_sum = 0.0;
+    double warm_max = 0.0;
+    int64_t window_records = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:r:n:w:q:k")) != -1)
+    {
+        switch (opt)
+        {
+        case 'H': hours = atof(optarg); break;
+        case 'r': scan_rate = atof(optarg); break;
+        case 'n': sensors = (unsigned)atoi(optarg); break;
+        case 'w': window_s = atof(optarg); break;
+        case 'q': queries = atoi(optarg); break;
+        case 'k': keep = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-H hours] [-r scans_per_s] [-n sensors] [-w window_s] [-q queries] [-k] path\n", argv[0]);
+            return 2;
+        }
+    }
+    if (((argc - optind) != 1) || (hours <= 0.0) || (scan_rate <= 0.0) || (window_s <= 0.0) ||
+        (calib_rows_init(&rows, sensors, 5u) != 0))
+    {
+        fprintf(stderr, "usage: %s [-H hours] [-r scans_per_s] [-n sensors] [-w window_s] [-q queries] [-k] path\n", argv[0]);
+        return 2;
+    }
+    path = argv[optind];
+
+    calib_rows_info(&rows, &info);
+    snprintf(info.source, sizeof(info.source), "bench_recfile");
+    writer = rec_writer_create(path, &info);
+    if (writer == NULL)
+    {
+        fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    scans = (uint64_t)(hours * 3600.0 * scan_rate);
+    ticks_per_row = (double)CLOCK_HZ / scan_rate / (double)sensors;
+    t0 = now_s();
+    for (uint64_t n = 0; n < scans; n++)
+    {
+        uint8_t mode = (uint8_t)(n & 1u);
+        double t = (double)n / scan_rate;
+        double press = fmod(t, 7.0);
+        int32_t load = (press < 1.5) ? (int32_t)(400.0 * sin(press * M_PI / 1.5)) : 0;
+
+        for (unsigned s = 0; s < sensors; s++)
+        {
+            int32_t row[5];
+            uint32_t count;
+
+            // the tick column is a difference of the wrapping My_Time counter
+            carry += ticks_per_row + (double)((int32_t)(next_random() % 3u) - 1);
+            counter += (uint64_t)carry;
+            carry -= floor(carry);
+            count = (uint32_t)(counter % CALIB_TICK_MODULUS);
+
+            row[CALIB_COL_TIME] = (int32_t)(count - last_count);
+            row[CALIB_COL_MODE] = mode;
+            row[CALIB_COL_SENSOR] = (int32_t)s;
+            row[CALIB_COL_VALUE] = 1000 + ((int32_t)s * 50) + ((int32_t)mode * 200) +
+                                   (int32_t)(20.0 * sin(t / 600.0)) + (int32_t)(next_random() % 7u) - 3 +
+                                   ((s < 4u) ? load : load / 3);
+            row[4] = (int32_t)(next_random() % 41u) - 20 + ((press < 1.5) ? load * 2 : 0);
+            last_count = count;
+
+            for (unsigned c = 0; c < 5u; c++)
+            {
+                text_bytes += int_chars(row[c]) + 1u;     /* separators and the line end */
+            }
+            text_bytes += 1u;                               /* "\n...\r" is one more */
+
+            if (calib_rows_add(&rows, row, 5u, &scan) &&
+                (rec_writer_append(writer, scan.time_ns, scan.mode, scan.values) != 0))
+            {
+                fprintf(stderr, "write failed: %s\n", strerror(errno));
+                return 1;
+            }
+        }
+    }
+    if (calib_rows_flush(&rows, &scan))
+    {
+        rec_writer_append(writer, scan.time_ns, scan.mode, scan.values);
+    }
+    if (rec_writer_close(writer) != 0)
+    {
+        fprintf(stderr, "write failed\n");
+        return 1;
+    }
+    t1 = now_s();
+    stat(path, &st);
+
+    printf("%.1f h at %.0f scans/s, %u sensors: %llu scans, %llu rows (%llu partial scans)\n", hours, scan_rate,
+           sensors, (unsigned long long)rows.scans, (unsigned long long)rows.rows, (unsigned long long)rows.partial);
+    printf("CSV text %.1f MB -> recording %.1f MB (%.1fx), %.2f bytes per row\n", (double)text_bytes / 1e6,
+           (double)st.st_size / 1e6, (double)text_bytes / (double)st.st_size, (double)st.st_size / (double)rows.rows);
+    printf("written in %.1f s (%.0f rows/s)\n", t1 - t0, (double)rows.rows / (t1 - t0));
+
+    for (int q = 0; q < queries; q++)
+    {
+        double span = (hours * 3600.0) - window_s;
+        double from = (span > 0.0) ? span * ((double)next_random() / (double)(1u << 24)) : 0.0;
+        int fd = open(path, O_RDONLY);
+        double cold;
+        double warm;
+
+        // drop the file's pages so the first query reads from the disk
+        if (fd >= 0)
+        {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+        cold = query(path, from, window_s, &window_records);
+        warm = query(path, from, window_s, &window_records);
+        if ((cold < 0.0) || (warm < 0.0))
+        {
+            fprintf(stderr, "query failed\n");
+            return 1;
+        }
+        cold_sum += cold;
+        warm_sum += warm;
+        cold_max = (cold > cold_max) ? cold : cold_max;
+        warm_max = (warm > warm_max) ? warm : warm_max;
+    }
+    if (queries > 0)
+    {
+        printf("%.0f s windows (%lld scans): cold mean %.2f ms max %.2f ms, warm mean %.2f ms max %.2f ms\n",
+               window_s, (long long)window_records, cold_sum / queries, cold_max, warm_sum / queries, warm_max);
+    }
+
+    if (!keep)
+    {
+        unlink(path);
+    }
+    return 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,221 @@
+/*******************************************************************************
+* File Name: calib_rows.c
+*
+* Description: CALIBRATION_MODE rows to recording records and back. See
+*              calib_rows.h.
+*******************************************************************************/
+
+#include "calib_rows.h"
+#include "clock.h"
+#include "sensor_config.h"
+
+#include <string.h>
+
+
+/*******************************************************************************
+* Function Name: calib_rows_init
+********************************************************************************
+* Summary:
+* Prepares an assembler for rows of the given shape.
+*
+* Return:
+* 0, or -1 if the shape does not fit a record.
+*******************************************************************************/
+int calib_rows_init(calib_rows_t *rows, unsigned sensors, unsigned columns)
+{
+    memset(rows, 0, sizeof(*rows));
+    if ((sensors == 0u) || (sensors > CALIB_MAX_SENSORS) || ((columns != 4u) && (columns != 5u)))
+    {
+        return -1;
+    }
+    rows->sensors = sensors;
+    rows->columns = columns;
+    rows->channels = sensors * ((columns == 5u) ? 3u : 2u);
+    rows->mode = -1;
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: calib_rows_info
+********************************************************************************
+* Summary:
+* Fills the recording header fields for this shape: channel count, board
+* time base, and the layout descriptor the board itself would send.
+*******************************************************************************/
+void calib_rows_info(const calib_rows_t *rows, rec_info_t *info)
+{
+    info->channels = (uint16_t)rows->channels;
+    info->time_base = REC_TIME_BOARD;
+    memset(info->layout, 0, sizeof(info->layout));
+    info->layout[0] = SENSOR_LAYOUT_VERSION;
+    info->layout[1] = (uint8_t)rows->sensors;
+    info->layout[2] = SENSOR_MODE_COUNT;
+    info->layout[3] = CALIB_STREAM_FORMAT;
+    info->layout[4] = (uint8_t)rows->columns;
+    info->layout[5] = (uint8_t)rows->sensors;
+}
+
+
+/*******************************************************************************
+* Function Name: calib_rows_finish
+********************************************************************************
+* Summary:
+* Hands out the scan being assembled.
+*******************************************************************************/
+static void calib_rows_finish(calib_rows_t *rows, calib_scan_t *out)
+{
+    int64_t ticks = rows->ticks;
+
+    // split so that days of ticks do not overflow the ns product
+    out->time_ns = ((ticks / CLOCK_HZ) * 1000000000) + (((ticks % CLOCK_HZ) * 1000000000) / CLOCK_HZ);
+    out->mode = (uint8_t)rows->mode;
+    memcpy(out->values, rows->scan, rows->channels * sizeof(int32_t));
+    memcpy(rows->last[rows->mode], rows->scan, rows->channels * sizeof(int32_t));
+
+    rows->scans++;
+    if (rows->have < rows->sensors)
+    {
+        rows->partial++;
+    }
+    rows->mode = -1;
+}
+
+
+/*******************************************************************************
+* Function Name: calib_rows_add
+********************************************************************************
+* Summary:
+* Adds one row. A scan is complete when its last sensor arrives, or when a
+* row of another scan shows that the rest of it was lost.
+*
+* Return:
+* true if *out holds a completed scan.
+*******************************************************************************/
+bool calib_rows_add(calib_rows_t *rows, const int32_t *row, unsigned count, calib_scan_t *out)
+{
+    bool completed = false;
+    int32_t mode;
+    int32_t sensor;
+    int64_t dt;
+
+    rows->rows++;
+    if (count != rows->columns)
+    {
+        rows->bad_rows++;
+        return false;
+    }
+    mode = row[CALIB_COL_MODE];
+    sensor = row[CALIB_COL_SENSOR];
+    if ((mode < 0) || (mode >= REC_MAX_KEYS) || (sensor < 0) || ((unsigned)sensor >= rows->sensors))
+    {
+        rows->bad_rows++;
+        return false;
+    }
+
+    if ((rows->mode >= 0) && ((mode != rows->mode) || ((unsigned)sensor < rows->next_sensor)))
+    {
+        calib_rows_finish(rows, out);
+        completed = true;
+    }
+    if (rows->mode < 0)
+    {
+        rows->mode = mode;
+        rows->have = 0;
+        memcpy(rows->scan, rows->last[mode], rows->channels * sizeof(int32_t));
+        memset(&rows->scan[rows->sensors], 0, rows->sensors * sizeof(int32_t));
+    }
+
+    dt = row[CALIB_COL_TIME];
+    if (dt < 0)
+    {
+        dt += CALIB_TICK_MODULUS;
+    }
+    rows->ticks += (dt > 0) ? dt : 0;
+
+    rows->scan[sensor] = row[CALIB_COL_VALUE];
+    rows->scan[rows->sensors + (unsigned)sensor] = row[CALIB_COL_TIME];
+    if (rows->columns == 5u)
+    {
+        rows->scan[(2u * rows->sensors) + (unsigned)sensor] = row[4];
+    }
+    rows->have++;
+    rows->next_sensor = (unsigned)sensor + 1u;
+
+    // a scan that is already complete waits for the next row when this
+    // call has handed out the previous one
+    if (!completed && (rows->next_sensor == rows->sensors))
+    {
+        calib_rows_finish(rows, out);
+        completed = true;
+    }
+    return completed;
+}
+
+
+/*******************************************************************************
+* Function Name: calib_rows_flush
+********************************************************************************
+* Summary:
+* Hands out the scan still being assembled, at the end of the input.
+*
+* Return:
+* true if *out holds a scan.
+*******************************************************************************/
+bool calib_rows_flush(calib_rows_t *rows, calib_scan_t *out)
+{
+    if (rows->mode < 0)
+    {
+        return false;
+    }
+    calib_rows_finish(rows, out);
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: calib_rows_layout
+********************************************************************************
+* Summary:
+* Recovers the row shape from a recording's header.
+*
+* Return:
+* false if the recording does not hold CALIBRATION_MODE scans.
+*******************************************************************************/
+bool calib_rows_layout(const rec_info_t *info, unsigned *sensors, unsigned *columns)
+{
+    unsigned s = info->layout[1];
+    unsigned c = info->layout[4];
+
+    if ((info->layout[3] != CALIB_STREAM_FORMAT) || (s == 0u) || (s > CALIB_MAX_SENSORS) ||
+        ((c != 4u) && (c != 5u)) || (info->channels != s * ((c == 5u) ? 3u : 2u)))
+    {
+        return false;
+    }
+    *sensors = s;
+    *columns = c;
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: calib_rows_row
+********************************************************************************
+* Summary:
+* Rebuilds the row of one sensor from a record.
+*******************************************************************************/
+void calib_rows_row(const int32_t *values, uint8_t mode, unsigned sensor, unsigned sensors,
+                    unsigned columns, int32_t *row)
+{
+    row[CALIB_COL_TIME] = values[sensors + sensor];
+    row[CALIB_COL_MODE] = mode;
+    row[CALIB_COL_SENSOR] = (int32_t)sensor;
+    row[CALIB_COL_VALUE] = values[sensor];
+    if (columns == 5u)
+    {
+        row[4] = values[(2u * sensors) + sensor];
+    }
+}
+
+
+/* [] END OF FILE */
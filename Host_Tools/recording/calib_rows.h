@@ -0,0 +1,80 @@
+/*******************************************************************************
+* File Name: calib_rows.h
+*
+* Description: Mapping between CALIBRATION_MODE rows and recording records.
+*
+*              The board sends one row per sensor and scan:
+*                ticks, mode, sensor, value [, window | rate]
+*              (CALIB_COL_* in sensor_config.h). The rows of one scan become
+*              one record whose key is the mode and whose channels are
+*              planes of one column per sensor:
+*                [0, S)     value
+*                [S, 2S)    ticks column as sent
+*                [2S, 3S)   fifth column, if the log has one
+*              so a recording converts back to the exact rows. The record
+*              time is the board time at the end of the scan, the sum of the
+*              tick columns (counter wraps undone) at CLOCK_HZ.
+*
+*              A scan with rows missing (lost bytes, a log that starts
+*              mid-scan) is written with the missing values repeated from
+*              that mode's previous scan and a tick column of 0, and
+*              counted as partial.
+*******************************************************************************/
+
+#ifndef CALIB_ROWS_H
+#define CALIB_ROWS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "recfile.h"
+
+#define CALIB_MAX_SENSORS       (REC_MAX_CHANNELS / 3)
+
+/* My_Time_TC_PERIOD_VALUE + 1: a negative tick column is a counter wrap */
+#define CALIB_TICK_MODULUS      (10001)
+
+/* SENSOR_STREAM_FORMAT of CALIBRATION_MODE (sensor_config.h) */
+#define CALIB_STREAM_FORMAT     (1u)
+
+typedef struct
+{
+    unsigned sensors;
+    unsigned columns;           /* 4 or 5 */
+    unsigned channels;
+    int64_t  ticks;             /* board time at the last row */
+
+    int      mode;              /* scan being assembled, -1 if none */
+    unsigned next_sensor;
+    unsigned have;              /* rows of it received */
+    int32_t  scan[REC_MAX_CHANNELS];
+    int32_t  last[REC_MAX_KEYS][REC_MAX_CHANNELS];
+
+    uint64_t rows;
+    uint64_t scans;
+    uint64_t partial;
+    uint64_t bad_rows;
+} calib_rows_t;
+
+/* A completed scan */
+typedef struct
+{
+    int64_t time_ns;
+    uint8_t mode;
+    int32_t values[REC_MAX_CHANNELS];
+} calib_scan_t;
+
+int  calib_rows_init(calib_rows_t *rows, unsigned sensors, unsigned columns);
+void calib_rows_info(const calib_rows_t *rows, rec_info_t *info);
+bool calib_rows_add(calib_rows_t *rows, const int32_t *row, unsigned count, calib_scan_t *out);
+bool calib_rows_flush(calib_rows_t *rows, calib_scan_t *out);
+
+/* Reverse direction: layout of a recording, and the rows of one record */
+bool calib_rows_layout(const rec_info_t *info, unsigned *sensors, unsigned *columns);
+void calib_rows_row(const int32_t *values, uint8_t mode, unsigned sensor, unsigned sensors,
+                    unsigned columns, int32_t *row);
+
+#endif /* CALIB_ROWS_H */
+
+
+/* [] END OF FILE */
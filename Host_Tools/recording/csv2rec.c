@@ -0,0 +1,239 @@
+/*******************************************************************************
+* File Name: csv2rec.c
+*
+* Description: Converts CALIBRATION_MODE CSV logs into a recording.
+*
+*              Reads the board's rows ("ticks,mode,sensor,value[,x]", one
+*              per line, as a terminal program logs them) from the files
+*              given, or from standard input with "-", and writes one record
+*              per scan (calib_rows.h). The column count is taken from the
+*              first row; lines that are not rows of that shape are counted
+*              and skipped.
+*
+*              Reading standard input straight from a configured serial
+*              port records live; Ctrl-C then ends the recording cleanly.
+*
+*              Usage: csv2rec [-n sensors] [-c chunk_records] out.rec
+*                             [log.csv ... | -]
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "recfile.h"
+#include "calib_rows.h"
+#include "clock.h"
+#include "sensor_config.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CSV2REC_LINE_MAX    256
+
+static volatile sig_atomic_t csv2rec_stop = 0;
+
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    csv2rec_stop = 1;
+}
+
+
+/*******************************************************************************
+* Function Name: parse_row
+********************************************************************************
+* Summary:
+* Parses a line of comma-separated integers.
+*
+* Return:
+* The number of values, or 0 if the line is anything else.
+*******************************************************************************/
+static unsigned parse_row(const char *line, int32_t *row, unsigned max)
+{
+    unsigned count = 0;
+    const char *p = line;
+
+    while ((*p == '\r') || (*p == '\n') || (*p == ' '))
+    {
+        p++;
+    }
+    while (*p != '\0')
+    {
+        char *end;
+        long v = strtol(p, &end, 10);
+
+        if ((end == p) || (count == max))
+        {
+            return 0;
+        }
+        row[count++] = (int32_t)v;
+        p = end;
+        while (*p == ' ')
+        {
+            p++;
+        }
+        if (*p == ',')
+        {
+            p++;
+        }
+        else if ((*p == '\r') || (*p == '\n') || (*p == '\0'))
+        {
+            break;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return count;
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned sensors = SENSOR_COUNT;
+    uint32_t chunk = 0;
+    const char *out_path;
+    rec_info_t info = { 0 };
+    rec_writer_t *writer = NULL;
+    calib_rows_t rows;
+    calib_scan_t scan;
+    uint64_t in_bytes = 0;
+    uint64_t rejected = 0;
+    struct sigaction sa;
+    struct timespec t0;
+    struct timespec t1;
+    struct stat st;
+    char line[CSV2REC_LINE_MAX];
+    int opt;
+    int status = 0;
+
+    while ((opt = getopt(argc, argv, "n:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': sensors = (unsigned)atoi(optarg); break;
+        case 'c': chunk = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n sensors] [-c chunk_records] out.rec [log.csv ... | -]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((argc - optind) < 1)
+    {
+        fprintf(stderr, "usage: %s [-n sensors] [-c chunk_records] out.rec [log.csv ... | -]\n", argv[0]);
+        return 2;
+    }
+    out_path = argv[optind++];
+
+    // no SA_RESTART: a read blocked on a serial port returns on Ctrl-C
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int f = optind; (f < argc || f == optind) && !csv2rec_stop; f++)
+    {
+        const char *path = (f < argc) ? argv[f] : "-";
+        FILE *in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+
+        if (in == NULL)
+        {
+            fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+            status = 1;
+            break;
+        }
+
+        while (!csv2rec_stop && (fgets(line, sizeof(line), in) != NULL))
+        {
+            int32_t row[8];
+            unsigned count;
+
+            in_bytes += strlen(line);
+            if (line[strspn(line, "\r\n ")] == '\0')
+            {
+                continue;       /* the rows are "\n...\r": blank lines between them */
+            }
+            count = parse_row(line, row, 8u);
+            if (count == 0u)
+            {
+                rejected++;
+                continue;
+            }
+
+            if (writer == NULL)
+            {
+                if (calib_rows_init(&rows, sensors, count) != 0)
+                {
+                    // not a row: the file's first lines may be anything
+                    rejected++;
+                    continue;
+                }
+                calib_rows_info(&rows, &info);
+                info.chunk_records = chunk;
+                snprintf(info.source, sizeof(info.source), "%s", path);
+                writer = rec_writer_create(out_path, &info);
+                if (writer == NULL)
+                {
+                    fprintf(stderr, "cannot create %s: %s\n", out_path, strerror(errno));
+                    return 1;
+                }
+            }
+
+            if (calib_rows_add(&rows, row, count, &scan) &&
+                (rec_writer_append(writer, scan.time_ns, scan.mode, scan.values) != 0))
+            {
+                fprintf(stderr, "%s: write failed: %s\n", out_path, strerror(errno));
+                status = 1;
+                break;
+            }
+        }
+        if (in != stdin)
+        {
+            fclose(in);
+        }
+        if (status != 0)
+        {
+            break;
+        }
+    }
+
+    if (writer == NULL)
+    {
+        fprintf(stderr, "no CALIBRATION_MODE rows found\n");
+        return 1;
+    }
+    if (calib_rows_flush(&rows, &scan))
+    {
+        rec_writer_append(writer, scan.time_ns, scan.mode, scan.values);
+    }
+    if (rec_writer_close(writer) != 0)
+    {
+        fprintf(stderr, "%s: write failed\n", out_path);
+        status = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (stat(out_path, &st) == 0)
+    {
+        double seconds = (double)(t1.tv_sec - t0.tv_sec) + ((double)(t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+        fprintf(stderr, "%llu rows -> %llu scans (%llu partial), %llu rows and %llu lines skipped\n",
+                (unsigned long long)rows.rows, (unsigned long long)rows.scans, (unsigned long long)rows.partial,
+                (unsigned long long)rows.bad_rows, (unsigned long long)rejected);
+        fprintf(stderr, "%.1f MB of text -> %.1f MB (%.1fx) in %.2f s, %.1f s of board time\n",
+                (double)in_bytes / 1e6, (double)st.st_size / 1e6,
+                (st.st_size > 0) ? (double)in_bytes / (double)st.st_size : 0.0, seconds,
+                (double)rows.ticks / CLOCK_HZ);
+    }
+    return status;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,813 @@
+/*******************************************************************************
+* File Name: recfile.c
+*
+* Description: Writer and memory-mapped reader of the recording format. See
+*              recfile.h.
+*
+*              Layout (little-endian):
+*                header   64 B   magic version header_size channels(u16)
+*                                time_base(u8) - chunk_records(u32)
+*                                layout[8] source[32] -
+*                chunk    32 B   magic records(u32) t_first(i64) t_last(i64)
+*                                bytes(u32) channels(u16) -
+*                         then (2 + channels) u32 column offsets from the
+*                         chunk start, then the columns
+*                index    32 B per chunk: offset(u64) t_first(i64)
+*                                t_last(i64) records(u32) -
+*                trailer  24 B   magic chunks(u32) index_offset(u64)
+*                                records(u64)
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "recfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REC_FILE_MAGIC      0x43455254u     /* "TREC" */
+#define REC_CHUNK_MAGIC     0x4B4E4843u     /* "CHNK" */
+#define REC_INDEX_MAGIC     0x58444954u     /* "TIDX" */
+#define REC_VERSION         1u
+
+#define REC_HEADER_SIZE     64u
+#define REC_CHUNK_HEADER    32u
+#define REC_ENTRY_SIZE      32u
+#define REC_TRAILER_SIZE    24u
+
+/* Largest encoded sizes: a time delta, a channel delta */
+#define REC_MAX_TIME_BYTES  10u
+#define REC_MAX_VALUE_BYTES 5u
+
+struct rec_writer
+{
+    FILE      *file;
+    rec_info_t info;
+    uint64_t   offset;          /* file position of the next chunk */
+    uint64_t   records;
+    int64_t    last_time;
+
+    uint32_t   count;           /* records in the chunk being filled */
+    int64_t   *times;
+    uint8_t   *keys;
+    int32_t   *values;
+    uint8_t   *buffer;          /* encoded chunk */
+    size_t     buffer_size;
+
+    uint8_t   *index;           /* index entries, encoded */
+    uint32_t   chunks;
+    uint32_t   index_capacity;
+    bool       failed;
+};
+
+struct rec_reader
+{
+    const uint8_t *map;
+    size_t         size;
+    rec_info_t     info;
+    const uint8_t *index;       /* into map, or index_copy */
+    uint8_t       *index_copy;  /* rebuilt index of an unfinished file */
+    uint32_t       chunks;
+    uint64_t       records;
+};
+
+
+/*******************************************************************************
+* Little-endian fields and varints
+*******************************************************************************/
+static void put_u16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t *p, uint32_t v) { put_u16(p, (uint16_t)v); put_u16(p + 2, (uint16_t)(v >> 16)); }
+static void put_u64(uint8_t *p, uint64_t v) { put_u32(p, (uint32_t)v); put_u32(p + 4, (uint32_t)(v >> 32)); }
+
+static uint16_t get_u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t *p) { return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16); }
+static uint64_t get_u64(const uint8_t *p) { return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32); }
+
+
+static size_t put_varint(uint8_t *p, int64_t value)
+{
+    uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t n = 0;
+
+    while (v >= 0x80u)
+    {
+        p[n++] = (uint8_t)(v | 0x80u);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+
+/* Decodes one varint from [*p, end). Returns false on a truncated one. */
+static bool get_varint(const uint8_t **p, const uint8_t *end, int64_t *value)
+{
+    uint64_t v = 0;
+
+    for (unsigned shift = 0; shift < 64u; shift += 7u)
+    {
+        uint8_t b;
+
+        if (*p >= end)
+        {
+            return false;
+        }
+        b = *(*p)++;
+        v |= (uint64_t)(b & 0x7Fu) << shift;
+        if ((b & 0x80u) == 0u)
+        {
+            *value = (int64_t)((v >> 1) ^ (0u - (v & 1u)));
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_writer_create
+********************************************************************************
+* Summary:
+* Creates the file and writes its header.
+*
+* Return:
+* The writer, or NULL with errno set.
+*******************************************************************************/
+rec_writer_t *rec_writer_create(const char *path, const rec_info_t *info)
+{
+    rec_writer_t *writer;
+    uint8_t header[REC_HEADER_SIZE] = { 0 };
+    size_t n;
+
+    if ((info->channels == 0u) || (info->channels > REC_MAX_CHANNELS))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    writer = calloc(1, sizeof(*writer));
+    if (writer == NULL)
+    {
+        return NULL;
+    }
+    writer->info = *info;
+    if (writer->info.chunk_records == 0u)
+    {
+        writer->info.chunk_records = REC_DEFAULT_CHUNK;
+    }
+    writer->info.source[sizeof(writer->info.source) - 1u] = '\0';
+    writer->last_time = INT64_MIN;
+
+    n = writer->info.chunk_records;
+    writer->buffer_size = REC_CHUNK_HEADER + (4u * (2u + (size_t)info->channels)) +
+                          (n * (REC_MAX_TIME_BYTES + 1u + ((size_t)info->channels * REC_MAX_VALUE_BYTES)));
+    writer->times = malloc(n * sizeof(int64_t));
+    writer->keys = malloc(n);
+    writer->values = malloc(n * info->channels * sizeof(int32_t));
+    writer->buffer = malloc(writer->buffer_size);
+    writer->file = fopen(path, "wb");
+    if ((writer->times == NULL) || (writer->keys == NULL) || (writer->values == NULL) ||
+        (writer->buffer == NULL) || (writer->file == NULL))
+    {
+        int saved = errno;
+
+        if (writer->file != NULL)
+        {
+            fclose(writer->file);
+        }
+        free(writer->times);
+        free(writer->keys);
+        free(writer->values);
+        free(writer->buffer);
+        free(writer);
+        errno = saved;
+        return NULL;
+    }
+
+    put_u32(&header[0], REC_FILE_MAGIC);
+    put_u16(&header[4], REC_VERSION);
+    put_u16(&header[6], REC_HEADER_SIZE);
+    put_u16(&header[8], writer->info.channels);
+    header[10] = writer->info.time_base;
+    put_u32(&header[12], writer->info.chunk_records);
+    memcpy(&header[16], writer->info.layout, REC_LAYOUT_BYTES);
+    memcpy(&header[24], writer->info.source, sizeof(writer->info.source));
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header))
+    {
+        writer->failed = true;
+    }
+    writer->offset = REC_HEADER_SIZE;
+    return writer;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_writer_flush
+********************************************************************************
+* Summary:
+* Encodes the buffered records as one chunk and appends it to the file and
+* to the index.
+*******************************************************************************/
+static void rec_writer_flush(rec_writer_t *writer)
+{
+    uint16_t channels = writer->info.channels;
+    uint8_t *out = writer->buffer;
+    size_t pos = REC_CHUNK_HEADER + (4u * (2u + (size_t)channels));
+    int64_t previous;
+    uint8_t *entry;
+
+    if (writer->count == 0u)
+    {
+        return;
+    }
+
+    // time column
+    put_u32(&out[REC_CHUNK_HEADER], (uint32_t)pos);
+    previous = writer->times[0];
+    for (uint32_t r = 0; r < writer->count; r++)
+    {
+        pos += put_varint(&out[pos], writer->times[r] - previous);
+        previous = writer->times[r];
+    }
+
+    // key column
+    put_u32(&out[REC_CHUNK_HEADER + 4u], (uint32_t)pos);
+    memcpy(&out[pos], writer->keys, writer->count);
+    pos += writer->count;
+
+    // one column per channel, predicted per key
+    for (uint16_t c = 0; c < channels; c++)
+    {
+        int64_t last[REC_MAX_KEYS] = { 0 };
+
+        put_u32(&out[REC_CHUNK_HEADER + (4u * (2u + c))], (uint32_t)pos);
+        for (uint32_t r = 0; r < writer->count; r++)
+        {
+            int64_t v = writer->values[((size_t)r * channels) + c];
+            uint8_t key = writer->keys[r];
+
+            pos += put_varint(&out[pos], v - last[key]);
+            last[key] = v;
+        }
+    }
+
+    put_u32(&out[0], REC_CHUNK_MAGIC);
+    put_u32(&out[4], writer->count);
+    put_u64(&out[8], (uint64_t)writer->times[0]);
+    put_u64(&out[16], (uint64_t)writer->times[writer->count - 1u]);
+    put_u32(&out[24], (uint32_t)pos);
+    put_u16(&out[28], channels);
+    put_u16(&out[30], 0u);
+
+    if (fwrite(out, 1, pos, writer->file) != pos)
+    {
+        writer->failed = true;
+    }
+
+    if (writer->chunks == writer->index_capacity)
+    {
+        uint32_t capacity = (writer->index_capacity == 0u) ? 256u : (writer->index_capacity * 2u);
+        uint8_t *index = realloc(writer->index, (size_t)capacity * REC_ENTRY_SIZE);
+
+        if (index == NULL)
+        {
+            writer->failed = true;
+            writer->count = 0;
+            return;
+        }
+        writer->index = index;
+        writer->index_capacity = capacity;
+    }
+    entry = &writer->index[(size_t)writer->chunks * REC_ENTRY_SIZE];
+    put_u64(&entry[0], writer->offset);
+    memcpy(&entry[8], &out[8], 16u);
+    put_u32(&entry[24], writer->count);
+    put_u32(&entry[28], 0u);
+    writer->chunks++;
+
+    writer->offset += pos;
+    writer->count = 0;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_writer_append
+********************************************************************************
+* Summary:
+* Adds one record.
+*
+* Return:
+* 0, or -1 with errno EINVAL for a time earlier than the last one or a key
+* out of range, or EIO after a write error.
+*******************************************************************************/
+int rec_writer_append(rec_writer_t *writer, int64_t time_ns, uint8_t key, const int32_t *values)
+{
+    if ((time_ns < writer->last_time) || (key >= REC_MAX_KEYS))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (writer->failed)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    writer->times[writer->count] = time_ns;
+    writer->keys[writer->count] = key;
+    memcpy(&writer->values[(size_t)writer->count * writer->info.channels], values,
+           writer->info.channels * sizeof(int32_t));
+    writer->count++;
+    writer->records++;
+    writer->last_time = time_ns;
+
+    if (writer->count == writer->info.chunk_records)
+    {
+        rec_writer_flush(writer);
+    }
+    return 0;
+}
+
+
+uint64_t rec_writer_records(const rec_writer_t *writer)
+{
+    return writer->records;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_writer_close
+********************************************************************************
+* Summary:
+* Writes the last chunk, the index and the trailer, and frees the writer.
+*
+* Return:
+* 0, or -1 if any write failed.
+*******************************************************************************/
+int rec_writer_close(rec_writer_t *writer)
+{
+    uint8_t trailer[REC_TRAILER_SIZE];
+    int status;
+
+    rec_writer_flush(writer);
+
+    put_u32(&trailer[0], REC_INDEX_MAGIC);
+    put_u32(&trailer[4], writer->chunks);
+    put_u64(&trailer[8], writer->offset);
+    put_u64(&trailer[16], writer->records);
+    if ((writer->chunks > 0u) &&
+        (fwrite(writer->index, REC_ENTRY_SIZE, writer->chunks, writer->file) != writer->chunks))
+    {
+        writer->failed = true;
+    }
+    if (fwrite(trailer, 1, sizeof(trailer), writer->file) != sizeof(trailer))
+    {
+        writer->failed = true;
+    }
+    status = ((fclose(writer->file) != 0) || writer->failed) ? -1 : 0;
+
+    free(writer->times);
+    free(writer->keys);
+    free(writer->values);
+    free(writer->buffer);
+    free(writer->index);
+    free(writer);
+    return status;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_reader_rebuild
+********************************************************************************
+* Summary:
+* Rebuilds the index of a file without a valid trailer by walking the chunk
+* headers. Stops at the first chunk that is torn or damaged.
+*
+* Return:
+* 0, or -1 when out of memory.
+*******************************************************************************/
+static int rec_reader_rebuild(rec_reader_t *reader)
+{
+    uint64_t offset = REC_HEADER_SIZE;
+    uint32_t capacity = 0;
+
+    reader->chunks = 0;
+    reader->records = 0;
+    while ((offset + REC_CHUNK_HEADER) <= reader->size)
+    {
+        const uint8_t *chunk = &reader->map[offset];
+        uint32_t bytes = get_u32(&chunk[24]);
+        uint32_t records = get_u32(&chunk[4]);
+        uint8_t *entry;
+
+        if ((get_u32(&chunk[0]) != REC_CHUNK_MAGIC) || (get_u16(&chunk[28]) != reader->info.channels) ||
+            (bytes < REC_CHUNK_HEADER) || (bytes > (reader->size - offset)) ||
+            (records == 0u) || (records > reader->info.chunk_records))
+        {
+            break;
+        }
+
+        if (reader->chunks == capacity)
+        {
+            uint8_t *index;
+
+            capacity = (capacity == 0u) ? 256u : (capacity * 2u);
+            index = realloc(reader->index_copy, (size_t)capacity * REC_ENTRY_SIZE);
+            if (index == NULL)
+            {
+                return -1;
+            }
+            reader->index_copy = index;
+        }
+        entry = &reader->index_copy[(size_t)reader->chunks * REC_ENTRY_SIZE];
+        put_u64(&entry[0], offset);
+        memcpy(&entry[8], &chunk[8], 16u);
+        put_u32(&entry[24], records);
+        put_u32(&entry[28], 0u);
+        reader->chunks++;
+        reader->records += records;
+        offset += bytes;
+    }
+    reader->index = reader->index_copy;
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_reader_open
+********************************************************************************
+* Summary:
+* Maps a recording and locates its index.
+*
+* Return:
+* The reader, or NULL with errno set (EPROTO: not a recording).
+*******************************************************************************/
+rec_reader_t *rec_reader_open(const char *path)
+{
+    rec_reader_t *reader;
+    struct stat st;
+    const uint8_t *h;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < REC_HEADER_SIZE)
+    {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+    reader->size = (size_t)st.st_size;
+    reader->map = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (reader->map == MAP_FAILED)
+    {
+        free(reader);
+        return NULL;
+    }
+
+    h = reader->map;
+    reader->info.channels = get_u16(&h[8]);
+    reader->info.time_base = h[10];
+    reader->info.chunk_records = get_u32(&h[12]);
+    memcpy(reader->info.layout, &h[16], REC_LAYOUT_BYTES);
+    memcpy(reader->info.source, &h[24], sizeof(reader->info.source));
+    reader->info.source[sizeof(reader->info.source) - 1u] = '\0';
+    if ((get_u32(&h[0]) != REC_FILE_MAGIC) || (get_u16(&h[4]) != REC_VERSION) ||
+        (get_u16(&h[6]) != REC_HEADER_SIZE) || (reader->info.channels == 0u) ||
+        (reader->info.channels > REC_MAX_CHANNELS) || (reader->info.chunk_records == 0u))
+    {
+        rec_reader_close(reader);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    // the trailer, if the writer finished
+    if (reader->size >= (REC_HEADER_SIZE + REC_TRAILER_SIZE))
+    {
+        const uint8_t *t = &reader->map[reader->size - REC_TRAILER_SIZE];
+        uint32_t chunks = get_u32(&t[4]);
+        uint64_t index_offset = get_u64(&t[8]);
+
+        if ((get_u32(&t[0]) == REC_INDEX_MAGIC) && (index_offset >= REC_HEADER_SIZE) &&
+            (index_offset + ((uint64_t)chunks * REC_ENTRY_SIZE) + REC_TRAILER_SIZE == reader->size))
+        {
+            reader->index = &reader->map[index_offset];
+            reader->chunks = chunks;
+            reader->records = get_u64(&t[16]);
+        }
+    }
+    if ((reader->index == NULL) && (rec_reader_rebuild(reader) != 0))
+    {
+        rec_reader_close(reader);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return reader;
+}
+
+
+void rec_reader_close(rec_reader_t *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+    munmap((void *)reader->map, reader->size);
+    free(reader->index_copy);
+    free(reader);
+}
+
+
+const rec_info_t *rec_reader_info(const rec_reader_t *reader)
+{
+    return &reader->info;
+}
+
+
+uint32_t rec_reader_chunks(const rec_reader_t *reader)
+{
+    return reader->chunks;
+}
+
+
+uint64_t rec_reader_records(const rec_reader_t *reader)
+{
+    return reader->records;
+}
+
+
+uint64_t rec_reader_bytes(const rec_reader_t *reader)
+{
+    return reader->size;
+}
+
+
+/* true if the index was rebuilt because the writer did not finish */
+bool rec_reader_recovered(const rec_reader_t *reader)
+{
+    return reader->index_copy != NULL;
+}
+
+
+void rec_reader_chunk_span(const rec_reader_t *reader, uint32_t chunk, int64_t *first, int64_t *last)
+{
+    const uint8_t *entry = &reader->index[(size_t)chunk * REC_ENTRY_SIZE];
+
+    *first = (int64_t)get_u64(&entry[8]);
+    *last = (int64_t)get_u64(&entry[16]);
+}
+
+
+/*******************************************************************************
+* Function Name: rec_reader_find
+********************************************************************************
+* Summary:
+* Binary search of the index.
+*
+* Return:
+* The first chunk that ends at or after time_ns, or the chunk count if there
+* is none.
+*******************************************************************************/
+uint32_t rec_reader_find(const rec_reader_t *reader, int64_t time_ns)
+{
+    uint32_t low = 0;
+    uint32_t high = reader->chunks;
+
+    while (low < high)
+    {
+        uint32_t mid = low + ((high - low) / 2u);
+        int64_t first;
+        int64_t last;
+
+        rec_reader_chunk_span(reader, mid, &first, &last);
+        if (last < time_ns)
+        {
+            low = mid + 1u;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+
+int rec_block_init(rec_block_t *block, const rec_reader_t *reader)
+{
+    size_t n = reader->info.chunk_records;
+
+    memset(block, 0, sizeof(*block));
+    block->capacity = (uint32_t)n;
+    block->channels = reader->info.channels;
+    block->times = malloc(n * sizeof(int64_t));
+    block->keys = malloc(n);
+    block->values = malloc(n * reader->info.channels * sizeof(int32_t));
+    if ((block->times == NULL) || (block->keys == NULL) || (block->values == NULL))
+    {
+        rec_block_free(block);
+        return -1;
+    }
+    return 0;
+}
+
+
+void rec_block_free(rec_block_t *block)
+{
+    free(block->times);
+    free(block->keys);
+    free(block->values);
+    memset(block, 0, sizeof(*block));
+}
+
+
+/*******************************************************************************
+* Function Name: rec_reader_decode
+********************************************************************************
+* Summary:
+* Decodes one chunk. Channels whose bit is clear in channel_mask are not
+* decoded and read as 0.
+*
+* Return:
+* 0, or -1 if the chunk is damaged.
+*******************************************************************************/
+int rec_reader_decode(const rec_reader_t *reader, uint32_t chunk, uint64_t channel_mask, rec_block_t *block)
+{
+    uint64_t offset;
+    const uint8_t *base;
+    uint16_t channels = reader->info.channels;
+    uint32_t records;
+    uint32_t bytes;
+    const uint8_t *p;
+    const uint8_t *end;
+    int64_t t;
+
+    if (chunk >= reader->chunks)
+    {
+        return -1;
+    }
+    offset = get_u64(&reader->index[((size_t)chunk * REC_ENTRY_SIZE)]);
+    if (offset + REC_CHUNK_HEADER > reader->size)
+    {
+        return -1;
+    }
+    base = &reader->map[offset];
+    records = get_u32(&base[4]);
+    bytes = get_u32(&base[24]);
+    if ((get_u32(&base[0]) != REC_CHUNK_MAGIC) || (records == 0u) || (records > block->capacity) ||
+        (bytes > reader->size - offset) || (bytes < REC_CHUNK_HEADER + (4u * (2u + (uint32_t)channels))) ||
+        (get_u16(&base[28]) != channels) || (block->channels != channels))
+    {
+        return -1;
+    }
+
+#define REC_COLUMN(i)       get_u32(&base[REC_CHUNK_HEADER + (4u * (i))])
+#define REC_COLUMN_END(i)   (((i) + 1u < 2u + (uint32_t)channels) ? REC_COLUMN((i) + 1u) : bytes)
+
+    for (uint32_t i = 0; i < 2u + (uint32_t)channels; i++)
+    {
+        if ((REC_COLUMN(i) > REC_COLUMN_END(i)) || (REC_COLUMN_END(i) > bytes))
+        {
+            return -1;
+        }
+    }
+
+    p = &base[REC_COLUMN(0)];
+    end = &base[REC_COLUMN_END(0)];
+    t = (int64_t)get_u64(&base[8]);
+    for (uint32_t r = 0; r < records; r++)
+    {
+        int64_t delta;
+
+        if (!get_varint(&p, end, &delta))
+        {
+            return -1;
+        }
+        t += delta;
+        block->times[r] = t;
+    }
+
+    if ((REC_COLUMN_END(1) - REC_COLUMN(1)) != records)
+    {
+        return -1;
+    }
+    memcpy(block->keys, &base[REC_COLUMN(1)], records);
+
+    for (uint16_t c = 0; c < channels; c++)
+    {
+        int64_t last[REC_MAX_KEYS] = { 0 };
+
+        if ((channel_mask & ((uint64_t)1u << c)) == 0u)
+        {
+            for (uint32_t r = 0; r < records; r++)
+            {
+                block->values[((size_t)r * channels) + c] = 0;
+            }
+            continue;
+        }
+
+        p = &base[REC_COLUMN(2u + c)];
+        end = &base[REC_COLUMN_END(2u + c)];
+        for (uint32_t r = 0; r < records; r++)
+        {
+            uint8_t key = block->keys[r];
+            int64_t delta;
+
+            if ((key >= REC_MAX_KEYS) || !get_varint(&p, end, &delta))
+            {
+                return -1;
+            }
+            last[key] += delta;
+            block->values[((size_t)r * channels) + c] = (int32_t)last[key];
+        }
+    }
+
+#undef REC_COLUMN
+#undef REC_COLUMN_END
+
+    block->records = records;
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: rec_reader_window
+********************************************************************************
+* Summary:
+* Passes every record with from <= time < to to fn, decoding only the
+* chunks that overlap the window.
+*******************************************************************************/
+int64_t rec_reader_window(const rec_reader_t *reader, int64_t from, int64_t to, uint64_t channel_mask,
+                          rec_record_fn fn, void *context)
+{
+    rec_block_t block;
+    int64_t passed = 0;
+
+    if (rec_block_init(&block, reader) != 0)
+    {
+        return -1;
+    }
+
+    for (uint32_t chunk = rec_reader_find(reader, from); chunk < reader->chunks; chunk++)
+    {
+        int64_t first;
+        int64_t last;
+
+        rec_reader_chunk_span(reader, chunk, &first, &last);
+        if (first >= to)
+        {
+            break;
+        }
+        if (rec_reader_decode(reader, chunk, channel_mask, &block) != 0)
+        {
+            passed = -1;
+            break;
+        }
+        for (uint32_t r = 0; r < block.records; r++)
+        {
+            int64_t t = block.times[r];
+
+            if (t < from)
+            {
+                continue;
+            }
+            if (t >= to)
+            {
+                break;
+            }
+            passed++;
+            if (!fn(context, t, block.keys[r], &block.values[(size_t)r * block.channels]))
+            {
+                rec_block_free(&block);
+                return passed;
+            }
+        }
+    }
+
+    rec_block_free(&block);
+    return passed;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,104 @@
+/*******************************************************************************
+* File Name: recfile.h
+*
+* Description: Indexed, columnar binary recording of the sensor stream.
+*
+*              A recording is a sequence of records: a time in ns, a key
+*              (the scan mode) and a fixed number of int32 channels. Records
+*              are stored in chunks of up to chunk_records; inside a chunk
+*              each column is stored on its own:
+*                time      zigzag varint delta from the previous record
+*                key       one byte per record
+*                channel   zigzag varint delta from the previous record
+*                          with the same key (so normal and shear scans are
+*                          predicted from their own mode)
+*              Predictors restart at every chunk, so a chunk decodes on its
+*              own, and the column offsets in the chunk header let a reader
+*              decode only the channels it wants.
+*
+*              File:   header | chunk ... | index | trailer
+*              All fields are little-endian. The index holds the file offset
+*              and the first and last time of every chunk; the trailer at
+*              the end of the file points at it. A reader maps the file and
+*              finds a time window by binary search in the index, so the
+*              cost of a window is the chunks it covers, not the file size.
+*              A file whose writer did not finish (no trailer) is still
+*              readable: the reader rebuilds the index by walking the chunk
+*              headers, and ignores a torn last chunk.
+*
+*              Times must not decrease from record to record.
+*******************************************************************************/
+
+#ifndef RECFILE_H
+#define RECFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REC_MAX_CHANNELS        64
+#define REC_MAX_KEYS            8
+#define REC_LAYOUT_BYTES        8
+#define REC_DEFAULT_CHUNK       4096u
+#define REC_ALL_CHANNELS        UINT64_MAX  /* channel_mask: decode every channel */
+
+/* Time base of the record times */
+#define REC_TIME_BOARD          0u      /* board clock (CALIBRATION_MODE tick column) */
+#define REC_TIME_HOST           1u      /* host receive time */
+#define REC_TIME_SYNC           2u      /* synchronized board time (TIME_SYNC) */
+
+typedef struct
+{
+    uint16_t channels;          /* 1 .. REC_MAX_CHANNELS */
+    uint8_t  time_base;         /* REC_TIME_* */
+    uint8_t  layout[REC_LAYOUT_BYTES];      /* SENSOR_LAYOUT_DESCRIPTOR, zero if unknown */
+    uint32_t chunk_records;     /* 0 = REC_DEFAULT_CHUNK */
+    char     source[32];        /* free text: port or file name */
+} rec_info_t;
+
+/* Decoded chunk, filled by rec_reader_decode. values is records x channels. */
+typedef struct
+{
+    uint32_t records;
+    uint32_t capacity;
+    uint16_t channels;
+    int64_t  *times;
+    uint8_t  *keys;
+    int32_t  *values;
+} rec_block_t;
+
+typedef struct rec_writer rec_writer_t;
+typedef struct rec_reader rec_reader_t;
+
+/* Writer */
+rec_writer_t *rec_writer_create(const char *path, const rec_info_t *info);
+int  rec_writer_append(rec_writer_t *writer, int64_t time_ns, uint8_t key, const int32_t *values);
+int  rec_writer_close(rec_writer_t *writer);
+uint64_t rec_writer_records(const rec_writer_t *writer);
+
+/* Reader */
+rec_reader_t *rec_reader_open(const char *path);
+void rec_reader_close(rec_reader_t *reader);
+const rec_info_t *rec_reader_info(const rec_reader_t *reader);
+uint32_t rec_reader_chunks(const rec_reader_t *reader);
+uint64_t rec_reader_records(const rec_reader_t *reader);
+uint64_t rec_reader_bytes(const rec_reader_t *reader);
+bool rec_reader_recovered(const rec_reader_t *reader);
+void rec_reader_chunk_span(const rec_reader_t *reader, uint32_t chunk, int64_t *first, int64_t *last);
+uint32_t rec_reader_find(const rec_reader_t *reader, int64_t time_ns);
+int  rec_reader_decode(const rec_reader_t *reader, uint32_t chunk, uint64_t channel_mask, rec_block_t *block);
+
+int  rec_block_init(rec_block_t *block, const rec_reader_t *reader);
+void rec_block_free(rec_block_t *block);
+
+/* Calls fn for every record with from <= time < to, in order. fn returns
+*  false to stop. Returns the number of records passed to fn, or -1 on a
+*  corrupt chunk. */
+typedef bool (*rec_record_fn)(void *context, int64_t time_ns, uint8_t key, const int32_t *values);
+int64_t rec_reader_window(const rec_reader_t *reader, int64_t from, int64_t to, uint64_t channel_mask,
+                          rec_record_fn fn, void *context);
+
+#endif /* RECFILE_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,307 @@
+/*******************************************************************************
+* File Name: recplay.c
+*
+* Description: Replays a recording as the board's UART stream.
+*
+*              The bytes are produced by the firmware's own emitters, csv.c
+*              and frame.c, built for the host against sim/project.h, so a
+*              replay is byte for byte what the board sends: the layout
+*              frame first, as at start-up, then the CALIBRATION_MODE rows
+*              of every scan (or one CSV line per record for other
+*              recordings). Each scan goes out at its recorded time divided
+*              by the speed; -x 0 sends as fast as the output takes it.
+*
+*              By default the stream goes to a new pseudo-terminal whose
+*              name is printed: ingest, vizrelay, tsync or a terminal open
+*              it like a board's serial port. -o sends it to a file, a pipe
+*              or "-" for standard output instead. Like a UART with flow
+*              control, the replay waits while nobody drains the output.
+*
+*              Usage: recplay [-x speed] [-f from_s] [-t to_s] [-l]
+*                             [-o path] file.rec
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "recfile.h"
+#include "calib_rows.h"
+#include "project.h"
+#include "csv.h"
+#include "frame.h"
+#include "sensor_config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PLAY_BUFFER_SIZE    4096u
+
+typedef struct
+{
+    const rec_info_t *info;
+    bool calib;
+    unsigned sensors;
+    unsigned columns;
+    double speed;               /* 0 = unpaced */
+    bool started;
+    int64_t base_ns;            /* record time of the first record played */
+    struct timespec base_clock;
+    uint64_t records;
+} play_t;
+
+static int play_fd = -1;
+static int play_slave = -1;                /* pseudo-terminal's own side */
+static uint8_t play_buffer[PLAY_BUFFER_SIZE];
+static size_t play_length = 0;
+static bool play_failed = false;
+static volatile sig_atomic_t play_stop = 0;
+
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    play_stop = 1;
+}
+
+
+static void play_flush(void)
+{
+    size_t done = 0;
+
+    while ((done < play_length) && !play_failed)
+    {
+        ssize_t n = write(play_fd, &play_buffer[done], play_length - done);
+
+        if (n > 0)
+        {
+            done += (size_t)n;
+        }
+        else if ((n < 0) && (errno != EINTR))
+        {
+            play_failed = true;
+        }
+        else if (play_stop)
+        {
+            break;
+        }
+    }
+    play_length = 0;
+}
+
+
+/*******************************************************************************
+* Function Name: UART_SpiUartWriteTxData
+********************************************************************************
+* Summary:
+* The firmware's UART write (sim/project.h): collects the bytes until the
+* record is complete.
+*******************************************************************************/
+void UART_SpiUartWriteTxData(uint32 txData)
+{
+    if (play_length == PLAY_BUFFER_SIZE)
+    {
+        play_flush();
+    }
+    play_buffer[play_length++] = (uint8_t)txData;
+}
+
+
+/*******************************************************************************
+* Function Name: on_record
+********************************************************************************
+* Summary:
+* Waits for the record's time, then sends it.
+*******************************************************************************/
+static bool on_record(void *context, int64_t time_ns, uint8_t key, const int32_t *values)
+{
+    play_t *p = context;
+
+    if (!p->started)
+    {
+        p->started = true;
+        p->base_ns = time_ns;
+        clock_gettime(CLOCK_MONOTONIC, &p->base_clock);
+    }
+    else if (p->speed > 0.0)
+    {
+        double offset = (double)(time_ns - p->base_ns) / p->speed;
+        int64_t target = (int64_t)p->base_clock.tv_nsec + (int64_t)offset;
+        struct timespec at;
+
+        at.tv_sec = p->base_clock.tv_sec + (time_t)(target / 1000000000);
+        at.tv_nsec = (long)(target % 1000000000);
+        while ((clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR) && !play_stop)
+        {
+        }
+    }
+
+    if (p->calib)
+    {
+        for (unsigned i = 0; i < p->sensors; i++)
+        {
+            int32_t row[5];
+
+            calib_rows_row(values, key, i, p->sensors, p->columns, row);
+            Csv_PutLine(row, (uint8_t)p->columns);
+        }
+    }
+    else
+    {
+        Csv_PutLine(values, (uint8_t)p->info->channels);
+    }
+    play_flush();
+    p->records++;
+    return !play_stop && !play_failed;
+}
+
+
+/*******************************************************************************
+* Function Name: open_output
+********************************************************************************
+* Summary:
+* Opens the output, or a new pseudo-terminal when path is NULL.
+*
+* Return:
+* The descriptor, or -1.
+*******************************************************************************/
+static int open_output(const char *path)
+{
+    struct termios raw;
+    int fd;
+
+    if (path != NULL)
+    {
+        if (strcmp(path, "-") == 0)
+        {
+            return STDOUT_FILENO;
+        }
+        return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+    }
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0))
+    {
+        return -1;
+    }
+
+    // the terminal side stays open and raw, so what is sent before a reader
+    // attaches is not cooked (\r to \n) and a reader may come and go
+    play_slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+    if ((play_slave < 0) || (tcgetattr(play_slave, &raw) != 0))
+    {
+        return -1;
+    }
+    cfmakeraw(&raw);
+    tcsetattr(play_slave, TCSANOW, &raw);
+    fprintf(stderr, "replaying on %s\n", ptsname(fd));
+    return fd;
+}
+
+
+int main(int argc, char **argv)
+{
+    double from_s = 0.0;
+    double to_s = INFINITY;
+    bool loop = false;
+    const char *out_path = NULL;
+    play_t p = { 0 };
+    rec_reader_t *reader;
+    int64_t start = 0;
+    int64_t unused;
+    struct timespec t0;
+    struct timespec t1;
+    double seconds;
+    int opt;
+
+    p.speed = 1.0;
+    while ((opt = getopt(argc, argv, "x:f:t:lo:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'x': p.speed = atof(optarg); break;
+        case 'f': from_s = atof(optarg); break;
+        case 't': to_s = atof(optarg); break;
+        case 'l': loop = true; break;
+        case 'o': out_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-x speed] [-f from_s] [-t to_s] [-l] [-o path] file.rec\n", argv[0]);
+            return 2;
+        }
+    }
+    if (((argc - optind) != 1) || (p.speed < 0.0))
+    {
+        fprintf(stderr, "usage: %s [-x speed] [-f from_s] [-t to_s] [-l] [-o path] file.rec\n", argv[0]);
+        return 2;
+    }
+
+    reader = rec_reader_open(argv[optind]);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], (errno == EPROTO) ? "not a recording" : strerror(errno));
+        return 1;
+    }
+    p.info = rec_reader_info(reader);
+    p.calib = calib_rows_layout(p.info, &p.sensors, &p.columns);
+    if (rec_reader_chunks(reader) > 0u)
+    {
+        rec_reader_chunk_span(reader, 0, &start, &unused);
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    play_fd = open_output(out_path);
+    if (play_fd < 0)
+    {
+        fprintf(stderr, "cannot open the output: %s\n", strerror(errno));
+        return 1;
+    }
+
+    // what the board sends at start-up
+    if (p.info->layout[0] != 0u)
+    {
+        Frame_Begin(FRAME_TYPE_LAYOUT, SENSOR_LAYOUT_SIZE);
+        Frame_PutBytes(p.info->layout, SENSOR_LAYOUT_SIZE);
+        Frame_End();
+        play_flush();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do
+    {
+        int64_t from = start + (int64_t)(from_s * 1e9);
+        int64_t to = isinf(to_s) ? INT64_MAX : start + (int64_t)(to_s * 1e9);
+
+        p.started = false;
+        if (rec_reader_window(reader, from, to, REC_ALL_CHANNELS, on_record, &p) < 0)
+        {
+            fprintf(stderr, "%s: damaged chunk\n", argv[optind]);
+            break;
+        }
+    } while (loop && !play_stop && !play_failed);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    seconds = (double)(t1.tv_sec - t0.tv_sec) + ((double)(t1.tv_nsec - t0.tv_nsec) / 1e9);
+    fprintf(stderr, "%llu records in %.2f s%s\n", (unsigned long long)p.records, seconds,
+            play_failed ? " (output closed)" : "");
+    if (play_fd != STDOUT_FILENO)
+    {
+        close(play_fd);
+    }
+    if (play_slave >= 0)
+    {
+        close(play_slave);
+    }
+    rec_reader_close(reader);
+    return play_failed ? 1 : 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,246 @@
+/*******************************************************************************
+* File Name: recslice.c
+*
+* Description: Pulls a time window out of a recording.
+*
+*              Times are seconds from the start of the recording. The window
+*              is printed as the original CALIBRATION_MODE rows, or with -r
+*              as one line per record (time in ns, key, channels), or with
+*              -o written to a new recording. -c restricts -r to a list of
+*              channels, and only those columns are decoded. -i prints the
+*              header and index summary instead.
+*
+*              The time taken to open the file and to find and decode the
+*              window is reported on stderr.
+*
+*              Usage: recslice [-i] [-r] [-f from_s] [-t to_s] [-c ch,...]
+*                              [-o out.rec] file.rec
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "recfile.h"
+#include "calib_rows.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct
+{
+    const rec_info_t *info;
+    uint64_t mask;
+    bool raw;
+    unsigned sensors;
+    unsigned columns;
+    rec_writer_t *writer;
+    FILE *out;
+} slice_t;
+
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((double)ts.tv_sec * 1e3) + ((double)ts.tv_nsec / 1e6);
+}
+
+
+static bool on_record(void *context, int64_t time_ns, uint8_t key, const int32_t *values)
+{
+    slice_t *s = context;
+
+    if (s->writer != NULL)
+    {
+        return rec_writer_append(s->writer, time_ns, key, values) == 0;
+    }
+
+    if (s->raw)
+    {
+        fprintf(s->out, "%lld,%u", (long long)time_ns, key);
+        for (unsigned c = 0; c < s->info->channels; c++)
+        {
+            if ((s->mask & ((uint64_t)1u << c)) != 0u)
+            {
+                fprintf(s->out, ",%ld", (long)values[c]);
+            }
+        }
+        fputc('\n', s->out);
+        return true;
+    }
+
+    for (unsigned i = 0; i < s->sensors; i++)
+    {
+        int32_t row[5];
+
+        calib_rows_row(values, key, i, s->sensors, s->columns, row);
+        fprintf(s->out, "%ld", (long)row[0]);
+        for (unsigned c = 1; c < s->columns; c++)
+        {
+            fprintf(s->out, ",%ld", (long)row[c]);
+        }
+        fputc('\n', s->out);
+    }
+    return true;
+}
+
+
+static void print_info(const rec_reader_t *reader, const char *path)
+{
+    const rec_info_t *info = rec_reader_info(reader);
+    uint32_t chunks = rec_reader_chunks(reader);
+    uint64_t records = rec_reader_records(reader);
+    int64_t first = 0;
+    int64_t last = 0;
+    int64_t unused;
+
+    if (chunks > 0u)
+    {
+        rec_reader_chunk_span(reader, 0, &first, &unused);
+        rec_reader_chunk_span(reader, chunks - 1u, &unused, &last);
+    }
+    printf("%s: %s\n", path, rec_reader_recovered(reader) ? "unfinished, index rebuilt" : "complete");
+    printf("source        %s\n", info->source);
+    printf("layout        version %u, %u sensors, %u modes, format %u, %u values per line, %u lines per scan\n",
+           info->layout[0], info->layout[1], info->layout[2], info->layout[3], info->layout[4], info->layout[5]);
+    printf("channels      %u, time base %u\n", info->channels, info->time_base);
+    printf("records       %llu in %u chunks of up to %u\n", (unsigned long long)records, chunks, info->chunk_records);
+    printf("span          %.3f s\n", (double)(last - first) / 1e9);
+    printf("size          %.1f MB, %.1f bytes per record\n", (double)rec_reader_bytes(reader) / 1e6,
+           (records > 0u) ? (double)rec_reader_bytes(reader) / (double)records : 0.0);
+}
+
+
+int main(int argc, char **argv)
+{
+    double from_s = 0.0;
+    double to_s = INFINITY;
+    bool info_only = false;
+    const char *out_path = NULL;
+    const char *channels = NULL;
+    slice_t s = { 0 };
+    rec_reader_t *reader;
+    int64_t start = 0;
+    int64_t unused;
+    int64_t from;
+    int64_t to;
+    int64_t passed;
+    double t0;
+    double t1;
+    double t2;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "irf:t:c:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i': info_only = true; break;
+        case 'r': s.raw = true; break;
+        case 'f': from_s = atof(optarg); break;
+        case 't': to_s = atof(optarg); break;
+        case 'c': channels = optarg; break;
+        case 'o': out_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-i] [-r] [-f from_s] [-t to_s] [-c ch,...] [-o out.rec] file.rec\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((argc - optind) != 1)
+    {
+        fprintf(stderr, "usage: %s [-i] [-r] [-f from_s] [-t to_s] [-c ch,...] [-o out.rec] file.rec\n", argv[0]);
+        return 2;
+    }
+
+    t0 = now_ms();
+    reader = rec_reader_open(argv[optind]);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], (errno == EPROTO) ? "not a recording" : strerror(errno));
+        return 1;
+    }
+    t1 = now_ms();
+    s.info = rec_reader_info(reader);
+
+    if (info_only)
+    {
+        print_info(reader, argv[optind]);
+        rec_reader_close(reader);
+        return 0;
+    }
+
+    s.mask = REC_ALL_CHANNELS;
+    if (channels != NULL)
+    {
+        char *p = (char *)channels;
+
+        s.raw = true;
+        s.mask = 0;
+        while (*p != '\0')
+        {
+            unsigned long c = strtoul(p, &p, 10);
+
+            if (c >= s.info->channels)
+            {
+                fprintf(stderr, "channel %lu out of range (0..%u)\n", c, s.info->channels - 1u);
+                return 2;
+            }
+            s.mask |= (uint64_t)1u << c;
+            if (*p == ',')
+            {
+                p++;
+            }
+        }
+    }
+    if (!s.raw && (out_path == NULL) && !calib_rows_layout(s.info, &s.sensors, &s.columns))
+    {
+        s.raw = true;       /* not CALIBRATION_MODE scans: records as they are */
+    }
+
+    if (out_path != NULL)
+    {
+        rec_info_t info = *s.info;
+
+        s.writer = rec_writer_create(out_path, &info);
+        if (s.writer == NULL)
+        {
+            fprintf(stderr, "cannot create %s: %s\n", out_path, strerror(errno));
+            return 1;
+        }
+    }
+    s.out = stdout;
+
+    if (rec_reader_chunks(reader) > 0u)
+    {
+        rec_reader_chunk_span(reader, 0, &start, &unused);
+    }
+    from = start + (int64_t)(from_s * 1e9);
+    to = isinf(to_s) ? INT64_MAX : start + (int64_t)(to_s * 1e9);
+
+    passed = rec_reader_window(reader, from, to, s.mask, on_record, &s);
+    t2 = now_ms();
+
+    if ((s.writer != NULL) && (rec_writer_close(s.writer) != 0))
+    {
+        fprintf(stderr, "%s: write failed\n", out_path);
+        passed = -1;
+    }
+    fflush(stdout);
+    if (passed < 0)
+    {
+        fprintf(stderr, "%s: damaged chunk in the window\n", argv[optind]);
+    }
+    else
+    {
+        fprintf(stderr, "%lld records of %llu; open %.2f ms, window %.2f ms\n", (long long)passed,
+                (unsigned long long)rec_reader_records(reader), t1 - t0, t2 - t1);
+    }
+    rec_reader_close(reader);
+    return (passed < 0) ? 1 : 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,24 @@
+/*******************************************************************************
+* File Name: project.h
+*
+* Description: Stand-in for the PSoC Creator generated project.h, so the
+*              firmware's CSV and frame emitters build on the host for
+*              recplay. The UART write is implemented by recplay.
+*******************************************************************************/
+
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <stdint.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+
+/* UART (SCB) */
+void UART_SpiUartWriteTxData(uint32 txData);
+
+#endif /* PROJECT_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,420 @@
+/*******************************************************************************
+* File Name: scanbench.c
+*
+* Description: Frame rate and SNR of the board's scan methods (firmware
+*              CSX_MODE, csx.h).
+*
+*              Each method in turn is selected with a METHOD_SET frame; once
+*              the board's METHOD_ACK shows it in effect and the filters
+*              have settled, the stream is recorded for a while at rest:
+*              the published cycles per second (host time, and board time
+*              from the tick column of CALIBRATION_MODE rows) and the mean,
+*              rms and peak-to-peak noise of every channel. Then the tool
+*              asks for a test load, and with the load held records every
+*              method again for the signal. The load stays put across the
+*              methods, so both see the same press.
+*
+*              SNR is the signal (loaded mean - rest mean) over the
+*              peak-to-peak noise at rest, the CapSense convention, and also
+*              over the rms noise. Both CALIBRATION_MODE rows and
+*              VISUALIZATION_MODE lines are understood; the latter carry the
+*              unfiltered counts, the noise of the sensor itself. -q
+*              skips the loaded part.
+*
+*              Usage: scanbench [-b baud] [-t seconds] [-s settle_s]
+*                               [-n sensors] [-q] port
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+#include "csx.h"
+#include "frame.h"
+#include "sensor_config.h"
+#include "clock.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SCANBENCH_ACK_TIMEOUT_NS    (3000000000ull)     /* a CSD cycle is two scans */
+#define SCANBENCH_MAX_CHANNELS      (2 * 32)
+/* My_Time_TC_PERIOD_VALUE + 1: a negative tick column is a counter wrap */
+#define SCANBENCH_TICK_MODULUS      (10001)
+
+typedef struct
+{
+    uint64_t n;
+    double   mean;
+    double   m2;                /* sum of squared deviations (Welford) */
+    int32_t  min;
+    int32_t  max;
+} channel_stats_t;
+
+typedef struct
+{
+    unsigned sensors;
+    unsigned modes;
+    uint64_t cycles;
+    uint64_t first_ns;          /* receive time of the first cycle end */
+    uint64_t last_ns;
+    uint64_t board_ticks;       /* CALIBRATION_MODE tick column, summed */
+    uint64_t board_cycles;      /* cycles the ticks cover */
+    channel_stats_t channels[SCANBENCH_MAX_CHANNELS];
+} phase_t;
+
+static const char *const scanbench_method_names[CSX_METHOD_COUNT] = { "CSD two-phase", "mutual (CSX)" };
+
+
+static void add_value(channel_stats_t *ch, int32_t value)
+{
+    double delta;
+
+    if (ch->n == 0u)
+    {
+        ch->min = value;
+        ch->max = value;
+    }
+    ch->n++;
+    delta = (double)value - ch->mean;
+    ch->mean += delta / (double)ch->n;
+    ch->m2 += delta * ((double)value - ch->mean);
+    ch->min = (value < ch->min) ? value : ch->min;
+    ch->max = (value > ch->max) ? value : ch->max;
+}
+
+
+static void end_cycle(phase_t *phase, uint64_t rx_time_ns)
+{
+    if (phase->cycles == 0u)
+    {
+        phase->first_ns = rx_time_ns;
+    }
+    phase->last_ns = rx_time_ns;
+    phase->cycles++;
+}
+
+
+/*******************************************************************************
+* Function Name: take_record
+********************************************************************************
+* Summary:
+* Adds one data line of the stream to the phase.
+*******************************************************************************/
+static void take_record(phase_t *phase, const stream_record_t *record)
+{
+    const int32_t *v = record->data.values;
+    unsigned frame = phase->sensors * phase->modes;
+
+    if ((record->count == 4u) || (record->count == 5u))
+    {
+        // CALIBRATION_MODE row: ticks, mode, sensor, value[, x]
+        int32_t mode = v[CALIB_COL_MODE];
+        int32_t sensor = v[CALIB_COL_SENSOR];
+        int32_t ticks = v[CALIB_COL_TIME];
+
+        if ((mode < 0) || ((unsigned)mode >= phase->modes) || (sensor < 0) || ((unsigned)sensor >= phase->sensors))
+        {
+            return;
+        }
+        add_value(&phase->channels[((unsigned)mode * phase->sensors) + (unsigned)sensor], v[CALIB_COL_VALUE]);
+
+        // the first cycle only starts the count
+        if (phase->cycles > 0u)
+        {
+            phase->board_ticks += (uint64_t)((ticks < 0) ? ticks + SCANBENCH_TICK_MODULUS : ticks);
+        }
+        if (((unsigned)mode == (phase->modes - 1u)) && ((unsigned)sensor == (phase->sensors - 1u)))
+        {
+            if (phase->cycles > 0u)
+            {
+                phase->board_cycles++;
+            }
+            end_cycle(phase, record->rx_time_ns);
+        }
+    }
+    else if ((record->count == frame) || (record->count == (2u * frame)))
+    {
+        // VISUALIZATION_MODE line: every sensor of every mode (then rates)
+        for (unsigned c = 0; c < frame; c++)
+        {
+            add_value(&phase->channels[c], v[c]);
+        }
+        end_cycle(phase, record->rx_time_ns);
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: collect
+********************************************************************************
+* Summary:
+* Records the stream for the given time; with phase NULL, only discards it.
+*
+* Return:
+* Number of data lines taken.
+*******************************************************************************/
+static uint64_t collect(ingest_t *ingest, phase_t *phase, double seconds)
+{
+    uint64_t deadline = ingest_now_ns() + (uint64_t)(seconds * 1e9);
+    uint64_t lines = 0;
+
+    while (ingest_now_ns() < deadline)
+    {
+        stream_record_t record;
+
+        if (!ingest_pop(ingest, 0, &record))
+        {
+            usleep(1000);
+            continue;
+        }
+        if (record.kind != STREAM_KIND_CSV)
+        {
+            continue;
+        }
+        lines++;
+        if (phase != NULL)
+        {
+            take_record(phase, &record);
+        }
+    }
+    return lines;
+}
+
+
+/*******************************************************************************
+* Function Name: drain
+********************************************************************************
+* Summary:
+* Drops everything queued so far, e.g. what piled up during a prompt.
+*******************************************************************************/
+static void drain(ingest_t *ingest)
+{
+    stream_record_t record;
+
+    while (ingest_pop(ingest, 0, &record))
+    {
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: select_method
+********************************************************************************
+* Summary:
+* Sends METHOD_SET and waits for the METHOD_ACK that shows the method in
+* effect. Lines up to the ack still come from the previous method and are
+* dropped.
+*
+* Return:
+* 0, or -1 after printing the error.
+*******************************************************************************/
+static int select_method(ingest_t *ingest, uint8_t method)
+{
+    uint8_t frame[FRAME_OVERHEAD + CSX_COMMAND_SIZE];
+    uint64_t deadline;
+
+    frame[0] = FRAME_SYNC_0;
+    frame[1] = FRAME_SYNC_1;
+    frame[2] = FRAME_TYPE_METHOD_SET;
+    frame[3] = CSX_COMMAND_SIZE;
+    frame[4] = method;
+    frame[5] = stream_crc8(stream_crc8(stream_crc8(0, frame[2]), frame[3]), frame[4]);
+
+    drain(ingest);
+    if (ingest_write(ingest, 0, frame, sizeof(frame)) != (ssize_t)sizeof(frame))
+    {
+        fprintf(stderr, "cannot write to the board\n");
+        return -1;
+    }
+
+    deadline = ingest_now_ns() + SCANBENCH_ACK_TIMEOUT_NS;
+    while (ingest_now_ns() < deadline)
+    {
+        stream_record_t record;
+
+        if (!ingest_pop(ingest, 0, &record))
+        {
+            usleep(1000);
+            continue;
+        }
+        if ((record.kind == STREAM_KIND_FRAME) && (record.type == FRAME_TYPE_METHOD_ACK) &&
+            (record.count == CSX_ACK_SIZE) && (record.data.payload[0] == method))
+        {
+            if (record.data.payload[1] != CSX_OK)
+            {
+                fprintf(stderr, "the board refused the %s method\n", scanbench_method_names[method]);
+                return -1;
+            }
+            return 0;
+        }
+    }
+    fprintf(stderr, "no answer to METHOD_SET (is the board built with CSX_MODE?)\n");
+    return -1;
+}
+
+
+static double noise_rms(const channel_stats_t *ch)
+{
+    return (ch->n > 1u) ? sqrt(ch->m2 / (double)(ch->n - 1u)) : 0.0;
+}
+
+
+/*******************************************************************************
+* Function Name: report
+********************************************************************************
+* Summary:
+* Prints the rate, the per-channel noise and, with the loaded phase, the
+* signal and SNR of one method, followed by a one-line summary per mode.
+*******************************************************************************/
+static void report(uint8_t method, const phase_t *rest, const phase_t *loaded)
+{
+    double seconds = (double)(rest->last_ns - rest->first_ns) / 1e9;
+    double rate = ((rest->cycles > 1u) && (seconds > 0.0)) ? (double)(rest->cycles - 1u) / seconds : 0.0;
+
+    printf("\n%s\n", scanbench_method_names[method]);
+    printf("  frame rate   %.1f cycles/s", rate);
+    if ((rest->board_cycles > 0u) && (rest->board_ticks > 0u))
+    {
+        printf(" (board clock %.1f cycles/s)",
+               (double)rest->board_cycles * CLOCK_HZ / (double)rest->board_ticks);
+    }
+    printf("\n  mode sensor      rest   rms  p-p");
+    if (loaded != NULL)
+    {
+        printf("   signal  SNR(p-p)  SNR(rms)");
+    }
+    printf("\n");
+
+    for (unsigned m = 0; m < rest->modes; m++)
+    {
+        double best = 0.0;
+        unsigned best_sensor = 0;
+        double rms_sum = 0.0;
+
+        for (unsigned s = 0; s < rest->sensors; s++)
+        {
+            const channel_stats_t *r = &rest->channels[(m * rest->sensors) + s];
+            double rms = noise_rms(r);
+            int32_t pp = r->max - r->min;
+
+            rms_sum += rms;
+            printf("  %4u %6u %9.1f %5.1f %4ld", m, s, r->mean, rms, (long)pp);
+            if (loaded != NULL)
+            {
+                const channel_stats_t *l = &loaded->channels[(m * loaded->sensors) + s];
+                double signal = l->mean - r->mean;
+                double snr_pp = fabs(signal) / ((pp > 0) ? (double)pp : 1.0);
+
+                printf(" %8.1f %9.1f %9.1f", signal, snr_pp, fabs(signal) / ((rms > 0.0) ? rms : 1.0));
+                if (snr_pp > best)
+                {
+                    best = snr_pp;
+                    best_sensor = s;
+                }
+            }
+            printf("\n");
+        }
+
+        printf("  mode %u: mean rms noise %.2f counts", m, rms_sum / (double)rest->sensors);
+        if (loaded != NULL)
+        {
+            printf(", best SNR %.1f (sensor %u)", best, best_sensor);
+        }
+        printf("\n");
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    ingest_config_t config = { 0 };
+    unsigned baud = 115200;
+    double seconds = 10.0;
+    double settle = 2.0;
+    unsigned sensors = SENSOR_COUNT;
+    int quiet = 0;
+    int opt;
+    ingest_t *ingest;
+    static phase_t rest[CSX_METHOD_COUNT];
+    static phase_t loaded[CSX_METHOD_COUNT];
+    char answer[16];
+
+    while ((opt = getopt(argc, argv, "b:t:s:n:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': baud = (unsigned)atoi(optarg); break;
+        case 't': seconds = atof(optarg); break;
+        case 's': settle = atof(optarg); break;
+        case 'n': sensors = (unsigned)atoi(optarg); break;
+        case 'q': quiet = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] [-t seconds] [-s settle_s] [-n sensors] [-q] port\n", argv[0]);
+            return 2;
+        }
+    }
+    if (((argc - optind) != 1) || (seconds <= 0.0) || (settle < 0.0) || (sensors == 0u) ||
+        ((sensors * SENSOR_MODE_COUNT) > SCANBENCH_MAX_CHANNELS))
+    {
+        fprintf(stderr, "usage: %s [-b baud] [-t seconds] [-s settle_s] [-n sensors] [-q] port\n", argv[0]);
+        return 2;
+    }
+
+    ingest = ingest_create(&config);
+    if ((ingest == NULL) || (ingest_open(ingest, argv[optind], baud) < 0) || (ingest_start(ingest) != 0))
+    {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        return 1;
+    }
+
+    for (int loading = 0; loading < (quiet ? 1 : 2); loading++)
+    {
+        if (loading)
+        {
+            printf("\nApply the test load and hold it still, then press Enter... ");
+            fflush(stdout);
+            if (fgets(answer, sizeof(answer), stdin) == NULL)
+            {
+                break;
+            }
+        }
+        for (uint8_t method = 0; method < CSX_METHOD_COUNT; method++)
+        {
+            phase_t *phase = loading ? &loaded[method] : &rest[method];
+
+            fprintf(stderr, "%s: %s, %.0f s\n", scanbench_method_names[method], loading ? "loaded" : "at rest", seconds);
+            if (select_method(ingest, method) != 0)
+            {
+                ingest_stop(ingest);
+                ingest_destroy(ingest);
+                return 1;
+            }
+            phase->sensors = sensors;
+            phase->modes = SENSOR_MODE_COUNT;
+            collect(ingest, NULL, settle);
+            if (collect(ingest, phase, seconds) == 0u)
+            {
+                fprintf(stderr, "no data lines from the board\n");
+                ingest_stop(ingest);
+                ingest_destroy(ingest);
+                return 1;
+            }
+        }
+    }
+
+    for (uint8_t method = 0; method < CSX_METHOD_COUNT; method++)
+    {
+        report(method, &rest[method], (loaded[method].cycles > 0u) ? &loaded[method] : NULL);
+    }
+
+    // leave the board as it starts up
+    select_method(ingest, CSX_DEFAULT_METHOD);
+    ingest_stop(ingest);
+    ingest_destroy(ingest);
+    return 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,33 @@
+/*******************************************************************************
+* File Name: project.h
+*
+* Description: Stand-in for the PSoC Creator generated project.h, so the
+*              firmware's time sync sources build on the host for
+*              sim_timesync. The functions are implemented by the simulation.
+*******************************************************************************/
+
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <stdint.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+
+/* My_Time: same period as the TopDesign component */
+#define My_Time_TC_PERIOD_VALUE     (10000u)
+uint32 My_Time_ReadCounter(void);
+
+/* UART (SCB) */
+#define UART_TX_BUFFER_SIZE         (64u)
+#define UART_UART_RX_DIRECTION      (1u)
+void   UART_SpiUartWriteTxData(uint32 txData);
+uint32 UART_SpiUartGetTxBufferSize(void);
+uint32 UART_SpiUartGetRxBufferSize(void);
+uint32 UART_SpiUartReadRxData(void);
+
+#endif /* PROJECT_H */
+
+
+/* [] END OF FILE */
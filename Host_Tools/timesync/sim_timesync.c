@@ -0,0 +1,416 @@
+/*******************************************************************************
+* File Name: sim_timesync.c
+*
+* Description: Simulation of the board time sync with skewed clocks.
+*
+*              Runs the firmware's command.c, timesync.c, clock.c and frame.c
+*              against a simulated My_Time counter and UART, and the host side
+*              from timesync_host.c, over a simulated USB serial link. Each
+*              board gets its own oscillator error (up to the +/-2 % the
+*              on-chip oscillator is specified for) and boot time. The link
+*              adds wire time, USB latency jitter and occasional long stalls;
+*              the board adds main-loop latency before parsing a PING and
+*              transmit backlog before its PONG leaves.
+*
+*              Every 10 ms of simulated time after the warm-up, each board's
+*              synchronized time is compared with the true host time. The
+*              result is the error of every board and the worst misalignment
+*              between any two boards; the exit status is non-zero when that
+*              exceeds the limit.
+*
+*              The host clock starts 30 s before its 32-bit microsecond wrap
+*              so the wrap is always exercised.
+*
+*              Usage: sim_timesync [-n boards] [-s seconds] [-w warmup]
+*                                  [-r ping_hz] [-j jitter_us] [-l limit_us]
+*                                  [-S seed]
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "timesync_host.h"
+#include "command.h"
+#include "project.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SIM_MAX_BOARDS      16
+#define SIM_SAMPLE_US       10000.0
+#define SIM_BAUD            115200.0
+#define SIM_HOST_EPOCH      (0xFFFFFFFFu - 30000000u)
+
+typedef struct
+{
+    unsigned boards;
+    double seconds;
+    double warmup;
+    double ping_hz;
+    double jitter_us;           /* USB latency, uniform 0..jitter each way */
+    double stall_p;             /* chance of a 2..30 ms stall, each way */
+    double limit_us;
+    unsigned seed;
+} sim_config_t;
+
+typedef struct
+{
+    double skew_ppm;
+    double boot_us;             /* true time of the board's counter zero */
+} sim_board_t;
+
+typedef struct
+{
+    double lock_s;              /* first time the board reported LOCKED, -1 never */
+    unsigned pings;
+    unsigned pongs;
+} sim_summary_t;
+
+/* state of the board being simulated (one per child process) */
+static double      sim_now_us;
+static sim_board_t sim_board;
+static uint8_t     sim_rx[256];
+static unsigned    sim_rx_head, sim_rx_tail;
+static uint8_t     sim_tx[256];
+static unsigned    sim_tx_length;
+static uint64_t    sim_rng = 88172645463325252ull;
+
+
+/*******************************************************************************
+* Simulated PSoC components (sim/project.h)
+*******************************************************************************/
+uint32 My_Time_ReadCounter(void)
+{
+    double local_us = (sim_now_us - sim_board.boot_us) * (1.0 + sim_board.skew_ppm * 1e-6);
+    uint64_t ticks = (uint64_t)(local_us * (CLOCK_HZ / 1e6));
+
+    return (uint32)(ticks % (My_Time_TC_PERIOD_VALUE + 1u));
+}
+
+
+void UART_SpiUartWriteTxData(uint32 txData)
+{
+    if (sim_tx_length < sizeof(sim_tx))
+    {
+        sim_tx[sim_tx_length++] = (uint8_t)txData;
+    }
+}
+
+
+uint32 UART_SpiUartGetTxBufferSize(void)
+{
+    return 0u;
+}
+
+
+uint32 UART_SpiUartGetRxBufferSize(void)
+{
+    return sim_rx_tail - sim_rx_head;
+}
+
+
+uint32 UART_SpiUartReadRxData(void)
+{
+    return sim_rx[sim_rx_head++ % sizeof(sim_rx)];
+}
+
+
+/*******************************************************************************
+* Random numbers (xorshift64), reproducible per seed
+*******************************************************************************/
+static double uniform(double lo, double hi)
+{
+    sim_rng ^= sim_rng << 13;
+    sim_rng ^= sim_rng >> 7;
+    sim_rng ^= sim_rng << 17;
+    return lo + (hi - lo) * (double)(sim_rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+static uint32_t host_us(double t)
+{
+    return SIM_HOST_EPOCH + (uint32_t)(uint64_t)t;
+}
+
+
+/* one-way delay of a frame over the USB serial link */
+static double link_delay(const sim_config_t *cfg, unsigned bytes)
+{
+    double delay = bytes * 10.0 * 1e6 / SIM_BAUD + uniform(0.0, cfg->jitter_us);
+
+    if (uniform(0.0, 1.0) < cfg->stall_p)
+    {
+        delay += uniform(2000.0, 30000.0);
+    }
+    return delay;
+}
+
+
+typedef struct
+{
+    tsync_host_t *ts;
+    uint32_t rx_us;
+} sim_host_t;
+
+
+static stream_record_t *host_emit(void *context, stream_record_t *record)
+{
+    sim_host_t *host = context;
+
+    tsync_host_on_record(host->ts, record, host->rx_us);
+    return record;
+}
+
+
+/*******************************************************************************
+* Function Name: run_board
+********************************************************************************
+* Summary:
+* Simulates one board and its host link. Writes the synchronization error of
+* every sample after the warm-up to errors[] and returns the sample count.
+*******************************************************************************/
+static unsigned run_board(const sim_config_t *cfg, unsigned index, int32_t *errors,
+                          sim_summary_t *summary)
+{
+    tsync_host_t ts;
+    stream_parser_t parser;
+    stream_record_t record;
+    sim_host_t host = { &ts, 0 };
+    double period = 1e6 / cfg->ping_hz;
+    double end = cfg->seconds * 1e6;
+    double next_ping;
+    double next_sample = 0.0;
+    unsigned count = 0;
+
+    sim_rng ^= (uint64_t)(cfg->seed * 7919u + index + 1u) * 0x9E3779B97F4A7C15ull;
+    sim_board.skew_ppm = uniform(-20000.0, 20000.0);
+    sim_board.boot_us = -uniform(0.0, 3600e6);
+    next_ping = uniform(0.0, period);
+
+    tsync_host_init(&ts);
+    stream_parser_init(&parser, &record);
+    summary->lock_s = -1.0;
+
+    while (next_sample < end)
+    {
+        uint8_t ping[TSYNC_PING_BYTES];
+        size_t length;
+        double parse_at;
+        double pong_at;
+
+        // host sends a PING; the board parses it on its next main loop pass
+        length = tsync_host_ping(&ts, host_us(next_ping), ping);
+        parse_at = next_ping + link_delay(cfg, (unsigned)length) + uniform(0.0, 300.0);
+        if (uniform(0.0, 1.0) < 0.05)
+        {
+            parse_at += uniform(1000.0, 8000.0);    /* long pass (CSV output) */
+        }
+
+        // the board keeps running until then; sample it every 10 ms
+        while ((next_sample < parse_at) && (next_sample < end))
+        {
+            uint32_t board_us;
+
+            sim_now_us = next_sample;
+            board_us = TimeSync_Now();
+            if ((summary->lock_s < 0.0) && (TimeSync_GetState() == TIMESYNC_LOCKED))
+            {
+                summary->lock_s = next_sample * 1e-6;
+            }
+            if (next_sample >= cfg->warmup * 1e6)
+            {
+                errors[count++] = (int32_t)(board_us - host_us(next_sample));
+            }
+            next_sample += SIM_SAMPLE_US;
+        }
+        if (next_sample >= end)
+        {
+            break;
+        }
+
+        sim_now_us = parse_at;
+        memcpy(sim_rx, ping, length);
+        sim_rx_head = 0;
+        sim_rx_tail = (unsigned)length;
+        sim_tx_length = 0;
+        Command_Poll();
+
+        // the PONG waits behind queued data, then crosses the link
+        pong_at = parse_at;
+        if (uniform(0.0, 1.0) < 0.10)
+        {
+            pong_at += uniform(0.0, 5000.0);
+        }
+        pong_at += link_delay(cfg, sim_tx_length);
+
+        host.rx_us = host_us(pong_at);
+        stream_parser_feed(&parser, sim_tx, sim_tx_length, 0, host_emit, &host);
+
+        next_ping += period;
+        if (next_ping < pong_at)
+        {
+            next_ping = pong_at;
+        }
+    }
+
+    summary->pings = (unsigned)ts.pings;
+    summary->pongs = (unsigned)ts.pongs;
+    return count;
+}
+
+
+static int read_all(int fd, void *data, size_t length)
+{
+    uint8_t *p = data;
+
+    while (length > 0)
+    {
+        ssize_t n = read(fd, p, length);
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sim_timesync [-n boards] [-s seconds] [-w warmup] [-r ping_hz]\n"
+                    "                    [-j jitter_us] [-l limit_us] [-S seed]\n");
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    sim_config_t cfg = { 4, 300.0, 60.0, 4.0, 1000.0, 0.02, 500.0, 1 };
+    static int32_t errors[SIM_MAX_BOARDS][40000];
+    unsigned counts[SIM_MAX_BOARDS];
+    sim_summary_t summary[SIM_MAX_BOARDS];
+    double worst_pair = 0.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:w:r:j:l:S:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': cfg.boards = (unsigned)atoi(optarg); break;
+        case 's': cfg.seconds = atof(optarg); break;
+        case 'w': cfg.warmup = atof(optarg); break;
+        case 'r': cfg.ping_hz = atof(optarg); break;
+        case 'j': cfg.jitter_us = atof(optarg); break;
+        case 'l': cfg.limit_us = atof(optarg); break;
+        case 'S': cfg.seed = (unsigned)atoi(optarg); break;
+        default:  usage();
+        }
+    }
+    if ((cfg.boards < 1) || (cfg.boards > SIM_MAX_BOARDS) || (cfg.ping_hz <= 0.0) ||
+        (cfg.warmup >= cfg.seconds) || ((cfg.seconds - cfg.warmup) * 1e6 / SIM_SAMPLE_US > 40000.0))
+    {
+        usage();
+    }
+
+    printf("%u boards, %.0f s (%.0f s warm-up), %.1f pings/s, %.0f us USB jitter\n\n",
+           cfg.boards, cfg.seconds, cfg.warmup, cfg.ping_hz, cfg.jitter_us);
+    printf("board    skew ppm   lock s   mean us    rms us    max us   pongs\n");
+
+    // the firmware keeps its state in statics: one child process per board
+    for (unsigned b = 0; b < cfg.boards; b++)
+    {
+        int fds[2];
+        pid_t pid;
+        double sum = 0.0;
+        double sum2 = 0.0;
+        double peak = 0.0;
+
+        if (pipe(fds) != 0)
+        {
+            perror("pipe");
+            return 1;
+        }
+        pid = fork();
+        if (pid == 0)
+        {
+            sim_summary_t s;
+            unsigned n;
+
+            close(fds[0]);
+            n = run_board(&cfg, b, errors[b], &s);
+            if ((write(fds[1], &sim_board, sizeof(sim_board)) < 0) ||
+                (write(fds[1], &s, sizeof(s)) < 0) ||
+                (write(fds[1], &n, sizeof(n)) < 0) ||
+                (write(fds[1], errors[b], n * sizeof(int32_t)) < 0))
+            {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        close(fds[1]);
+        if ((pid < 0) ||
+            (read_all(fds[0], &sim_board, sizeof(sim_board)) != 0) ||
+            (read_all(fds[0], &summary[b], sizeof(summary[b])) != 0) ||
+            (read_all(fds[0], &counts[b], sizeof(counts[b])) != 0) ||
+            (read_all(fds[0], errors[b], counts[b] * sizeof(int32_t)) != 0))
+        {
+            fprintf(stderr, "board %u: simulation failed\n", b);
+            return 1;
+        }
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+
+        for (unsigned i = 0; i < counts[b]; i++)
+        {
+            double e = errors[b][i];
+
+            sum += e;
+            sum2 += e * e;
+            if (fabs(e) > peak)
+            {
+                peak = fabs(e);
+            }
+        }
+        printf("%5u  %10.0f  %7.1f  %8.1f  %8.1f  %8.0f  %6u/%u\n", b, sim_board.skew_ppm,
+               summary[b].lock_s, sum / counts[b], sqrt(sum2 / counts[b]), peak,
+               summary[b].pongs, summary[b].pings);
+    }
+
+    // alignment between boards: difference of their errors at the same instant
+    for (unsigned a = 0; a < cfg.boards; a++)
+    {
+        for (unsigned b = a + 1u; b < cfg.boards; b++)
+        {
+            unsigned n = (counts[a] < counts[b]) ? counts[a] : counts[b];
+
+            for (unsigned i = 0; i < n; i++)
+            {
+                double d = fabs((double)errors[a][i] - (double)errors[b][i]);
+
+                if (d > worst_pair)
+                {
+                    worst_pair = d;
+                }
+            }
+        }
+    }
+
+    printf("\nworst board-to-board misalignment: %.0f us (limit %.0f us)\n", worst_pair, cfg.limit_us);
+    for (unsigned b = 0; b < cfg.boards; b++)
+    {
+        if (summary[b].lock_s < 0.0)
+        {
+            printf("board %u never locked\n", b);
+            return 1;
+        }
+    }
+    return (worst_pair > cfg.limit_us) ? 1 : 0;
+}
+
+
+/* [] END OF FILE */
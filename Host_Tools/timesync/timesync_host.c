@@ -0,0 +1,144 @@
+/*******************************************************************************
+* File Name: timesync_host.c
+*
+* Description: Builds time sync PINGs and evaluates the board's replies. See
+*              timesync_host.h.
+*******************************************************************************/
+
+#include "timesync_host.h"
+
+#include <string.h>
+
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+
+static uint32_t get_u32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+
+static uint16_t get_u16(const uint8_t *data)
+{
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+
+void tsync_host_init(tsync_host_t *ts)
+{
+    memset(ts, 0, sizeof(*ts));
+}
+
+
+/*******************************************************************************
+* Function Name: tsync_host_ping
+********************************************************************************
+* Summary:
+* Builds the next SYNC_PING frame. now_us must be taken immediately before the
+* bytes are written, and is never 0 (0 marks "no PONG yet" on the wire).
+*
+* Return:
+* Number of bytes in out (TSYNC_PING_BYTES).
+*******************************************************************************/
+size_t tsync_host_ping(tsync_host_t *ts, uint32_t now_us, uint8_t out[TSYNC_PING_BYTES])
+{
+    uint8_t payload[TIMESYNC_PING_SIZE];
+    uint8_t crc;
+    size_t n = 0;
+
+    if (now_us == 0u)
+    {
+        now_us = 1u;
+    }
+
+    payload[0] = ts->seq;
+    put_u32(&payload[1], now_us);
+    payload[5] = ts->pong_seq;
+    put_u32(&payload[6], ts->have_pong ? ts->pong_t4 : 0u);
+
+    out[n++] = FRAME_SYNC_0;
+    out[n++] = FRAME_SYNC_1;
+    out[n++] = FRAME_TYPE_SYNC_PING;
+    out[n++] = TIMESYNC_PING_SIZE;
+    crc = stream_crc8(stream_crc8(0, FRAME_TYPE_SYNC_PING), TIMESYNC_PING_SIZE);
+    for (size_t i = 0; i < TIMESYNC_PING_SIZE; i++)
+    {
+        out[n++] = payload[i];
+        crc = stream_crc8(crc, payload[i]);
+    }
+    out[n++] = crc;
+
+    ts->ping_seq = ts->seq;
+    ts->ping_t1 = now_us;
+    ts->seq++;
+    ts->pings++;
+    return n;
+}
+
+
+/*******************************************************************************
+* Function Name: tsync_host_on_record
+********************************************************************************
+* Summary:
+* Consumes SYNC_PONG and TIMESTAMP frames; other records are ignored.
+*
+* Return:
+* true if the record was one of them.
+*******************************************************************************/
+bool tsync_host_on_record(tsync_host_t *ts, const stream_record_t *record, uint32_t rx_us)
+{
+    const uint8_t *p = record->data.payload;
+
+    if (record->kind != STREAM_KIND_FRAME)
+    {
+        return false;
+    }
+
+    if ((record->type == FRAME_TYPE_SYNC_PONG) && (record->count == TIMESYNC_PONG_SIZE))
+    {
+        if (rx_us == 0u)
+        {
+            rx_us = 1u;
+        }
+        ts->have_pong = true;
+        ts->pong_seq = p[0];
+        ts->pong_t4 = rx_us;
+        ts->residual_us = (int16_t)get_u16(&p[5]);
+        ts->min_delay_us = get_u16(&p[7]);
+        ts->state = p[9];
+        if (p[0] == ts->ping_seq)
+        {
+            ts->rtt_us = rx_us - ts->ping_t1;
+            ts->offset_us = (int32_t)(get_u32(&p[1]) - (ts->ping_t1 + ts->rtt_us / 2u));
+        }
+        ts->pongs++;
+        return true;
+    }
+
+    if ((record->type == FRAME_TYPE_TIMESTAMP) && (record->count == TIMESYNC_STAMP_SIZE))
+    {
+        ts->have_stamp = true;
+        ts->stamp_us = get_u32(p);
+        ts->stamp_state = p[4];
+        ts->stamp_rx_us = rx_us;
+        return true;
+    }
+    return false;
+}
+
+
+uint32_t tsync_host_us(uint64_t ns)
+{
+    return (uint32_t)(ns / 1000u);
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,63 @@
+/*******************************************************************************
+* File Name: timesync_host.h
+*
+* Description: Host side of the board time sync (firmware timesync.h).
+*
+*              One tsync_host_t per board. The application sends the bytes
+*              from tsync_host_ping() to the board a few times per second
+*              and passes every record it receives from that board to
+*              tsync_host_on_record(), which completes the exchanges and
+*              keeps the latest TIMESTAMP. Host times are microseconds of
+*              CLOCK_MONOTONIC modulo 2^32 (tsync_host_us()), the time base
+*              the boards synchronize to.
+*******************************************************************************/
+
+#ifndef TIMESYNC_HOST_H
+#define TIMESYNC_HOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stream_parser.h"
+#include "timesync.h"
+
+#define TSYNC_PING_BYTES    (FRAME_OVERHEAD + TIMESYNC_PING_SIZE)
+
+typedef struct
+{
+    /* exchange bookkeeping */
+    uint8_t  seq;               /* sequence number of the next PING */
+    uint8_t  ping_seq;          /* last PING sent */
+    uint32_t ping_t1;
+    bool     have_pong;
+    uint8_t  pong_seq;          /* last PONG received, reported in the next PING */
+    uint32_t pong_t4;
+
+    /* last PONG */
+    uint8_t  state;             /* TIMESYNC_FREE ... TIMESYNC_LOCKED */
+    int16_t  residual_us;       /* board's last correction */
+    uint16_t min_delay_us;      /* board's delay filter floor */
+    uint32_t rtt_us;            /* round trip of the last exchange */
+    int32_t  offset_us;         /* board time at its reply minus the host
+                                   midpoint of the exchange; approximate */
+
+    /* last TIMESTAMP */
+    bool     have_stamp;
+    uint8_t  stamp_state;
+    uint32_t stamp_us;
+    uint32_t stamp_rx_us;       /* host receive time of the stamp */
+
+    uint64_t pings;
+    uint64_t pongs;
+} tsync_host_t;
+
+void     tsync_host_init(tsync_host_t *ts);
+size_t   tsync_host_ping(tsync_host_t *ts, uint32_t now_us, uint8_t out[TSYNC_PING_BYTES]);
+bool     tsync_host_on_record(tsync_host_t *ts, const stream_record_t *record, uint32_t rx_us);
+uint32_t tsync_host_us(uint64_t ns);
+
+#endif /* TIMESYNC_HOST_H */
+
+
+/* [] END OF FILE */
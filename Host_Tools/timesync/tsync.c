@@ -0,0 +1,194 @@
+/*******************************************************************************
+* File Name: tsync.c
+*
+* Description: Live time sync of one or more boards.
+*
+*              Opens every serial port given on the command line, pings each
+*              board at the given rate and prints, once per interval, every
+*              board's sync state, round trip, last correction and offset
+*              against the host clock, and the age of its last TIMESTAMP.
+*              The boards must be built with TIME_SYNC (globals.h).
+*
+*              A PONG's receive time t4 is the time the reader thread pulled
+*              it off the port (stream_record_t.rx_time_ns), not the time it
+*              reached this loop, so consumer latency does not enter the
+*              exchange.
+*
+*              Usage: tsync [-b baud] [-r ping_hz] [-i interval_s]
+*                           [-s seconds] port ...
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+#include "timesync_host.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static atomic_bool tsync_running = true;
+
+static const char *const tsync_state_names[] = { "free", "acquiring", "locked" };
+
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    tsync_running = false;
+}
+
+
+/*******************************************************************************
+* Function Name: print_status
+********************************************************************************
+* Summary:
+* Prints one line per board.
+*******************************************************************************/
+static void print_status(ingest_t *ingest, const tsync_host_t *boards, int count, uint32_t now_us)
+{
+    printf("\nboard             state       rtt us   resid us  delay us  offset us  stamp age ms  pongs\n");
+    for (int b = 0; b < count; b++)
+    {
+        const tsync_host_t *ts = &boards[b];
+        const char *state = (ts->state < 3u) ? tsync_state_names[ts->state] : "?";
+
+        if (ts->pongs == 0u)
+        {
+            printf("%-16s  no reply (%llu pings)\n", ingest_board_name(ingest, b),
+                   (unsigned long long)ts->pings);
+            continue;
+        }
+        printf("%-16s  %-10s %8u %10d %9u %10d", ingest_board_name(ingest, b), state,
+               ts->rtt_us, ts->residual_us, ts->min_delay_us, ts->offset_us);
+        if (ts->have_stamp)
+        {
+            printf(" %14.1f", (double)(now_us - ts->stamp_rx_us) / 1000.0);
+        }
+        else
+        {
+            printf(" %14s", "-");
+        }
+        printf("  %llu/%llu\n", (unsigned long long)ts->pongs, (unsigned long long)ts->pings);
+    }
+    fflush(stdout);
+}
+
+
+int main(int argc, char **argv)
+{
+    ingest_config_t config = { 0 };
+    unsigned baud = 115200;
+    double ping_hz = 4.0;
+    double interval = 1.0;
+    int seconds = 0;
+    int boards;
+    int opt;
+    ingest_t *ingest;
+    tsync_host_t sync[INGEST_MAX_BOARDS];
+    uint64_t period_ns;
+    uint64_t next_ping;
+    uint64_t next_print;
+    uint64_t deadline;
+
+    while ((opt = getopt(argc, argv, "b:r:i:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': baud = (unsigned)atoi(optarg); break;
+        case 'r': ping_hz = atof(optarg); break;
+        case 'i': interval = atof(optarg); break;
+        case 's': seconds = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] [-r ping_hz] [-i interval_s] [-s seconds] port ...\n", argv[0]);
+            return 2;
+        }
+    }
+    boards = argc - optind;
+    if ((boards < 1) || (boards > INGEST_MAX_BOARDS) || (ping_hz <= 0.0) || (interval <= 0.0))
+    {
+        fprintf(stderr, "usage: %s [-b baud] [-r ping_hz] [-i interval_s] [-s seconds] port ...\n", argv[0]);
+        return 2;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    ingest = ingest_create(&config);
+    if (ingest == NULL)
+    {
+        fprintf(stderr, "cannot create ingest\n");
+        return 1;
+    }
+    for (int b = 0; b < boards; b++)
+    {
+        if (ingest_open(ingest, argv[optind + b], baud) < 0)
+        {
+            fprintf(stderr, "cannot open %s\n", argv[optind + b]);
+            return 1;
+        }
+        tsync_host_init(&sync[b]);
+    }
+    if (ingest_start(ingest) != 0)
+    {
+        fprintf(stderr, "cannot start readers\n");
+        return 1;
+    }
+
+    period_ns = (uint64_t)(1e9 / ping_hz);
+    next_ping = ingest_now_ns();
+    next_print = next_ping + (uint64_t)(interval * 1e9);
+    deadline = (seconds > 0) ? next_ping + (uint64_t)seconds * 1000000000u : UINT64_MAX;
+
+    while (tsync_running && (ingest_now_ns() < deadline))
+    {
+        uint64_t now = ingest_now_ns();
+
+        // pings go out back to back; each board times its own exchange
+        if (now >= next_ping)
+        {
+            for (int b = 0; b < boards; b++)
+            {
+                uint8_t ping[TSYNC_PING_BYTES];
+                size_t length = tsync_host_ping(&sync[b], tsync_host_us(ingest_now_ns()), ping);
+
+                if (ingest_write(ingest, b, ping, length) != (ssize_t)length)
+                {
+                    fprintf(stderr, "%s: write failed\n", ingest_board_name(ingest, b));
+                }
+            }
+            next_ping += period_ns;
+            if (next_ping < now)
+            {
+                next_ping = now + period_ns;
+            }
+        }
+
+        for (int b = 0; b < boards; b++)
+        {
+            const stream_record_t *record;
+
+            while ((record = ingest_peek(ingest, b)) != NULL)
+            {
+                tsync_host_on_record(&sync[b], record, tsync_host_us(record->rx_time_ns));
+                ingest_release(ingest, b);
+            }
+        }
+
+        if (now >= next_print)
+        {
+            print_status(ingest, sync, boards, tsync_host_us(now));
+            next_print += (uint64_t)(interval * 1e9);
+        }
+        usleep(500);
+    }
+
+    ingest_stop(ingest);
+    ingest_destroy(ingest);
+    return 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,364 @@
+/*******************************************************************************
+* File Name: bench_vizrelay.c
+*
+* Description: Load benchmark for the shared-memory relay.
+*
+*              Publishes synthetic records into a viz_shm ring from this
+*              process and forks N subscriber processes that read them, in
+*              three kinds taking turns:
+*                follow   every record in order, as fast as it can
+*                slow     every 4th record, spending 1 ms on each (a
+*                         viewer that cannot keep up)
+*                latest   the newest record at 60 Hz (a display)
+*              Three phases run for the given time each:
+*                alone    writer flat out, no subscribers
+*                loaded   writer flat out, N subscribers
+*                paced    writer at the given record rate, N subscribers
+*              The first two show that subscribers do not hold the writer
+*              back (on a machine with few cores they still compete with it
+*              for CPU time); the third gives each kind's delivery, loss
+*              and latency at a board's data rate.
+*
+*              Usage: bench_vizrelay [-c clients] [-s seconds] [-r rate]
+*                                    [-v values] [-n slots]
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "viz_shm.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_CLIENTS   512
+#define BENCH_KINDS         3
+
+typedef enum
+{
+    BENCH_FOLLOW,
+    BENCH_SLOW,
+    BENCH_LATEST
+} bench_kind_t;
+
+static const char *const bench_kind_names[BENCH_KINDS] = { "follow", "slow", "latest" };
+
+typedef struct
+{
+    uint64_t received;
+    uint64_t lost;
+    uint64_t latency_sum_ns;
+    uint64_t latency_max_ns;
+    uint64_t mismatched;        /* records whose values do not match their index */
+    int      ok;
+} bench_result_t;
+
+/* Shared with the forked subscribers */
+typedef struct
+{
+    atomic_int  ready;
+    atomic_bool go;
+    atomic_bool stop;
+    bench_result_t results[BENCH_MAX_CLIENTS];
+} bench_shared_t;
+
+static char bench_name[64];
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+* Function Name: run_client
+********************************************************************************
+* Summary:
+* Body of a forked subscriber.
+*******************************************************************************/
+static void run_client(bench_shared_t *shared, int index, bench_kind_t kind)
+{
+    bench_result_t *result = &shared->results[index];
+    viz_reader_t *reader = viz_reader_open(bench_name);
+    viz_record_t record;
+    uint64_t lost_before;
+
+    atomic_fetch_add(&shared->ready, 1);
+    if (reader == NULL)
+    {
+        return;
+    }
+    if (kind == BENCH_SLOW)
+    {
+        viz_reader_set_decimation(reader, 4);
+    }
+    while (!atomic_load(&shared->go))
+    {
+        usleep(100);
+    }
+    // records published before the start are not this phase's
+    if (kind != BENCH_LATEST)
+    {
+        while (viz_reader_next(reader, &record) != 0)
+        {
+        }
+    }
+    lost_before = viz_reader_lost(reader);
+
+    while (!atomic_load(&shared->stop))
+    {
+        int got = (kind == BENCH_LATEST) ? viz_reader_latest(reader, &record) : viz_reader_next(reader, &record);
+
+        if (got)
+        {
+            uint64_t latency = now_ns() - record.rx_time_ns;
+
+            result->received++;
+            if (record.values[0] != (int32_t)(record.index & 0x7FFFu))
+            {
+                result->mismatched++;
+            }
+            result->latency_sum_ns += latency;
+            if (latency > result->latency_max_ns)
+            {
+                result->latency_max_ns = latency;
+            }
+        }
+
+        if (kind == BENCH_LATEST)
+        {
+            usleep(16667);
+        }
+        else if (kind == BENCH_SLOW && got)
+        {
+            usleep(1000);
+        }
+        else if (!got)
+        {
+            usleep(100);
+        }
+    }
+    result->lost = viz_reader_lost(reader) - lost_before;
+    result->ok = 1;
+    viz_reader_close(reader);
+}
+
+
+/*******************************************************************************
+* Function Name: run_phase
+********************************************************************************
+* Summary:
+* Forks the subscribers, publishes for the given time and collects the
+* results.
+*
+* Return:
+* Records published per second.
+*******************************************************************************/
+static double run_phase(viz_writer_t *writer, bench_shared_t *shared, int clients, double seconds,
+                        double rate, unsigned values)
+{
+    pid_t pids[BENCH_MAX_CLIENTS];
+    int32_t data[VIZ_MAX_VALUES];
+    uint64_t start;
+    uint64_t end;
+    uint64_t published = 0;
+    uint64_t period_ns = (rate > 0.0) ? (uint64_t)(1e9 / rate) : 0u;
+    uint64_t next;
+
+    memset(shared, 0, sizeof(*shared));
+    for (int c = 0; c < clients; c++)
+    {
+        pids[c] = fork();
+        if (pids[c] == 0)
+        {
+            run_client(shared, c, (bench_kind_t)(c % BENCH_KINDS));
+            _exit(0);
+        }
+    }
+    while (atomic_load(&shared->ready) < clients)
+    {
+        usleep(1000);
+    }
+    atomic_store(&shared->go, true);
+
+    for (unsigned i = 0; i < values; i++)
+    {
+        data[i] = 1000 + (int32_t)i * 37;
+    }
+
+    start = now_ns();
+    end = start + (uint64_t)(seconds * 1e9);
+    next = start;
+    for (;;)
+    {
+        uint64_t now = now_ns();
+
+        if (now >= end)
+        {
+            break;
+        }
+        if (period_ns != 0u)
+        {
+            if (now < next)
+            {
+                struct timespec pause = { 0, (long)(next - now) };
+
+                nanosleep(&pause, NULL);
+                continue;
+            }
+            next += period_ns;
+        }
+        data[0] = (int32_t)(viz_writer_published(writer) & 0x7FFFu);
+        viz_writer_publish(writer, data, (uint16_t)values, now, 0u, 0u);
+        published++;
+    }
+    end = now_ns();
+
+    atomic_store(&shared->stop, true);
+    for (int c = 0; c < clients; c++)
+    {
+        waitpid(pids[c], NULL, 0);
+    }
+    return (double)published / ((double)(end - start) / 1e9);
+}
+
+
+/*******************************************************************************
+* Function Name: print_clients
+********************************************************************************
+* Summary:
+* Prints one line per subscriber kind.
+*******************************************************************************/
+static void print_clients(const bench_shared_t *shared, int clients, double seconds)
+{
+    printf("  %-8s %8s %12s %12s %12s %12s\n", "kind", "clients", "rec/s each", "lost/s each", "mean lat us", "max lat us");
+    for (int k = 0; k < BENCH_KINDS; k++)
+    {
+        uint64_t received = 0;
+        uint64_t lost = 0;
+        uint64_t latency_sum = 0;
+        uint64_t latency_max = 0;
+        uint64_t mismatched = 0;
+        int n = 0;
+        int failed = 0;
+
+        for (int c = k; c < clients; c += BENCH_KINDS)
+        {
+            const bench_result_t *r = &shared->results[c];
+
+            if (!r->ok)
+            {
+                failed++;
+                continue;
+            }
+            n++;
+            received += r->received;
+            lost += r->lost;
+            latency_sum += r->latency_sum_ns;
+            mismatched += r->mismatched;
+            if (r->latency_max_ns > latency_max)
+            {
+                latency_max = r->latency_max_ns;
+            }
+        }
+        if (n == 0)
+        {
+            continue;
+        }
+        printf("  %-8s %8d %12.0f %12.0f %12.1f %12.1f", bench_kind_names[k], n,
+               (double)received / n / seconds, (double)lost / n / seconds,
+               (received > 0u) ? (double)latency_sum / (double)received / 1000.0 : 0.0,
+               (double)latency_max / 1000.0);
+        if (mismatched > 0u)
+        {
+            printf("  %llu TORN", (unsigned long long)mismatched);
+        }
+        if (failed > 0)
+        {
+            printf("  (%d failed)", failed);
+        }
+        putchar('\n');
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    int clients = 48;
+    double seconds = 3.0;
+    double rate = 2000.0;
+    unsigned values = 16;
+    unsigned slots = VIZ_DEFAULT_SLOTS;
+    int opt;
+    viz_writer_t *writer;
+    bench_shared_t *shared;
+    double alone;
+    double loaded;
+    double paced;
+
+    while ((opt = getopt(argc, argv, "c:s:r:v:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': clients = atoi(optarg); break;
+        case 's': seconds = atof(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'v': values = (unsigned)atoi(optarg); break;
+        case 'n': slots = (unsigned)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-c clients] [-s seconds] [-r rate] [-v values] [-n slots]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((clients < 1) || (clients > BENCH_MAX_CLIENTS) || (seconds <= 0.0) || (rate <= 0.0) ||
+        (values < 1u) || (values > VIZ_MAX_VALUES))
+    {
+        fprintf(stderr, "bad configuration (1..%d clients, 1..%d values)\n", BENCH_MAX_CLIENTS, VIZ_MAX_VALUES);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    snprintf(bench_name, sizeof(bench_name), "/vizbench.%d", (int)getpid());
+    writer = viz_writer_create(bench_name, slots);
+    if (writer == NULL)
+    {
+        fprintf(stderr, "cannot create %s: %s (slots must be a power of two)\n", bench_name, strerror(errno));
+        return 1;
+    }
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        viz_writer_destroy(writer);
+        return 1;
+    }
+
+    printf("%u slots, %u values per record, %ld CPU(s)\n", slots, values, sysconf(_SC_NPROCESSORS_ONLN));
+
+    alone = run_phase(writer, shared, 0, seconds, 0.0, values);
+    printf("alone:  %12.0f rec/s\n", alone);
+
+    loaded = run_phase(writer, shared, clients, seconds, 0.0, values);
+    printf("loaded: %12.0f rec/s with %d subscribers (%.0f%% of alone)\n", loaded, clients, 100.0 * loaded / alone);
+    print_clients(shared, clients, seconds);
+
+    paced = run_phase(writer, shared, clients, seconds, rate, values);
+    printf("paced:  %12.0f rec/s with %d subscribers (target %.0f)\n", paced, clients, rate);
+    print_clients(shared, clients, seconds);
+
+    munmap(shared, sizeof(*shared));
+    viz_writer_destroy(writer);
+    return 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,461 @@
+/*******************************************************************************
+* File Name: viz_shm.c
+*
+* Description: Shared-memory fan-out ring. See viz_shm.h.
+*
+*              Slot protocol (seqlock): the writer stores 2n+1 in the slot's
+*              seq, fills it, then stores 2n+2 and advances published to n+1.
+*              A reader of record n loads seq, copies the slot, and loads seq
+*              again; the copy is good only if both loads read 2n+2.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "viz_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Attempts to read the newest record before giving up for this call */
+#define VIZ_LATEST_TRIES    4
+
+struct viz_writer
+{
+    viz_shm_t *shm;
+    size_t     size;
+    uint64_t   next;            /* index of the next record; only the writer moves it */
+    uint32_t   mask;
+    char       name[64];
+};
+
+struct viz_reader
+{
+    const viz_shm_t *shm;
+    size_t   size;
+    uint32_t mask;
+    uint64_t cursor;            /* next record viz_reader_next returns */
+    uint64_t last_latest;       /* record viz_reader_latest returned last, + 1 */
+    uint64_t lost;
+    unsigned every;
+};
+
+typedef enum
+{
+    VIZ_READ_OK,
+    VIZ_READ_NOT_READY,
+    VIZ_READ_OVERWRITTEN
+} viz_read_t;
+
+
+static size_t viz_size(uint32_t slot_count)
+{
+    return sizeof(viz_shm_t) + ((size_t)slot_count * sizeof(viz_slot_t));
+}
+
+
+/*******************************************************************************
+* Function Name: viz_writer_create
+********************************************************************************
+* Summary:
+* Creates (or replaces) the shared memory object and maps it.
+*
+* Return:
+* The writer, or NULL with errno set.
+*******************************************************************************/
+viz_writer_t *viz_writer_create(const char *name, uint32_t slot_count)
+{
+    viz_writer_t *writer;
+    int fd;
+
+    if ((slot_count < 2u) || ((slot_count & (slot_count - 1u)) != 0u) || (strlen(name) >= sizeof(writer->name)))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    writer = calloc(1, sizeof(*writer));
+    if (writer == NULL)
+    {
+        return NULL;
+    }
+    snprintf(writer->name, sizeof(writer->name), "%s", name);
+    writer->size = viz_size(slot_count);
+    writer->mask = slot_count - 1u;
+
+    // a stale segment of a crashed relay is replaced; clients still mapping
+    // it keep the old one and see no progress
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        free(writer);
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)writer->size) != 0)
+    {
+        int saved = errno;
+        close(fd);
+        shm_unlink(name);
+        free(writer);
+        errno = saved;
+        return NULL;
+    }
+
+    writer->shm = mmap(NULL, writer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (writer->shm == MAP_FAILED)
+    {
+        int saved = errno;
+        shm_unlink(name);
+        free(writer);
+        errno = saved;
+        return NULL;
+    }
+
+    // ftruncate zero-fills: every seq is 0, which matches no record.
+    // magic goes last so a client never attaches to a half-built header.
+    writer->shm->slot_count = slot_count;
+    writer->shm->slot_size = (uint32_t)sizeof(viz_slot_t);
+    atomic_thread_fence(memory_order_release);
+    writer->shm->magic = VIZ_SHM_MAGIC;
+    return writer;
+}
+
+
+/*******************************************************************************
+* Function Name: viz_writer_destroy
+********************************************************************************
+* Summary:
+* Unmaps and removes the shared memory object. Attached clients keep their
+* mapping and simply see no more records.
+*******************************************************************************/
+void viz_writer_destroy(viz_writer_t *writer)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+    munmap(writer->shm, writer->size);
+    shm_unlink(writer->name);
+    free(writer);
+}
+
+
+/*******************************************************************************
+* Function Name: viz_writer_set_layout
+********************************************************************************
+* Summary:
+* Stores the board's layout descriptor in the header. Called once, when the
+* layout frame arrives; readers ignore it until layout_valid is set.
+*******************************************************************************/
+void viz_writer_set_layout(viz_writer_t *writer, const uint8_t *layout, size_t length)
+{
+    if (length > VIZ_LAYOUT_BYTES)
+    {
+        length = VIZ_LAYOUT_BYTES;
+    }
+    atomic_store_explicit(&writer->shm->layout_valid, 0u, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memset(writer->shm->layout, 0, VIZ_LAYOUT_BYTES);
+    memcpy(writer->shm->layout, layout, length);
+    atomic_store_explicit(&writer->shm->layout_valid, 1u, memory_order_release);
+}
+
+
+/*******************************************************************************
+* Function Name: viz_writer_publish
+********************************************************************************
+* Summary:
+* Writes one record into the oldest slot. Never waits for readers.
+*******************************************************************************/
+void viz_writer_publish(viz_writer_t *writer, const int32_t *values, uint16_t count,
+                        uint64_t rx_time_ns, uint32_t stamp_us, uint16_t flags)
+{
+    uint64_t n = writer->next;
+    viz_slot_t *slot = &writer->shm->slots[n & writer->mask];
+
+    if (count > VIZ_MAX_VALUES)
+    {
+        count = VIZ_MAX_VALUES;
+    }
+
+    atomic_store_explicit(&slot->seq, (2u * n) + 1u, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->rx_time_ns = rx_time_ns;
+    slot->stamp_us = stamp_us;
+    slot->flags = flags;
+    slot->count = count;
+    memcpy(slot->values, values, (size_t)count * sizeof(int32_t));
+
+    atomic_store_explicit(&slot->seq, (2u * n) + 2u, memory_order_release);
+    writer->next = n + 1u;
+    atomic_store_explicit(&writer->shm->published, n + 1u, memory_order_release);
+}
+
+
+void viz_writer_heartbeat(viz_writer_t *writer, uint64_t now_ns)
+{
+    atomic_store_explicit(&writer->shm->heartbeat_ns, now_ns, memory_order_relaxed);
+}
+
+
+uint64_t viz_writer_published(const viz_writer_t *writer)
+{
+    return writer->next;
+}
+
+
+/*******************************************************************************
+* Function Name: viz_reader_open
+********************************************************************************
+* Summary:
+* Maps the shared memory object read-only. The reader starts at the newest
+* record: viz_reader_next returns what is published after this call.
+*
+* Return:
+* The reader, or NULL with errno set (ENOENT: no relay running; EPROTO: the
+* segment was written by an incompatible build).
+*******************************************************************************/
+viz_reader_t *viz_reader_open(const char *name)
+{
+    viz_reader_t *reader;
+    struct stat st;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(viz_shm_t)))
+    {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+    reader->size = (size_t)st.st_size;
+    reader->shm = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (reader->shm == MAP_FAILED)
+    {
+        free(reader);
+        return NULL;
+    }
+
+    if ((reader->shm->magic != VIZ_SHM_MAGIC) || (reader->shm->slot_size != sizeof(viz_slot_t)) ||
+        (viz_size(reader->shm->slot_count) != reader->size))
+    {
+        munmap((void *)reader->shm, reader->size);
+        free(reader);
+        errno = EPROTO;
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    reader->mask = reader->shm->slot_count - 1u;
+    reader->cursor = atomic_load_explicit(&reader->shm->published, memory_order_acquire);
+    reader->every = 1u;
+    return reader;
+}
+
+
+void viz_reader_close(viz_reader_t *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+    munmap((void *)reader->shm, reader->size);
+    free(reader);
+}
+
+
+/*******************************************************************************
+* Function Name: viz_reader_set_decimation
+********************************************************************************
+* Summary:
+* Makes viz_reader_next return only records whose index is a multiple of
+* every (1 = all records).
+*******************************************************************************/
+void viz_reader_set_decimation(viz_reader_t *reader, unsigned every)
+{
+    reader->every = (every == 0u) ? 1u : every;
+}
+
+
+/*******************************************************************************
+* Function Name: viz_read_slot
+********************************************************************************
+* Summary:
+* Copies record n out of its slot.
+*
+* Return:
+* VIZ_READ_OK, VIZ_READ_NOT_READY if n is not complete yet, or
+* VIZ_READ_OVERWRITTEN if the writer has reused the slot.
+*******************************************************************************/
+static viz_read_t viz_read_slot(const viz_reader_t *reader, uint64_t n, viz_record_t *out)
+{
+    const viz_slot_t *slot = &reader->shm->slots[n & reader->mask];
+    uint64_t expected = (2u * n) + 2u;
+    uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    uint16_t count;
+
+    if (seq != expected)
+    {
+        return (seq > expected) ? VIZ_READ_OVERWRITTEN : VIZ_READ_NOT_READY;
+    }
+
+    out->index = n;
+    out->rx_time_ns = slot->rx_time_ns;
+    out->stamp_us = slot->stamp_us;
+    out->flags = slot->flags;
+    count = slot->count;
+    // a torn count is caught by the second seq check below, but must not
+    // overrun values meanwhile
+    out->count = (count > VIZ_MAX_VALUES) ? VIZ_MAX_VALUES : count;
+    memcpy(out->values, (const void *)slot->values, (size_t)out->count * sizeof(int32_t));
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != expected)
+    {
+        return VIZ_READ_OVERWRITTEN;
+    }
+    return VIZ_READ_OK;
+}
+
+
+/*******************************************************************************
+* Function Name: viz_reader_next
+********************************************************************************
+* Summary:
+* Returns the next record in order (subject to the decimation). A reader
+* more than a ring behind, or whose record was overwritten while it copied
+* it, continues at the newest record; the records skipped count as lost.
+*
+* Return:
+* 1 with *out filled, 0 if there is no new record yet.
+*******************************************************************************/
+int viz_reader_next(viz_reader_t *reader, viz_record_t *out)
+{
+    for (;;)
+    {
+        uint64_t published = atomic_load_explicit(&reader->shm->published, memory_order_acquire);
+        uint64_t n = reader->cursor;
+
+        if (reader->every > 1u)
+        {
+            n += (reader->every - (n % reader->every)) % reader->every;
+        }
+        if (n >= published)
+        {
+            return 0;
+        }
+
+        if ((published - n) > reader->mask)
+        {
+            uint64_t newest = published - 1u;
+
+            if (reader->every > 1u)
+            {
+                newest -= newest % reader->every;
+            }
+            reader->lost += (newest - n) / reader->every;
+            n = newest;
+        }
+
+        switch (viz_read_slot(reader, n, out))
+        {
+        case VIZ_READ_OK:
+            reader->cursor = n + 1u;
+            return 1;
+        case VIZ_READ_NOT_READY:
+            return 0;
+        case VIZ_READ_OVERWRITTEN:
+        default:
+            reader->lost++;
+            reader->cursor = n + 1u;
+            break;
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: viz_reader_latest
+********************************************************************************
+* Summary:
+* Returns the newest record, if it is newer than the one this call returned
+* last. Independent of the viz_reader_next cursor.
+*
+* Return:
+* 1 with *out filled, 0 if nothing new.
+*******************************************************************************/
+int viz_reader_latest(viz_reader_t *reader, viz_record_t *out)
+{
+    for (int tries = 0; tries < VIZ_LATEST_TRIES; tries++)
+    {
+        uint64_t published = atomic_load_explicit(&reader->shm->published, memory_order_acquire);
+
+        if (published <= reader->last_latest)
+        {
+            return 0;
+        }
+        if (viz_read_slot(reader, published - 1u, out) == VIZ_READ_OK)
+        {
+            reader->last_latest = published;
+            return 1;
+        }
+        // overwritten while copying: the writer went a whole ring around,
+        // so try the new newest
+    }
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: viz_reader_layout
+********************************************************************************
+* Summary:
+* Copies the board's layout descriptor.
+*
+* Return:
+* false until the relay has seen the layout frame.
+*******************************************************************************/
+bool viz_reader_layout(const viz_reader_t *reader, uint8_t layout[VIZ_LAYOUT_BYTES])
+{
+    if (atomic_load_explicit(&reader->shm->layout_valid, memory_order_acquire) == 0u)
+    {
+        return false;
+    }
+    memcpy(layout, reader->shm->layout, VIZ_LAYOUT_BYTES);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&reader->shm->layout_valid, memory_order_relaxed) != 0u;
+}
+
+
+uint64_t viz_reader_lost(const viz_reader_t *reader)
+{
+    return reader->lost;
+}
+
+
+uint64_t viz_reader_heartbeat_ns(const viz_reader_t *reader)
+{
+    return atomic_load_explicit(&reader->shm->heartbeat_ns, memory_order_relaxed);
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,106 @@
+/*******************************************************************************
+* File Name: viz_shm.h
+*
+* Description: Shared-memory ring that fans one board's stream out to many
+*              local subscribers.
+*
+*              One writer (vizrelay) publishes every CSV line of the board
+*              as a record into a POSIX shared memory object; any number of
+*              processes map it read-only and read the records without
+*              locks and without the writer knowing about them. The writer
+*              never waits: each slot carries a sequence number (a seqlock),
+*              and a reader that finds its slot overwritten or half written
+*              simply skips ahead. A subscriber chooses its view:
+*                next     every record in order; with a decimation of N only
+*                         records whose index is a multiple of N, so all
+*                         clients with the same N show the same frames. A
+*                         client that falls a whole ring behind jumps to the
+*                         newest record and counts the skipped ones as lost.
+*                latest   the newest record, for clients that redraw at
+*                         their own pace.
+*              The layout frame the board sends at start-up
+*              (SENSOR_LAYOUT_DESCRIPTOR) is kept in the header, so clients
+*              know how the values of a record are arranged.
+*
+*              The segment is for processes of one host and one build: it
+*              holds native-endian, native-aligned structs, and clients check
+*              VIZ_SHM_MAGIC and the slot size when they attach.
+*******************************************************************************/
+
+#ifndef VIZ_SHM_H
+#define VIZ_SHM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stream_parser.h"
+
+#define VIZ_SHM_MAGIC       0x315A4956u     /* "VIZ1" */
+#define VIZ_DEFAULT_NAME    "/vizrelay"
+#define VIZ_DEFAULT_SLOTS   1024u
+#define VIZ_MAX_VALUES      STREAM_MAX_VALUES
+#define VIZ_LAYOUT_BYTES    8u
+
+#define VIZ_FLAG_STAMPED    0x0001u         /* stamp_us holds the board's synchronized time */
+
+typedef struct
+{
+    _Atomic uint64_t seq;       /* 2 * index + 1 while written, 2 * index + 2 when complete */
+    uint64_t rx_time_ns;        /* host receive time (CLOCK_MONOTONIC) */
+    uint32_t stamp_us;          /* last TIMESTAMP frame before the line (TIME_SYNC) */
+    uint16_t flags;             /* VIZ_FLAG_* */
+    uint16_t count;             /* values */
+    int32_t  values[VIZ_MAX_VALUES];
+} viz_slot_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t slot_count;        /* power of two */
+    uint32_t slot_size;         /* sizeof(viz_slot_t) of the writer */
+    _Atomic uint32_t layout_valid;
+    uint8_t  layout[VIZ_LAYOUT_BYTES];  /* SENSOR_LAYOUT_DESCRIPTOR, once seen */
+    _Alignas(64) _Atomic uint64_t published;        /* records written so far */
+    _Atomic uint64_t heartbeat_ns;                  /* writer alive, CLOCK_MONOTONIC */
+    _Alignas(64) viz_slot_t slots[];
+} viz_shm_t;
+
+/* A record as handed to a subscriber */
+typedef struct
+{
+    uint64_t index;             /* position in the stream since the writer started */
+    uint64_t rx_time_ns;
+    uint32_t stamp_us;
+    uint16_t flags;
+    uint16_t count;
+    int32_t  values[VIZ_MAX_VALUES];
+} viz_record_t;
+
+typedef struct viz_writer viz_writer_t;
+typedef struct viz_reader viz_reader_t;
+
+/* Writer (one per segment) */
+viz_writer_t *viz_writer_create(const char *name, uint32_t slot_count);
+void viz_writer_destroy(viz_writer_t *writer);
+void viz_writer_set_layout(viz_writer_t *writer, const uint8_t *layout, size_t length);
+void viz_writer_publish(viz_writer_t *writer, const int32_t *values, uint16_t count,
+                        uint64_t rx_time_ns, uint32_t stamp_us, uint16_t flags);
+void viz_writer_heartbeat(viz_writer_t *writer, uint64_t now_ns);
+uint64_t viz_writer_published(const viz_writer_t *writer);
+
+/* Readers (any number, any process) */
+viz_reader_t *viz_reader_open(const char *name);
+void viz_reader_close(viz_reader_t *reader);
+void viz_reader_set_decimation(viz_reader_t *reader, unsigned every);
+int  viz_reader_next(viz_reader_t *reader, viz_record_t *out);
+int  viz_reader_latest(viz_reader_t *reader, viz_record_t *out);
+bool viz_reader_layout(const viz_reader_t *reader, uint8_t layout[VIZ_LAYOUT_BYTES]);
+uint64_t viz_reader_lost(const viz_reader_t *reader);
+uint64_t viz_reader_heartbeat_ns(const viz_reader_t *reader);
+
+#endif /* VIZ_SHM_H */
+
+
+/* [] END OF FILE */
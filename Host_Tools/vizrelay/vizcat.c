@@ -0,0 +1,130 @@
+/*******************************************************************************
+* File Name: vizcat.c
+*
+* Description: Minimal viewer of the relay: prints records as CSV lines.
+*
+*              The reference for a dashboard's read loop, and a way to feed
+*              viewers in other languages through a pipe. By default it
+*              follows every record (or every N-th with -d); with -l it
+*              prints the latest record at the given rate instead, which is
+*              what a display refreshing at its own pace wants.
+*
+*              Each line is: index, host receive time in us, board stamp in
+*              us (blank without TIME_SYNC), then the values. The records a
+*              slow consumer missed are reported on stderr at exit.
+*
+*              Usage: vizcat [-n shm_name] [-d every] [-l hz] [-c count]
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "viz_shm.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static atomic_bool cat_running = true;
+
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    cat_running = false;
+}
+
+
+static void print_record(const viz_record_t *record)
+{
+    printf("%llu,%llu,", (unsigned long long)record->index, (unsigned long long)(record->rx_time_ns / 1000u));
+    if ((record->flags & VIZ_FLAG_STAMPED) != 0u)
+    {
+        printf("%lu", (unsigned long)record->stamp_us);
+    }
+    for (unsigned i = 0; i < record->count; i++)
+    {
+        printf(",%ld", (long)record->values[i]);
+    }
+    putchar('\n');
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *name = VIZ_DEFAULT_NAME;
+    unsigned every = 1;
+    double latest_hz = 0.0;
+    long count = -1;
+    int opt;
+    viz_reader_t *reader;
+    viz_record_t record;
+    uint8_t layout[VIZ_LAYOUT_BYTES];
+
+    while ((opt = getopt(argc, argv, "n:d:l:c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': name = optarg; break;
+        case 'd': every = (unsigned)atoi(optarg); break;
+        case 'l': latest_hz = atof(optarg); break;
+        case 'c': count = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n shm_name] [-d every] [-l hz] [-c count]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    reader = viz_reader_open(name);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", name, (errno == ENOENT) ? "no relay running" : strerror(errno));
+        return 1;
+    }
+    viz_reader_set_decimation(reader, every);
+
+    if (viz_reader_layout(reader, layout))
+    {
+        fprintf(stderr, "layout: version %u, %u sensors, %u modes\n", layout[0], layout[1], layout[2]);
+    }
+
+    while (cat_running && (count != 0))
+    {
+        int got = (latest_hz > 0.0) ? viz_reader_latest(reader, &record) : viz_reader_next(reader, &record);
+
+        if (got)
+        {
+            print_record(&record);
+            if (count > 0)
+            {
+                count--;
+            }
+        }
+        if (latest_hz > 0.0)
+        {
+            fflush(stdout);
+            usleep((useconds_t)(1e6 / latest_hz));
+        }
+        else if (!got)
+        {
+            fflush(stdout);
+            usleep(500);
+        }
+    }
+    fflush(stdout);
+
+    if (viz_reader_lost(reader) > 0u)
+    {
+        fprintf(stderr, "%llu records skipped\n", (unsigned long long)viz_reader_lost(reader));
+    }
+    viz_reader_close(reader);
+    return 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,172 @@
+/*******************************************************************************
+* File Name: vizrelay.c
+*
+* Description: Relays one board's stream to any number of local viewers.
+*
+*              Reads the board once (serial port, pipe or recording, through
+*              ingest) and publishes every CSV line into the shared-memory
+*              ring of viz_shm.h. Viewers attach with viz_reader_open and
+*              never slow the relay down: a viewer that cannot keep up
+*              skips records, the relay and the other viewers do not notice.
+*              The board's layout frame is kept for viewers that attach
+*              later, and a TIMESTAMP frame (firmware TIME_SYNC) stamps the
+*              line after it.
+*
+*              Prints, once per interval, the records relayed per second and
+*              the ingest and parser counters.
+*
+*              Usage: vizrelay [-b baud] [-n shm_name] [-s slots]
+*                              [-i interval_s] port
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+#include "viz_shm.h"
+#include "frame.h"
+#include "timesync.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static atomic_bool relay_running = true;
+
+
+static void on_signal(int signum)
+{
+    (void)signum;
+    relay_running = false;
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-b baud] [-n shm_name] [-s slots] [-i interval_s] port\n", name);
+}
+
+
+int main(int argc, char **argv)
+{
+    ingest_config_t config = { 0 };
+    const char *name = VIZ_DEFAULT_NAME;
+    unsigned baud = 115200;
+    unsigned slots = VIZ_DEFAULT_SLOTS;
+    double interval = 1.0;
+    int opt;
+    ingest_t *ingest;
+    viz_writer_t *writer;
+    uint32_t stamp_us = 0;
+    bool stamp_pending = false;
+    uint64_t next_print;
+    uint64_t last_published = 0;
+
+    while ((opt = getopt(argc, argv, "b:n:s:i:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': baud = (unsigned)atoi(optarg); break;
+        case 'n': name = optarg; break;
+        case 's': slots = (unsigned)strtoul(optarg, NULL, 0); break;
+        case 'i': interval = atof(optarg); break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (((argc - optind) != 1) || (interval <= 0.0))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    writer = viz_writer_create(name, slots);
+    if (writer == NULL)
+    {
+        perror("cannot create shared memory (slots must be a power of two)");
+        return 1;
+    }
+
+    // one board, one consumer: a deep queue absorbs scheduling hiccups of
+    // this loop without the reader thread dropping lines
+    config.reader_threads = 1;
+    config.queue_capacity = 16384;
+    ingest = ingest_create(&config);
+    if ((ingest == NULL) || (ingest_open(ingest, argv[optind], baud) < 0) || (ingest_start(ingest) != 0))
+    {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        viz_writer_destroy(writer);
+        return 1;
+    }
+
+    printf("relaying %s to %s (%u slots)\n", argv[optind], name, slots);
+    fflush(stdout);
+    next_print = ingest_now_ns() + (uint64_t)(interval * 1e9);
+
+    while (relay_running)
+    {
+        const stream_record_t *record;
+        uint64_t now;
+        ingest_board_stats_t stats;
+
+        while ((record = ingest_peek(ingest, 0)) != NULL)
+        {
+            if (record->kind == STREAM_KIND_CSV)
+            {
+                viz_writer_publish(writer, record->data.values, record->count, record->rx_time_ns,
+                                   stamp_us, stamp_pending ? VIZ_FLAG_STAMPED : 0u);
+                stamp_pending = false;
+            }
+            else if (record->type == FRAME_TYPE_LAYOUT)
+            {
+                viz_writer_set_layout(writer, record->data.payload, record->count);
+            }
+            else if ((record->type == FRAME_TYPE_TIMESTAMP) && (record->count == TIMESYNC_STAMP_SIZE))
+            {
+                const uint8_t *p = record->data.payload;
+
+                stamp_us = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+                stamp_pending = true;
+            }
+            ingest_release(ingest, 0);
+        }
+
+        now = ingest_now_ns();
+        viz_writer_heartbeat(writer, now);
+
+        ingest_get_stats(ingest, 0, &stats);
+        if (stats.eof && (ingest_peek(ingest, 0) == NULL))
+        {
+            printf("%s: end of stream\n", argv[optind]);
+            break;
+        }
+
+        if (now >= next_print)
+        {
+            uint64_t published = viz_writer_published(writer);
+
+            printf("%8.1f rec/s  published %llu  dropped %llu  crc %llu  syntax %llu\n",
+                   (double)(published - last_published) / interval, (unsigned long long)published,
+                   (unsigned long long)stats.dropped, (unsigned long long)stats.parser.crc_errors,
+                   (unsigned long long)stats.parser.syntax_errors);
+            fflush(stdout);
+            last_published = published;
+            next_print += (uint64_t)(interval * 1e9);
+        }
+        usleep(200);
+    }
+
+    ingest_stop(ingest);
+    ingest_destroy(ingest);
+    viz_writer_destroy(writer);
+    return 0;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,296 @@
+/*******************************************************************************
+* File Name: xtload.c
+*
+* Description: Loads a crosstalk decoupling matrix into a board's flash
+*              (firmware CROSSTALK_COMPENSATION, crosstalk.h).
+*
+*              The matrix file is CSV, one row of the matrix per line:
+*                mode,sensor,left,self,right
+*              with mode and sensor as in the CALIBRATION_MODE rows and the
+*              coefficients applied to the signals of sensors sensor-1,
+*              sensor and sensor+1, as decimals (1.0 leaves the signal as
+*              it is; taps off the edge of the array are ignored). Empty
+*              lines and lines starting with '#' are skipped. Rows not in the
+*              file keep their stored value, or the identity on a board
+*              without a stored matrix.
+*
+*              The rows are written in turn, waiting for the board's XT_ACK
+*              after each command, and the matrix is stored with one commit
+*              at the end. With -d, the stored matrix is erased instead and
+*              the board passes its signals through.
+*
+*              Usage: xtload [-b baud] port matrix.csv
+*                     xtload [-b baud] -d port
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include "ingest.h"
+#include "crosstalk.h"
+#include "frame.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define XTLOAD_ACK_TIMEOUT_NS   (2000000000ull)     /* flash write takes ~20 ms per row */
+#define XTLOAD_MAX_ROWS         (256)
+
+#if (CROSSTALK_TAPS != 3u)
+#error "The matrix file format has three taps per row"
+#endif
+
+typedef struct
+{
+    uint8_t mode;
+    uint8_t sensor;
+    int16_t coeffs[CROSSTALK_TAPS];
+} xtload_row_t;
+
+static const char *const xtload_status_names[] =
+{
+    "ok", "bad channel", "bad length", "flash error"
+};
+
+
+/*******************************************************************************
+* Function Name: load_matrix
+********************************************************************************
+* Summary:
+* Reads the CSV file and converts the coefficients to the board's Q format.
+*
+* Return:
+* Number of rows, or -1 after printing the error.
+*******************************************************************************/
+static int load_matrix(const char *path, xtload_row_t *rows)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int count = 0;
+    int number = 0;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        int mode;
+        int sensor;
+        double c[CROSSTALK_TAPS];
+
+        number++;
+        if ((line[0] == '#') || (line[strspn(line, " \t\r\n")] == '\0'))
+        {
+            continue;
+        }
+        if ((sscanf(line, "%d,%d,%lf,%lf,%lf", &mode, &sensor, &c[0], &c[1], &c[2]) != 5) ||
+            (mode < 0) || (mode > 255) || (sensor < 0) || (sensor > 255))
+        {
+            fprintf(stderr, "%s:%d: expected mode,sensor,left,self,right\n", path, number);
+            fclose(file);
+            return -1;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if ((rows[i].mode == mode) && (rows[i].sensor == sensor))
+            {
+                fprintf(stderr, "%s:%d: mode %d sensor %d given twice\n", path, number, mode, sensor);
+                fclose(file);
+                return -1;
+            }
+        }
+        if (count == XTLOAD_MAX_ROWS)
+        {
+            fprintf(stderr, "%s:%d: too many rows\n", path, number);
+            fclose(file);
+            return -1;
+        }
+
+        rows[count].mode = (uint8_t)mode;
+        rows[count].sensor = (uint8_t)sensor;
+        for (unsigned k = 0; k < CROSSTALK_TAPS; k++)
+        {
+            double q = round(c[k] * CROSSTALK_ONE);
+
+            if (!(q >= INT16_MIN) || !(q <= INT16_MAX))
+            {
+                fprintf(stderr, "%s:%d: coefficient %g outside +-%g\n", path, number, c[k],
+                        (double)INT16_MAX / CROSSTALK_ONE);
+                fclose(file);
+                return -1;
+            }
+            rows[count].coeffs[k] = (int16_t)q;
+        }
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+
+/*******************************************************************************
+* Function Name: command
+********************************************************************************
+* Summary:
+* Sends one crosstalk command and waits for the XT_ACK for the given mode and
+* sensor, skipping the data the board streams meanwhile.
+*
+* Return:
+* The XT_ACK status, or -1 on a timeout or write error.
+*******************************************************************************/
+static int command(ingest_t *ingest, uint8_t type, const uint8_t *payload, uint8_t length,
+                   uint8_t mode, uint8_t sensor)
+{
+    uint8_t frame[FRAME_OVERHEAD + FRAME_MAX_PAYLOAD];
+    uint8_t crc = stream_crc8(stream_crc8(0, type), length);
+    size_t n = 0;
+    uint64_t deadline;
+
+    frame[n++] = FRAME_SYNC_0;
+    frame[n++] = FRAME_SYNC_1;
+    frame[n++] = type;
+    frame[n++] = length;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        frame[n++] = payload[i];
+        crc = stream_crc8(crc, payload[i]);
+    }
+    frame[n++] = crc;
+
+    if (ingest_write(ingest, 0, frame, n) != (ssize_t)n)
+    {
+        return -1;
+    }
+
+    deadline = ingest_now_ns() + XTLOAD_ACK_TIMEOUT_NS;
+    while (ingest_now_ns() < deadline)
+    {
+        stream_record_t record;
+
+        if (!ingest_pop(ingest, 0, &record))
+        {
+            usleep(1000);
+            continue;
+        }
+        if ((record.kind == STREAM_KIND_FRAME) && (record.type == FRAME_TYPE_XT_ACK) &&
+            (record.count == CROSSTALK_ACK_SIZE) &&
+            (record.data.payload[0] == mode) && (record.data.payload[1] == sensor))
+        {
+            return record.data.payload[2];
+        }
+    }
+    return -1;
+}
+
+
+/*******************************************************************************
+* Function Name: report
+********************************************************************************
+* Summary:
+* Prints a failed command.
+*
+* Return:
+* true if the command succeeded.
+*******************************************************************************/
+static bool report(const char *what, int status)
+{
+    if (status == CROSSTALK_OK)
+    {
+        return true;
+    }
+    fprintf(stderr, "%s failed: %s\n", what,
+            (status < 0) ? "no answer (is the board built with CROSSTALK_COMPENSATION?)" :
+            ((status < 4) ? xtload_status_names[status] : "unknown status"));
+    return false;
+}
+
+
+int main(int argc, char **argv)
+{
+    ingest_config_t config = { 0 };
+    unsigned baud = 115200;
+    int remove = 0;
+    int opt;
+    int count = 0;
+    bool ok = true;
+    ingest_t *ingest;
+    uint8_t payload[CROSSTALK_WRITE_SIZE];
+    static xtload_row_t rows[XTLOAD_MAX_ROWS];
+
+    while ((opt = getopt(argc, argv, "b:d")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': baud = (unsigned)atoi(optarg); break;
+        case 'd': remove = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] port matrix.csv | %s [-b baud] -d port\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if ((argc - optind) != (remove ? 1 : 2))
+    {
+        fprintf(stderr, "usage: %s [-b baud] port matrix.csv | %s [-b baud] -d port\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    if (!remove)
+    {
+        count = load_matrix(argv[optind + 1], rows);
+        if (count <= 0)
+        {
+            if (count == 0)
+            {
+                fprintf(stderr, "%s: no rows\n", argv[optind + 1]);
+            }
+            return 1;
+        }
+    }
+
+    ingest = ingest_create(&config);
+    if ((ingest == NULL) || (ingest_open(ingest, argv[optind], baud) < 0) || (ingest_start(ingest) != 0))
+    {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        return 1;
+    }
+
+    for (int r = 0; ok && (r < count); r++)
+    {
+        char what[48];
+
+        payload[0] = rows[r].mode;
+        payload[1] = rows[r].sensor;
+        for (unsigned k = 0; k < CROSSTALK_TAPS; k++)
+        {
+            uint16_t c = (uint16_t)rows[r].coeffs[k];
+
+            payload[CROSSTALK_WRITE_HEADER + (2u * k)] = (uint8_t)c;
+            payload[CROSSTALK_WRITE_HEADER + (2u * k) + 1u] = (uint8_t)(c >> 8);
+        }
+        snprintf(what, sizeof(what), "mode %u sensor %u: write", rows[r].mode, rows[r].sensor);
+        ok = report(what, command(ingest, FRAME_TYPE_XT_WRITE, payload, CROSSTALK_WRITE_SIZE,
+                                  rows[r].mode, rows[r].sensor));
+    }
+
+    if (ok)
+    {
+        payload[0] = remove ? 0u : 1u;
+        ok = report(remove ? "erase" : "commit",
+                    command(ingest, FRAME_TYPE_XT_COMMIT, payload, CROSSTALK_COMMIT_SIZE,
+                            CROSSTALK_NO_CHANNEL, CROSSTALK_NO_CHANNEL));
+    }
+    if (ok)
+    {
+        printf(remove ? "matrix erased\n" : "matrix stored, %d rows\n", count);
+    }
+
+    ingest_stop(ingest);
+    ingest_destroy(ingest);
+    return ok ? 0 : 1;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,124 @@
+/*******************************************************************************
+* File Name: adaptive.c
+*
+* Description: Step-detecting moving average with a variable window. See
+*              adaptive.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "adaptive.h"
+
+#ifdef ADAPTIVE_FILTER
+
+#define ADAPTIVE_INDEX_MASK     (AVG_FILTER_NUM_SAMPLES - 1u)
+
+
+/*******************************************************************************
+* Function Name: Adaptive_WindowSum
+********************************************************************************
+* Summary:
+* Sums the newest 2^shift samples of a channel's history.
+*
+* Parameters:
+* ch: Channel.
+* shift: log2 of the number of samples.
+*
+* Return:
+* Sum of the samples.
+*******************************************************************************/
+static uint32_t Adaptive_WindowSum(const channel_state_t *ch, uint8_t shift)
+{
+    uint32_t sum = 0;
+    uint8_t index = ch->avg_index;      /* one past the newest sample */
+    uint8_t n;
+
+    for (n = 0; n < (1u << shift); n++)
+    {
+        index = (uint8_t)((index - 1u) & ADAPTIVE_INDEX_MASK);
+        sum += ch->avg_history[index];
+    }
+    return sum;
+}
+
+
+/*******************************************************************************
+* Function Name: Adaptive_Update
+********************************************************************************
+* Summary:
+* Adds one sample to a channel's history and returns the average over the
+* channel's current window, adapting the window to the signal.
+*
+* Parameters:
+* ch: Channel of the sample.
+* sample: Raw count.
+*
+* Return:
+* Filtered count.
+*******************************************************************************/
+uint16_t Adaptive_Update(channel_state_t *ch, uint16_t sample)
+{
+    uint8_t shift = ch->window_shift;
+    uint16_t leaving;
+    int32_t deviation;
+
+    /* Initialize filter state on first sample for this channel */
+    if (!(ch->flags & CHANNEL_FLAG_FILTER_INIT))
+    {
+        for (uint8_t j = 0; j < AVG_FILTER_NUM_SAMPLES; j++)
+        {
+            ch->avg_history[j] = sample;
+        }
+        ch->avg_sum = (uint32_t)sample << AVG_FILTER_SHIFT;
+        ch->avg_index = 0;
+        ch->window_shift = AVG_FILTER_SHIFT;
+        ch->settled_scans = UINT8_MAX;
+        ch->flags |= CHANNEL_FLAG_FILTER_INIT;
+        return sample;
+    }
+
+    // step detector on the running sum: sample * window against the sum
+    deviation = ((int32_t)sample << shift) - (int32_t)ch->avg_sum;
+    if (deviation < 0)
+    {
+        deviation = -deviation;
+    }
+
+    // slide the sample into the history, remembering the one leaving the window
+    leaving = ch->avg_history[(ch->avg_index - (1u << shift)) & ADAPTIVE_INDEX_MASK];
+    ch->avg_history[ch->avg_index] = sample;
+    ch->avg_index = (uint8_t)((ch->avg_index + 1u) & ADAPTIVE_INDEX_MASK);
+
+    if (deviation > ((int32_t)ADAPTIVE_STEP_THRESHOLD << shift))
+    {
+        // fast change: the window restarts at this sample
+        shift = 0u;
+        ch->settled_scans = 1u;
+        ch->avg_sum = sample;
+    }
+    else
+    {
+        ch->avg_sum += sample;
+        ch->avg_sum -= leaving;
+
+        if (ch->settled_scans < UINT8_MAX)
+        {
+            ch->settled_scans++;
+        }
+
+        // relax once the scans since the step fill the doubled window
+        if ((shift < AVG_FILTER_SHIFT) && (ch->settled_scans >= (2u << shift)))
+        {
+            shift++;
+            ch->avg_sum = Adaptive_WindowSum(ch, shift);
+        }
+    }
+    ch->window_shift = shift;
+
+    /* Calculate average, adding (N/2) for proper integer rounding */
+    return (uint16_t)((ch->avg_sum + ((1u << shift) >> 1)) >> shift);
+}
+
+#endif /* ADAPTIVE_FILTER */
+
+
+/* [] END OF FILE */
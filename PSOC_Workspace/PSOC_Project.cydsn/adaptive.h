@@ -0,0 +1,40 @@
+/*******************************************************************************
+* File Name: adaptive.h
+*
+* Description: Motion-adaptive moving average for CALIBRATION_MODE.
+*
+*              Each channel averages the last 2^window_shift scans of its
+*              mode. At rest the window is the full AVG_FILTER_NUM_SAMPLES.
+*              A step detector compares every new sample with the running
+*              sum of the window (sample * window - sum); when they differ
+*              by more than ADAPTIVE_STEP_THRESHOLD counts per sample, the
+*              window restarts at the step sample, which passes through. The
+*              window then doubles each time the scans since the step fill
+*              the larger window (2 scans, 4, ...), so it never averages
+*              across the step.
+*
+*              Group delay is (window - 1) / 2 scans. The window of each
+*              sample is sent in the CALIB_COL_WINDOW column.
+*******************************************************************************/
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Deviation from the window average, in counts, that counts as a step */
+#define ADAPTIVE_STEP_THRESHOLD     (30)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+uint16_t Adaptive_Update(channel_state_t *ch, uint16_t sample);
+
+#endif /* ADAPTIVE_H */
+
+
+/* [] END OF FILE */
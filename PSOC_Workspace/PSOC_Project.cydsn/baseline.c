@@ -0,0 +1,119 @@
+/*******************************************************************************
+* File Name: baseline.c
+*
+* Description: Per-sensor, per-mode baseline tracking. See baseline.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "baseline.h"
+
+#include <stdbool.h>
+
+#if defined(CROSSTALK_COMPENSATION) || defined(CONTACT_LOCALIZATION) || defined(SLIP_DETECTION)
+
+/* Baselines live in channel_state[].baseline_q8, in Q8 so slow tracking does
+*  not stall on integer rounding */
+static bool baseline_valid[SENSOR_MODE_COUNT];
+
+
+/*******************************************************************************
+* Function Name: Baseline_Update
+********************************************************************************
+* Summary:
+* Feeds one scan of a mode into its baselines. The first scan initializes
+* them.
+*
+* Parameters:
+* values: SENSOR_COUNT values of the scan.
+* mode: Mode of the scan.
+*
+* Return:
+* None
+*******************************************************************************/
+void Baseline_Update(const int32_t *values, uint8_t mode)
+{
+    channel_state_t *ch = channel_state[mode];
+    bool touched = false;
+    uint8_t i;
+
+    if (!baseline_valid[mode])
+    {
+        for (i = 0; i < SENSOR_COUNT; i++)
+        {
+            ch[i].baseline_q8 = values[i] << 8;
+        }
+        baseline_valid[mode] = true;
+        return;
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        if ((values[i] - (ch[i].baseline_q8 >> 8)) > BASELINE_TOUCH_BAND)
+        {
+            touched = true;
+        }
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        int32_t difference = (values[i] << 8) - ch[i].baseline_q8;
+
+        if (difference < 0)
+        {
+            // below rest: nothing can press a sensor downwards, follow
+            ch[i].baseline_q8 = (difference < -(BASELINE_TOUCH_BAND << 8)) ? (values[i] << 8) :
+                                (ch[i].baseline_q8 + (difference >> BASELINE_TRACK_SHIFT));
+        }
+        else if (!touched)
+        {
+            ch[i].baseline_q8 += difference >> BASELINE_TRACK_SHIFT;
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Baseline_Get
+********************************************************************************
+* Summary:
+* Returns the baseline of one sensor in one mode.
+*
+* Parameters:
+* mode: Scan mode.
+* sensor: top_plate sensor index.
+*
+* Return:
+* Baseline, in counts.
+*******************************************************************************/
+int32_t Baseline_Get(uint8_t mode, uint8_t sensor)
+{
+    return (channel_state[mode][sensor].baseline_q8 + 128) >> 8;
+}
+
+
+/*******************************************************************************
+* Function Name: Baseline_Reset
+********************************************************************************
+* Summary:
+* Drops every baseline, so the next scan of each mode initializes them again.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Baseline_Reset(void)
+{
+    uint8_t mode;
+
+    for (mode = 0; mode < SENSOR_MODE_COUNT; mode++)
+    {
+        baseline_valid[mode] = false;
+    }
+}
+
+#endif /* CROSSTALK_COMPENSATION || CONTACT_LOCALIZATION || SLIP_DETECTION */
+
+
+/* [] END OF FILE */
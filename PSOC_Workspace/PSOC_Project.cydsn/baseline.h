@@ -0,0 +1,43 @@
+/*******************************************************************************
+* File Name: baseline.h
+*
+* Description: Untouched level of every sensor in every mode, for stages that
+*              work on the signal relative to rest (crosstalk compensation,
+*              localization, slip detection).
+*
+*              The baseline follows slow drift while the array is at rest.
+*              As soon as any sensor of a mode moves further than
+*              BASELINE_TOUCH_BAND from its baseline, every baseline of that
+*              mode is frozen, so neither the pressed taxel nor the ghost
+*              signal on its neighbours is absorbed. A level below the
+*              baseline (e.g. a release after drift) is tracked even while
+*              touched, at the drift speed, and taken over at once when it
+*              is more than BASELINE_TOUCH_BAND below.
+*******************************************************************************/
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Distance from the baseline, in counts, that counts as touched */
+#define BASELINE_TOUCH_BAND     (40)
+
+/* Drift tracking speed: the baseline moves 1/2^N of the difference per scan */
+#define BASELINE_TRACK_SHIFT    (6u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void    Baseline_Update(const int32_t *values, uint8_t mode);
+int32_t Baseline_Get(uint8_t mode, uint8_t sensor);
+void    Baseline_Reset(void);
+
+#endif /* BASELINE_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,466 @@
+/*******************************************************************************
+* File Name: capture.c
+*
+* Description: Triggered ring-buffer capture of raw CapSense frames and the
+*              rate-limited binary dump of the result. See capture.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "globals.h"
+#include "capture.h"
+#include "frame.h"
+#include "tx.h"
+
+#ifdef CAPTURE_MODE
+
+/*******************************************************************************
+* Capture state
+*******************************************************************************/
+static uint8_t  capture_ring[CAPTURE_DEPTH_FRAMES][CAPTURE_FRAME_BYTES];
+static uint8_t  capture_state = CAPTURE_IDLE;
+static uint16_t capture_head = 0;           /* next frame slot to write */
+static uint16_t capture_filled = 0;         /* valid frames in the ring */
+static uint16_t capture_post_remaining = 0; /* frames left after trigger */
+static uint16_t capture_pre_actual = 0;     /* pre-trigger frames retained */
+static bool     capture_normal_pending = false; /* normal scan of head written */
+
+/* trigger channel level */
+static uint16_t capture_reference = 0;
+static bool     capture_have_reference = false;
+static bool     capture_releasing = false;      /* rearmed, press still on */
+static uint16_t capture_trigger_value = 0;
+
+/* dump progress: 0 = info, 1..frames = data, frames + 1 = end */
+static uint16_t capture_dump_step = 0;
+
+/* dump frame being sent, with the bytes the UART has taken so far */
+static uint8_t  capture_tx[FRAME_OVERHEAD + 2u + CAPTURE_FRAME_BYTES];
+static uint16_t capture_tx_length = 0;
+static uint16_t capture_tx_sent = 0;
+static uint8_t  capture_tx_crc = 0;
+
+
+/*******************************************************************************
+* Function Name: Capture_PackScan
+********************************************************************************
+* Summary:
+* Packs the current top_plate raw counts into the part of a capture frame
+* belonging to one mode.
+*
+* Parameters:
+* dest: First byte of the mode's part of the frame.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Capture_PackScan(uint8_t *dest)
+{
+    uint8_t i;
+
+#if (CAPTURE_PACK_12BIT)
+    for (i = 0; i < CAPTURE_SENSORS_PER_SCAN; i += 2u)
+    {
+        uint16_t a = CapSense_dsRam.snsList.top_plate[i].raw[0];
+        uint16_t b = CapSense_dsRam.snsList.top_plate[i + 1u].raw[0];
+
+        // saturate to 12 bits rather than wrap
+        if (a > 0x0FFFu) { a = 0x0FFFu; }
+        if (b > 0x0FFFu) { b = 0x0FFFu; }
+
+        // two samples in three bytes: aaaaaaaa bbbbaaaa bbbbbbbb
+        *dest++ = (uint8_t)(a & 0xFFu);
+        *dest++ = (uint8_t)((a >> 8) | ((b & 0x0Fu) << 4));
+        *dest++ = (uint8_t)(b >> 4);
+    }
+#else
+    for (i = 0; i < CAPTURE_SENSORS_PER_SCAN; i++)
+    {
+        uint16_t a = CapSense_dsRam.snsList.top_plate[i].raw[0];
+
+        *dest++ = (uint8_t)(a & 0xFFu);
+        *dest++ = (uint8_t)(a >> 8);
+    }
+#endif
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_ReadTriggerChannel
+********************************************************************************
+* Summary:
+* Returns the trigger channel's raw count as it is stored in the ring.
+*
+* Parameters:
+* None
+*
+* Return:
+* Raw count, saturated to the storage width.
+*******************************************************************************/
+static uint16_t Capture_ReadTriggerChannel(void)
+{
+    uint16_t value = CapSense_dsRam.snsList.top_plate[CAPTURE_CHANNEL % CAPTURE_SENSORS_PER_SCAN].raw[0];
+
+#if (CAPTURE_PACK_12BIT)
+    if (value > 0x0FFFu) { value = 0x0FFFu; }
+#endif
+    return value;
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_StagePut
+********************************************************************************
+* Summary:
+* Appends one payload byte to the staged frame.
+*
+* Parameters:
+* value: Byte to add.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Capture_StagePut(uint8_t value)
+{
+    capture_tx_crc = Frame_Crc8Update(capture_tx_crc, value);
+    capture_tx[capture_tx_length++] = value;
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_StageBegin
+********************************************************************************
+* Summary:
+* Starts building a dump frame in the staging buffer. Exactly 'length'
+* payload bytes must be added with Capture_StagePut() before
+* Capture_StageEnd().
+*
+* Parameters:
+* type: One of the FRAME_TYPE_CAPTURE_* values.
+* length: Number of payload bytes.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Capture_StageBegin(uint8_t type, uint8_t length)
+{
+    capture_tx[0] = FRAME_SYNC_0;
+    capture_tx[1] = FRAME_SYNC_1;
+    capture_tx_length = 2u;
+    capture_tx_sent = 0u;
+    capture_tx_crc = 0u;
+    Capture_StagePut(type);
+    Capture_StagePut(length);
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_StageU16
+********************************************************************************
+* Summary:
+* Appends a 16-bit value to the staged frame, least significant byte first.
+*
+* Parameters:
+* value: Value to add.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Capture_StageU16(uint16_t value)
+{
+    Capture_StagePut((uint8_t)(value & 0xFFu));
+    Capture_StagePut((uint8_t)(value >> 8));
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_StageEnd
+********************************************************************************
+* Summary:
+* Terminates the staged frame with its CRC. Capture_SendStaged() then hands it
+* to the UART.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+static void Capture_StageEnd(void)
+{
+    capture_tx[capture_tx_length++] = capture_tx_crc;
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_SendStaged
+********************************************************************************
+* Summary:
+* Writes as much of the staged frame as the UART transmit buffer has room for,
+* without waiting.
+*
+* Parameters:
+* None
+*
+* Return:
+* true once the whole frame has been handed to the UART.
+*******************************************************************************/
+static bool Capture_SendStaged(void)
+{
+    // the software ring holds one byte less than its size, and the count
+    // does not include the bytes already in the hardware FIFO
+    uint32 used = UART_SpiUartGetTxBufferSize();
+    uint32 room = (used < (UART_TX_BUFFER_SIZE - 1u)) ? (UART_TX_BUFFER_SIZE - 1u - used) : 0u;
+
+    while ((capture_tx_sent < capture_tx_length) && (room > 0u))
+    {
+        Tx_PutByte(capture_tx[capture_tx_sent++]);
+        room--;
+    }
+    if (capture_tx_sent < capture_tx_length)
+    {
+        return false;
+    }
+    Tx_EndMessage();
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_Arm
+********************************************************************************
+* Summary:
+* Clears the ring and starts recording. The first complete frame sets the
+* trigger reference level.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Capture_Arm(void)
+{
+    capture_head = 0;
+    capture_filled = 0;
+    capture_post_remaining = 0;
+    capture_pre_actual = 0;
+    capture_normal_pending = false;
+    capture_have_reference = false;
+    capture_releasing = false;
+    capture_dump_step = 0;
+    capture_state = CAPTURE_ARMED;
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_RecordScan
+********************************************************************************
+* Summary:
+* Stores the scan that just completed into the head frame of the ring, at the
+* position of its mode. The scan of the last mode commits the frame.
+* Must be called before mode_flag is toggled for the next scan.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Capture_RecordScan(void)
+{
+    uint8_t *frame;
+    uint8_t mode = mode_flag;
+
+    if ((capture_state != CAPTURE_ARMED) && (capture_state != CAPTURE_TRIGGERED))
+    {
+        return;
+    }
+
+    frame = capture_ring[capture_head];
+
+    // a frame must start with the normal scan (e.g. when armed mid-cycle)
+    if (mode == SENSOR_MODE_NORMAL)
+    {
+        capture_normal_pending = true;
+    }
+    else if (!capture_normal_pending)
+    {
+        return;
+    }
+
+    Capture_PackScan(frame + (mode * CAPTURE_SCAN_BYTES));
+
+    if ((CAPTURE_CHANNEL / CAPTURE_SENSORS_PER_SCAN) == mode)
+    {
+        capture_trigger_value = Capture_ReadTriggerChannel();
+    }
+
+    if (mode != SENSOR_MODE_LAST)
+    {
+        return;
+    }
+    capture_normal_pending = false;
+
+    // frame complete: advance the ring
+    capture_head++;
+    if (capture_head >= CAPTURE_DEPTH_FRAMES)
+    {
+        capture_head = 0;
+    }
+    if (capture_filled < CAPTURE_DEPTH_FRAMES)
+    {
+        capture_filled++;
+    }
+
+    if ((capture_state == CAPTURE_ARMED) && capture_releasing)
+    {
+        uint16_t distance = (capture_trigger_value > capture_reference) ?
+                            (uint16_t)(capture_trigger_value - capture_reference) :
+                            (uint16_t)(capture_reference - capture_trigger_value);
+
+        // the new reference is taken once the channel is back near the old one
+        if (distance < CAPTURE_RELEASE)
+        {
+            capture_releasing = false;
+        }
+    }
+
+    if ((capture_state == CAPTURE_ARMED) && !capture_releasing)
+    {
+        uint16_t distance;
+
+        if (!capture_have_reference)
+        {
+            capture_reference = capture_trigger_value;
+            capture_have_reference = true;
+        }
+
+        distance = (capture_trigger_value > capture_reference) ?
+                   (uint16_t)(capture_trigger_value - capture_reference) :
+                   (uint16_t)(capture_reference - capture_trigger_value);
+
+        if (distance >= CAPTURE_THRESHOLD)
+        {
+            // the trigger frame is the first post-trigger frame
+            capture_pre_actual = (uint16_t)(capture_filled - 1u);
+            if (capture_pre_actual > CAPTURE_PRE)
+            {
+                capture_pre_actual = CAPTURE_PRE;
+            }
+            capture_post_remaining = CAPTURE_POST;
+            capture_state = CAPTURE_TRIGGERED;
+        }
+    }
+
+    if (capture_state == CAPTURE_TRIGGERED)
+    {
+        capture_post_remaining--;
+        if (capture_post_remaining == 0u)
+        {
+            capture_dump_step = 0;
+            capture_state = CAPTURE_DUMPING;
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_Service
+********************************************************************************
+* Summary:
+* Hands the UART as much of the pending dump as its transmit buffer has room
+* for, building the next frame once the last one has gone. Call from the
+* main loop as often as possible; it never waits for the link.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Capture_Service(void)
+{
+    uint16_t frames;
+
+    // finish the frame in progress first; it may outlive the dump state
+    if (capture_tx_sent < capture_tx_length)
+    {
+        if (!Capture_SendStaged())
+        {
+            return;
+        }
+    }
+
+    if (capture_state != CAPTURE_DUMPING)
+    {
+        return;
+    }
+
+    frames = (uint16_t)(capture_pre_actual + CAPTURE_POST);
+
+    if (capture_dump_step == 0u)
+    {
+        Capture_StageBegin(FRAME_TYPE_CAPTURE_INFO, 10u);
+        Capture_StageU16(frames);
+        Capture_StageU16(capture_pre_actual);
+        Capture_StagePut(CAPTURE_CHANNEL);
+        Capture_StagePut(CAPTURE_SAMPLE_BITS);
+        Capture_StageU16(CAPTURE_THRESHOLD);
+        Capture_StageU16(capture_reference);
+        Capture_StageEnd();
+        capture_dump_step++;
+    }
+    else if (capture_dump_step <= frames)
+    {
+        uint16_t index = (uint16_t)(capture_dump_step - 1u);
+        uint16_t slot = (uint16_t)((capture_head + CAPTURE_DEPTH_FRAMES - frames + index) % CAPTURE_DEPTH_FRAMES);
+        uint16_t i;
+
+        Capture_StageBegin(FRAME_TYPE_CAPTURE_DATA, (uint8_t)(2u + CAPTURE_FRAME_BYTES));
+        Capture_StageU16(index);
+        for (i = 0; i < CAPTURE_FRAME_BYTES; i++)
+        {
+            Capture_StagePut(capture_ring[slot][i]);
+        }
+        Capture_StageEnd();
+        capture_dump_step++;
+    }
+    else
+    {
+        Capture_StageBegin(FRAME_TYPE_CAPTURE_END, 2u);
+        Capture_StageU16(frames);
+        Capture_StageEnd();
+
+        #if (CAPTURE_AUTO_REARM)
+        // the press that fired may still be on: wait for its release
+        Capture_Arm();
+        capture_releasing = true;
+        #else
+        capture_state = CAPTURE_IDLE;
+        #endif
+    }
+    (void)Capture_SendStaged();
+}
+
+
+/*******************************************************************************
+* Function Name: Capture_GetState
+********************************************************************************
+* Summary:
+* Returns the current capture state (CAPTURE_IDLE ... CAPTURE_DUMPING).
+*
+* Parameters:
+* None
+*
+* Return:
+* Capture state.
+*******************************************************************************/
+uint8_t Capture_GetState(void)
+{
+    return capture_state;
+}
+
+#endif /* CAPTURE_MODE */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,102 @@
+/*******************************************************************************
+* File Name: capture.h
+*
+* Description: On-chip capture of full-rate raw frames for fast transients.
+*
+*              A capture frame holds one scan of the top_plate sensors per
+*              mode, normal first (SENSOR_FRAME_SAMPLES samples, same order as
+*              the VISUALIZATION_MODE line). While armed, frames are written into
+*              an SRAM ring buffer. When the trigger channel moves more than
+*              the threshold away from its value at arm time, the ring keeps
+*              the pre-trigger window, records the post-trigger window and
+*              then stops. The buffer is then dumped as binary frames
+*              (frame.h) only as fast as the UART transmit buffer drains:
+*              each frame is built in a small staging buffer and handed to
+*              the UART in pieces that fit, so a frame larger than the
+*              buffer never blocks the main loop.
+*
+*              Dump sequence:
+*                CAPTURE_INFO  frames(u16) pre(u16) channel(u8) bits(u8)
+*                              threshold(u16) reference(u16)
+*                CAPTURE_DATA  index(u16) packed samples, one per frame
+*                CAPTURE_END   frames(u16)
+*******************************************************************************/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "globals.h"
+#include "frame.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Storage: 12-bit packing holds 2 samples in 3 bytes (raw counts are saturated
+*  to 4095), 16-bit keeps the full raw count. The top_plate widget scans at
+*  16-bit resolution, so only enable packing with a resolution of 12 bits or
+*  less. */
+#define CAPTURE_PACK_12BIT          (0u)
+
+#define CAPTURE_SENSORS_PER_SCAN    SENSOR_COUNT
+#define CAPTURE_SAMPLES_PER_FRAME   SENSOR_FRAME_SAMPLES
+
+#if (CAPTURE_PACK_12BIT)
+#define CAPTURE_SAMPLE_BITS         (12u)
+#define CAPTURE_SCAN_BYTES          ((CAPTURE_SENSORS_PER_SCAN * 3u) / 2u)
+#else
+#define CAPTURE_SAMPLE_BITS         (16u)
+#define CAPTURE_SCAN_BYTES          (CAPTURE_SENSORS_PER_SCAN * 2u)
+#endif
+#define CAPTURE_FRAME_BYTES         (SENSOR_MODE_COUNT * CAPTURE_SCAN_BYTES)
+
+/* Ring depth in frames. 40 frames = 1280 bytes of SRAM for 8 sensors, two
+*  modes, 16-bit (sized against the unfiltered channel_state of CAPTURE_MODE). */
+#define CAPTURE_DEPTH_FRAMES        (40u)
+
+/* Trigger and window */
+#define CAPTURE_CHANNEL             (0u)    /* frame sample index: mode * SENSOR_COUNT + sensor */
+#define CAPTURE_THRESHOLD           (200u)  /* raw counts from the level at arm time */
+#define CAPTURE_RELEASE             (100u)  /* back within this of it before a rearm */
+#define CAPTURE_PRE                 (12u)   /* frames kept before trigger */
+#define CAPTURE_POST                (28u)   /* frames kept from trigger on, at least 1 */
+
+#if (CAPTURE_PRE + CAPTURE_POST) > CAPTURE_DEPTH_FRAMES
+#error "The capture window does not fit the ring"
+#endif
+#if (CAPTURE_RELEASE == 0u) || (CAPTURE_RELEASE > CAPTURE_THRESHOLD)
+#error "CAPTURE_RELEASE must be between 1 and CAPTURE_THRESHOLD"
+#endif
+#if (CAPTURE_POST == 0u) || (CAPTURE_CHANNEL >= CAPTURE_SAMPLES_PER_FRAME)
+#error "CAPTURE_POST must be at least 1 and CAPTURE_CHANNEL a frame sample index"
+#endif
+#if ((2u + CAPTURE_FRAME_BYTES) > FRAME_MAX_PAYLOAD)
+#error "A capture frame does not fit the payload of a CAPTURE_DATA frame"
+#endif
+
+/* Re-arm automatically after a dump completes. The trigger stays off until
+*  the channel has come back within CAPTURE_RELEASE of the old reference, and
+*  the new reference is taken there, so a press that outlasts the dump
+*  neither fires again nor becomes the level the next press is measured
+*  from. */
+#define CAPTURE_AUTO_REARM          (1u)
+
+/* Capture states */
+#define CAPTURE_IDLE                (0u)
+#define CAPTURE_ARMED               (1u)
+#define CAPTURE_TRIGGERED           (2u)
+#define CAPTURE_DUMPING             (3u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void    Capture_Arm(void);
+void    Capture_RecordScan(void);
+void    Capture_Service(void);
+uint8_t Capture_GetState(void);
+
+#endif /* CAPTURE_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,80 @@
+/*******************************************************************************
+* File Name: clock.c
+*
+* Description: Extension of the My_Time counter to a 32-bit time base. See
+*              clock.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "clock.h"
+
+/* My_Time counts 0 .. My_Time_TC_PERIOD_VALUE */
+#define CLOCK_MODULUS           (My_Time_TC_PERIOD_VALUE + 1u)
+
+static uint32_t clock_ticks = 0;
+static uint32_t clock_last_count = 0;
+
+
+/*******************************************************************************
+* Function Name: Clock_Elapsed
+********************************************************************************
+* Summary:
+* Ticks from one My_Time reading to a later one, across one counter wrap.
+*
+* Parameters:
+* now: Later reading.
+* then: Earlier reading.
+*
+* Return:
+* Elapsed ticks.
+*******************************************************************************/
+static uint32_t Clock_Elapsed(uint32_t now, uint32_t then)
+{
+    return (now >= then) ? (now - then) : ((now + CLOCK_MODULUS) - then);
+}
+
+
+/*******************************************************************************
+* Function Name: Clock_Now
+********************************************************************************
+* Summary:
+* Returns the current time.
+*
+* Parameters:
+* None
+*
+* Return:
+* Time in ticks.
+*******************************************************************************/
+uint32_t Clock_Now(void)
+{
+    uint32_t count = My_Time_ReadCounter();
+
+    clock_ticks += Clock_Elapsed(count, clock_last_count);
+    clock_last_count = count;
+    return clock_ticks;
+}
+
+
+/*******************************************************************************
+* Function Name: Clock_FromCounter
+********************************************************************************
+* Summary:
+* Converts a My_Time reading taken earlier (e.g. in an interrupt) to the
+* time base. The reading must be less than one counter wrap old.
+*
+* Parameters:
+* count: Earlier My_Time reading.
+*
+* Return:
+* Time of the reading in ticks.
+*******************************************************************************/
+uint32_t Clock_FromCounter(uint32_t count)
+{
+    uint32_t now = Clock_Now();
+
+    return now - Clock_Elapsed(clock_last_count, count);
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,36 @@
+/*******************************************************************************
+* File Name: clock.h
+*
+* Description: 32-bit time base built on the My_Time counter.
+*
+*              My_Time counts Clock_1 and wraps after My_Time_TC_PERIOD_VALUE
+*              + 1 ticks (under a second). Clock_Now() extends it to a 32-bit
+*              tick count that wraps only after days, so callers can subtract
+*              two times without caring about the counter period. It must be
+*              called at least once per counter wrap; every user calls it
+*              once per scan or more.
+*
+*              Only the main loop may call these functions.
+*******************************************************************************/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* My_Time input clock (Clock_1 in TopDesign) */
+#define CLOCK_HZ                (12000u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+uint32_t Clock_Now(void);
+uint32_t Clock_FromCounter(uint32_t count);
+
+#endif /* CLOCK_H */
+
+
+/* [] END OF FILE */
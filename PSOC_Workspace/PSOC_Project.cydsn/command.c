@@ -0,0 +1,196 @@
+/*******************************************************************************
+* File Name: command.c
+*
+* Description: Receive-side frame parser and command dispatch. See command.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "command.h"
+#include "frame.h"
+#include "clock.h"
+#ifdef TIME_SYNC
+#include "timesync.h"
+#endif
+#ifdef LINEARIZATION
+#include "linearize.h"
+#endif
+#ifdef CSX_MODE
+#include "csx.h"
+#endif
+#ifdef CROSSTALK_COMPENSATION
+#include "crosstalk.h"
+#endif
+
+#include <stdbool.h>
+
+#ifdef COMMAND_CHANNEL
+
+#if defined(UART_UART_RX_DIRECTION) && (0u == UART_UART_RX_DIRECTION)
+#error "The command channel needs the UART component configured for TX + RX"
+#endif
+
+/* Parser states */
+#define COMMAND_HUNT            (0u)    /* waiting for FRAME_SYNC_0 */
+#define COMMAND_SYNC1           (1u)
+#define COMMAND_TYPE            (2u)
+#define COMMAND_LENGTH          (3u)
+#define COMMAND_PAYLOAD         (4u)
+#define COMMAND_CRC             (5u)
+
+static uint8_t command_state = COMMAND_HUNT;
+static uint8_t command_type;
+static uint8_t command_length;
+static uint8_t command_index;
+static uint8_t command_crc;
+static uint8_t command_payload[COMMAND_MAX_PAYLOAD];
+
+
+/*******************************************************************************
+* Function Name: Command_Dispatch
+********************************************************************************
+* Summary:
+* Hands a complete, CRC-checked frame to the module that owns its type.
+*
+* Parameters:
+* rx_time: Clock_Now() time at which the frame was taken from the UART.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Command_Dispatch(uint32_t rx_time)
+{
+    switch (command_type)
+    {
+        #ifdef TIME_SYNC
+        case FRAME_TYPE_SYNC_PING:
+            TimeSync_OnPing(command_payload, command_length, rx_time);
+            break;
+        #endif
+
+        #ifdef LINEARIZATION
+        case FRAME_TYPE_LUT_WRITE:
+            Linearize_OnWrite(command_payload, command_length);
+            break;
+
+        case FRAME_TYPE_LUT_COMMIT:
+            Linearize_OnCommit(command_payload, command_length);
+            break;
+        #endif
+
+        #ifdef CSX_MODE
+        case FRAME_TYPE_METHOD_SET:
+            Csx_OnSetMethod(command_payload, command_length);
+            break;
+        #endif
+
+        #ifdef CROSSTALK_COMPENSATION
+        case FRAME_TYPE_XT_WRITE:
+            Crosstalk_OnWrite(command_payload, command_length);
+            break;
+
+        case FRAME_TYPE_XT_COMMIT:
+            Crosstalk_OnCommit(command_payload, command_length);
+            break;
+        #endif
+
+        default:
+            (void)rx_time;
+            break;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Command_Feed
+********************************************************************************
+* Summary:
+* Advances the frame parser by one received byte.
+*
+* Parameters:
+* value: Received byte.
+*
+* Return:
+* true when the byte completed a valid frame.
+*******************************************************************************/
+static bool Command_Feed(uint8_t value)
+{
+    switch (command_state)
+    {
+        case COMMAND_SYNC1:
+            command_state = (value == FRAME_SYNC_1) ? COMMAND_TYPE :
+                            ((value == FRAME_SYNC_0) ? COMMAND_SYNC1 : COMMAND_HUNT);
+            break;
+
+        case COMMAND_TYPE:
+            command_type = value;
+            command_crc = Frame_Crc8Update(0u, value);
+            command_state = COMMAND_LENGTH;
+            break;
+
+        case COMMAND_LENGTH:
+            command_length = value;
+            command_index = 0u;
+            command_crc = Frame_Crc8Update(command_crc, value);
+            if (value > COMMAND_MAX_PAYLOAD)
+            {
+                command_state = COMMAND_HUNT;
+            }
+            else
+            {
+                command_state = (value == 0u) ? COMMAND_CRC : COMMAND_PAYLOAD;
+            }
+            break;
+
+        case COMMAND_PAYLOAD:
+            command_payload[command_index++] = value;
+            command_crc = Frame_Crc8Update(command_crc, value);
+            if (command_index >= command_length)
+            {
+                command_state = COMMAND_CRC;
+            }
+            break;
+
+        case COMMAND_CRC:
+            command_state = COMMAND_HUNT;
+            return (value == command_crc);
+
+        default:
+            if (value == FRAME_SYNC_0)
+            {
+                command_state = COMMAND_SYNC1;
+            }
+            break;
+    }
+    return false;
+}
+
+
+/*******************************************************************************
+* Function Name: Command_Poll
+********************************************************************************
+* Summary:
+* Parses every byte waiting in the UART receive buffer and executes the
+* commands they complete. Call from the main loop as often as possible: the
+* time sync takes its receive timestamp here.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Command_Poll(void)
+{
+    while (UART_SpiUartGetRxBufferSize() != 0u)
+    {
+        if (Command_Feed((uint8_t)UART_SpiUartReadRxData()))
+        {
+            Command_Dispatch(Clock_Now());
+        }
+    }
+}
+
+#endif /* COMMAND_CHANNEL */
+
+
+/* [] END OF FILE */
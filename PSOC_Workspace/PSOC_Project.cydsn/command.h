@@ -0,0 +1,41 @@
+/*******************************************************************************
+* File Name: command.h
+*
+* Description: Host-to-board command channel on the UART receive line.
+*
+*              The host sends commands as binary frames in the frame.h
+*              format. Command_Poll() drains the receive buffer from the main
+*              loop, checks each frame's CRC and hands complete frames to the
+*              module that owns their type. Malformed frames, unknown types
+*              and payloads longer than COMMAND_MAX_PAYLOAD are dropped
+*              silently; the parser resynchronizes on the next sync bytes.
+*
+*              The UART component must be configured for TX + RX, with the rx
+*              pin assigned in the design-wide resources.
+*
+*              Built when a feature that takes commands (TIME_SYNC,
+*              LINEARIZATION, CSX_MODE, CROSSTALK_COMPENSATION) defines
+*              COMMAND_CHANNEL in globals.h.
+*******************************************************************************/
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Longest command payload accepted */
+#define COMMAND_MAX_PAYLOAD     (16u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void Command_Poll(void);
+
+#endif /* COMMAND_H */
+
+
+/* [] END OF FILE */
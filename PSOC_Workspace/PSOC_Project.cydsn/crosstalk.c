@@ -0,0 +1,327 @@
+/*******************************************************************************
+* File Name: crosstalk.c
+*
+* Description: Banded fixed-point crosstalk decoupling, with the per-unit
+*              matrix stored in flash. See crosstalk.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "crosstalk.h"
+#include "baseline.h"
+#include "frame.h"
+
+#include <stdbool.h>
+
+#ifdef CROSSTALK_COMPENSATION
+
+#define CROSSTALK_MAGIC         (0x5854u)   /* "XT" */
+
+/* Stored matrix: header, then one row per mode and sensor */
+typedef struct
+{
+    uint16_t magic;
+    uint8_t  version;                       /* CROSSTALK_VERSION */
+    uint8_t  crc;                           /* over shape and coeffs */
+    uint8_t  modes;                         /* SENSOR_MODE_COUNT */
+    uint8_t  sensors;                       /* SENSOR_COUNT */
+    uint8_t  taps;                          /* CROSSTALK_TAPS */
+    uint8_t  reserved;
+    int16_t  coeffs[SENSOR_MODE_COUNT][SENSOR_COUNT][CROSSTALK_TAPS];
+} crosstalk_store_t;
+
+#define CROSSTALK_ROWS  ((sizeof(crosstalk_store_t) + CY_FLASH_SIZEOF_ROW - 1u) / CY_FLASH_SIZEOF_ROW)
+
+/* The store padded to whole flash rows */
+typedef union
+{
+    crosstalk_store_t store;
+    uint32_t          words[(CROSSTALK_ROWS * CY_FLASH_SIZEOF_ROW) / sizeof(uint32_t)];
+} crosstalk_rows_t;
+
+/* The stored matrix, row aligned. Rewritten by CySysFlashWriteRow behind the
+*  compiler's back, hence volatile. Erased (no valid matrix) as built. */
+static volatile const crosstalk_rows_t crosstalk_flash CY_ALIGN(CY_FLASH_SIZEOF_ROW) = {{0u}};
+
+/* Matrix being edited by XT_WRITE, written to flash by XT_COMMIT */
+static crosstalk_rows_t crosstalk_edit;
+static bool crosstalk_editing = false;
+
+/* The stored matrix passed its checks */
+static bool crosstalk_loaded = false;
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_Crc
+********************************************************************************
+* Summary:
+* CRC-8 of a store's shape and coefficients, as in the frames.
+*
+* Parameters:
+* store: Stored or edited matrix.
+*
+* Return:
+* CRC.
+*******************************************************************************/
+static uint8_t Crosstalk_Crc(volatile const crosstalk_store_t *store)
+{
+    volatile const uint8_t *bytes = &store->modes;
+    uint32_t length = sizeof(crosstalk_store_t) - (uint32_t)((volatile const uint8_t *)&store->modes -
+                                                             (volatile const uint8_t *)store);
+    uint8_t crc = 0u;
+    uint32_t i;
+
+    for (i = 0u; i < length; i++)
+    {
+        crc = Frame_Crc8Update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_Check
+********************************************************************************
+* Summary:
+* Checks the stored matrix: magic, layout version, shape and CRC.
+*
+* Parameters:
+* None
+*
+* Return:
+* true if the matrix may be used.
+*******************************************************************************/
+static bool Crosstalk_Check(void)
+{
+    volatile const crosstalk_store_t *store = &crosstalk_flash.store;
+
+    return (store->magic == CROSSTALK_MAGIC) && (store->version == CROSSTALK_VERSION) &&
+           (store->modes == SENSOR_MODE_COUNT) && (store->sensors == SENSOR_COUNT) &&
+           (store->taps == CROSSTALK_TAPS) && (store->crc == Crosstalk_Crc(store));
+}
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_Init
+********************************************************************************
+* Summary:
+* Checks the stored matrix. Without a valid one the stage passes the signal
+* through. Call once at start-up.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Crosstalk_Init(void)
+{
+    crosstalk_loaded = Crosstalk_Check();
+}
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_Apply
+********************************************************************************
+* Summary:
+* Replaces one scan of a mode by its decoupled values. Costs
+* SENSOR_COUNT * CROSSTALK_TAPS multiply-adds per scan. The baselines of the
+* mode must already hold this scan (Baseline_Update).
+*
+* Parameters:
+* values: SENSOR_COUNT values of the scan, updated in place.
+* mode: Mode of the scan, selects the coefficient table.
+*
+* Return:
+* None
+*******************************************************************************/
+void Crosstalk_Apply(int32_t *values, uint8_t mode)
+{
+    int32_t base[SENSOR_COUNT];
+    int32_t signal[SENSOR_COUNT];
+    uint8_t i;
+    uint8_t k;
+
+    if (!crosstalk_loaded)
+    {
+        return;
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        base[i] = Baseline_Get(mode, i);
+        signal[i] = values[i] - base[i];
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        volatile const int16_t *row = crosstalk_flash.store.coeffs[mode][i];
+        int32_t sum = 0;
+
+        for (k = 0; k < CROSSTALK_TAPS; k++)
+        {
+            // sensor index i + k - CROSSTALK_BANDWIDTH, skipped off the edges
+            uint8_t j = (uint8_t)(i + k - CROSSTALK_BANDWIDTH);
+
+            if (j < SENSOR_COUNT)
+            {
+                sum += (int32_t)row[k] * signal[j];
+            }
+        }
+
+        values[i] = base[i] + ((sum + (CROSSTALK_ONE / 2)) >> CROSSTALK_Q);
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_Ack
+********************************************************************************
+* Summary:
+* Sends an XT_ACK frame.
+*
+* Parameters:
+* mode: Mode echoed, or CROSSTALK_NO_CHANNEL.
+* sensor: Sensor echoed, or CROSSTALK_NO_CHANNEL.
+* status: CROSSTALK_OK or an error.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Crosstalk_Ack(uint8_t mode, uint8_t sensor, uint8_t status)
+{
+    Frame_Begin(FRAME_TYPE_XT_ACK, CROSSTALK_ACK_SIZE);
+    Frame_PutByte(mode);
+    Frame_PutByte(sensor);
+    Frame_PutByte(status);
+    Frame_End();
+}
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_OnWrite
+********************************************************************************
+* Summary:
+* Handles an XT_WRITE: stores one row in the matrix being edited. The first
+* write starts from the stored matrix, or from the identity if there is none.
+*
+* Parameters:
+* payload: Command payload.
+* length: Payload length.
+*
+* Return:
+* None
+*******************************************************************************/
+void Crosstalk_OnWrite(const uint8_t *payload, uint8_t length)
+{
+    uint8_t mode = (length > 0u) ? payload[0] : CROSSTALK_NO_CHANNEL;
+    uint8_t sensor = (length > 1u) ? payload[1] : CROSSTALK_NO_CHANNEL;
+    uint8_t m;
+    uint8_t i;
+    uint8_t k;
+
+    if (length != CROSSTALK_WRITE_SIZE)
+    {
+        Crosstalk_Ack(mode, sensor, CROSSTALK_BAD_LENGTH);
+        return;
+    }
+    if ((mode >= SENSOR_MODE_COUNT) || (sensor >= SENSOR_COUNT))
+    {
+        Crosstalk_Ack(mode, sensor, CROSSTALK_BAD_CHANNEL);
+        return;
+    }
+
+    if (!crosstalk_editing)
+    {
+        for (m = 0u; m < SENSOR_MODE_COUNT; m++)
+        {
+            for (i = 0u; i < SENSOR_COUNT; i++)
+            {
+                for (k = 0u; k < CROSSTALK_TAPS; k++)
+                {
+                    crosstalk_edit.store.coeffs[m][i][k] = crosstalk_loaded ?
+                        crosstalk_flash.store.coeffs[m][i][k] :
+                        (int16_t)((k == CROSSTALK_BANDWIDTH) ? CROSSTALK_ONE : 0);
+                }
+            }
+        }
+        crosstalk_editing = true;
+    }
+
+    for (k = 0u; k < CROSSTALK_TAPS; k++)
+    {
+        const uint8_t *p = &payload[CROSSTALK_WRITE_HEADER + (2u * k)];
+
+        crosstalk_edit.store.coeffs[mode][sensor][k] = (int16_t)(uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+    }
+    Crosstalk_Ack(mode, sensor, CROSSTALK_OK);
+}
+
+
+/*******************************************************************************
+* Function Name: Crosstalk_OnCommit
+********************************************************************************
+* Summary:
+* Handles an XT_COMMIT: writes the matrix being edited to flash, or erases the
+* stored one, once the scan in progress has finished. The new matrix is
+* checked as at start-up before the stage uses it.
+*
+* Parameters:
+* payload: Command payload.
+* length: Payload length.
+*
+* Return:
+* None
+*******************************************************************************/
+void Crosstalk_OnCommit(const uint8_t *payload, uint8_t length)
+{
+    uint32_t first;
+    uint32_t row;
+    bool written = true;
+
+    if ((length != CROSSTALK_COMMIT_SIZE) || (payload[0] > 1u) || ((payload[0] == 1u) && !crosstalk_editing))
+    {
+        Crosstalk_Ack(CROSSTALK_NO_CHANNEL, CROSSTALK_NO_CHANNEL, CROSSTALK_BAD_LENGTH);
+        return;
+    }
+
+    if (payload[0] == 1u)
+    {
+        crosstalk_edit.store.magic = CROSSTALK_MAGIC;
+        crosstalk_edit.store.version = CROSSTALK_VERSION;
+        crosstalk_edit.store.modes = SENSOR_MODE_COUNT;
+        crosstalk_edit.store.sensors = SENSOR_COUNT;
+        crosstalk_edit.store.taps = CROSSTALK_TAPS;
+        crosstalk_edit.store.reserved = 0u;
+        crosstalk_edit.store.crc = Crosstalk_Crc(&crosstalk_edit.store);
+    }
+    else
+    {
+        // an all-zero header never passes the check
+        for (row = 0u; row < (sizeof(crosstalk_edit.words) / sizeof(crosstalk_edit.words[0])); row++)
+        {
+            crosstalk_edit.words[row] = 0u;
+        }
+    }
+    crosstalk_editing = false;
+
+    // the CPU stalls during the write: let the scan in progress complete
+    // first, so its result and the scan callback timing are not disturbed
+    while (CapSense_IsBusy() != CapSense_NOT_BUSY)
+    {
+    }
+    first = ((uint32_t)(uintptr_t)&crosstalk_flash - CY_FLASH_BASE) / CY_FLASH_SIZEOF_ROW;
+    for (row = 0u; (row < CROSSTALK_ROWS) && written; row++)
+    {
+        written = (CySysFlashWriteRow(first + row, (const uint8 *)crosstalk_edit.words +
+                                                   (row * CY_FLASH_SIZEOF_ROW)) == CY_SYS_FLASH_SUCCESS);
+    }
+
+    crosstalk_loaded = Crosstalk_Check();
+    Crosstalk_Ack(CROSSTALK_NO_CHANNEL, CROSSTALK_NO_CHANNEL,
+                  (written && (crosstalk_loaded == (payload[0] == 1u))) ? CROSSTALK_OK : CROSSTALK_FLASH_ERROR);
+}
+
+#endif /* CROSSTALK_COMPENSATION */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,86 @@
+/*******************************************************************************
+* File Name: crosstalk.h
+*
+* Description: Adjacent-electrode crosstalk compensation.
+*
+*              Pressing one taxel also raises the counts of its neighbours.
+*              This stage multiplies the signal (count minus baseline) of a
+*              scan by a banded decoupling matrix, one per mode, and adds the
+*              baseline back:
+*
+*                out[i] = base[i] + sum(k = -BW..BW) C[i][k] * (in[i+k] - base[i+k])
+*
+*              Coefficients are Q14 (16384 = 1.0). They are calibrated per
+*              unit: press each taxel alone, record the signal ratio r(i,j)
+*              seen on every neighbour j, and store the inverse of the
+*              coupling matrix (for small couplings C is close to I - R).
+*
+*              The matrix lives in flash, behind a header with the layout
+*              version, the array shape and a CRC over the coefficients, and
+*              survives a reset. Crosstalk_Init() checks it at start-up; a
+*              board without a valid matrix (new, erased, or built for another
+*              layout) passes the signal through unchanged. The host loads
+*              the rows with XT_WRITE frames over the command channel and
+*              stores them with XT_COMMIT; the board answers every command
+*              with an XT_ACK:
+*                XT_WRITE   host -> board  mode(u8) sensor(u8)
+*                                          coeff(i16) x CROSSTALK_TAPS
+*                           one row of the matrix being edited, which starts
+*                           as the stored matrix, or the identity
+*                XT_COMMIT  host -> board  store(u8)
+*                           1: writes the edited matrix to flash
+*                           0: erases the stored matrix
+*                XT_ACK     board -> host  mode(u8) sensor(u8) status(u8)
+*                           mode and sensor are 0xFF for XT_COMMIT
+*              The flash write stalls the CPU for about 20 ms per row and
+*              waits for the scan in progress. Host_Tools/xtload loads a
+*              matrix from a CSV file.
+*******************************************************************************/
+
+#ifndef CROSSTALK_H
+#define CROSSTALK_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Neighbours on each side that take part (1 = tridiagonal matrix). Tap
+*  CROSSTALK_BANDWIDTH of a row is the diagonal; taps that fall outside the
+*  array are ignored. */
+#define CROSSTALK_BANDWIDTH     (1u)
+#define CROSSTALK_TAPS          ((2u * CROSSTALK_BANDWIDTH) + 1u)
+
+#define CROSSTALK_Q             (14u)
+#define CROSSTALK_ONE           (1 << CROSSTALK_Q)
+
+/* Layout of the stored matrix; a change makes stored matrices invalid */
+#define CROSSTALK_VERSION       (1u)
+
+/* Command payloads */
+#define CROSSTALK_WRITE_HEADER  (2u)
+#define CROSSTALK_WRITE_SIZE    (CROSSTALK_WRITE_HEADER + (2u * CROSSTALK_TAPS))
+#define CROSSTALK_COMMIT_SIZE   (1u)
+#define CROSSTALK_ACK_SIZE      (3u)
+#define CROSSTALK_NO_CHANNEL    (0xFFu)     /* mode and sensor of a commit ack */
+
+/* XT_ACK status */
+#define CROSSTALK_OK            (0u)
+#define CROSSTALK_BAD_CHANNEL   (1u)    /* mode or sensor out of range */
+#define CROSSTALK_BAD_LENGTH    (2u)    /* malformed command */
+#define CROSSTALK_FLASH_ERROR   (3u)    /* CySysFlashWriteRow failed, or the
+                                           stored matrix does not read back */
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void Crosstalk_Init(void);
+void Crosstalk_Apply(int32_t *values, uint8_t mode);
+void Crosstalk_OnWrite(const uint8_t *payload, uint8_t length);
+void Crosstalk_OnCommit(const uint8_t *payload, uint8_t length);
+
+#endif /* CROSSTALK_H */
+
+
+/* [] END OF FILE */
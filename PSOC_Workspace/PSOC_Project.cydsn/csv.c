@@ -0,0 +1,159 @@
+/*******************************************************************************
+* File Name: csv.c
+*
+* Description: Integer-only CSV line emitter. See csv.h.
+*
+*              Digits are found by subtracting powers of ten instead of
+*              calling the library division routine once per digit.
+*******************************************************************************/
+
+#include "project.h"
+#include "csv.h"
+#include "tx.h"
+
+#include <stdbool.h>
+
+#define CSV_NUM_POWERS  (9u)
+
+/* true until the first value of a line started by Csv_BeginLine */
+static bool csv_line_empty = true;
+
+/* 10^9 down to 10^1; the units digit is what remains */
+static const uint32_t csv_pow10[CSV_NUM_POWERS] =
+{
+    1000000000u, 100000000u, 10000000u, 1000000u, 100000u,
+    10000u, 1000u, 100u, 10u
+};
+
+
+/*******************************************************************************
+* Function Name: Csv_PutInt
+********************************************************************************
+* Summary:
+* Sends a signed integer in decimal, formatted exactly like "%d".
+*
+* Parameters:
+* value: Value to send.
+*
+* Return:
+* None
+*******************************************************************************/
+void Csv_PutInt(int32_t value)
+{
+    uint32_t magnitude = (uint32_t)value;
+    uint8_t k = 0;
+
+    if (value < 0)
+    {
+        Tx_PutByte((uint8_t)'-');
+        magnitude = 0u - magnitude;     // also correct for INT32_MIN
+    }
+
+    // skip leading zeros
+    while ((k < CSV_NUM_POWERS) && (magnitude < csv_pow10[k]))
+    {
+        k++;
+    }
+
+    for (; k < CSV_NUM_POWERS; k++)
+    {
+        uint8_t digit = '0';
+
+        while (magnitude >= csv_pow10[k])
+        {
+            magnitude -= csv_pow10[k];
+            digit++;
+        }
+        Tx_PutByte(digit);
+    }
+    Tx_PutByte((uint8_t)('0' + magnitude));
+}
+
+
+/*******************************************************************************
+* Function Name: Csv_BeginLine
+********************************************************************************
+* Summary:
+* Starts a CSV line whose values are sent one by one with Csv_PutValue, for
+* lines gathered from several places without a buffer.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Csv_BeginLine(void)
+{
+    Tx_PutByte((uint8_t)'\n');
+    csv_line_empty = true;
+}
+
+
+/*******************************************************************************
+* Function Name: Csv_PutValue
+********************************************************************************
+* Summary:
+* Sends the next value of the line started by Csv_BeginLine.
+*
+* Parameters:
+* value: Value to send.
+*
+* Return:
+* None
+*******************************************************************************/
+void Csv_PutValue(int32_t value)
+{
+    if (!csv_line_empty)
+    {
+        Tx_PutByte((uint8_t)',');
+    }
+    csv_line_empty = false;
+    Csv_PutInt(value);
+}
+
+
+/*******************************************************************************
+* Function Name: Csv_EndLine
+********************************************************************************
+* Summary:
+* Ends the line started by Csv_BeginLine.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Csv_EndLine(void)
+{
+    Tx_PutByte((uint8_t)'\r');
+    Tx_EndMessage();
+}
+
+
+/*******************************************************************************
+* Function Name: Csv_PutLine
+********************************************************************************
+* Summary:
+* Sends one CSV line in the "\n%d,%d,...,%d\r" format used by the logger.
+*
+* Parameters:
+* values: Values of the line.
+* count: Number of values, at least 1.
+*
+* Return:
+* None
+*******************************************************************************/
+void Csv_PutLine(const int32_t *values, uint8_t count)
+{
+    Csv_BeginLine();
+    while (count-- > 0u)
+    {
+        Csv_PutValue(*values++);
+    }
+    Csv_EndLine();
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,27 @@
+/*******************************************************************************
+* File Name: csv.h
+*
+* Description: Integer-only CSV line emitter. Produces the same bytes as
+*              sprintf("\n%d,%d,...,%d\r") but writes the digits straight
+*              into the UART transmit buffer, without a line buffer on the
+*              stack and without pulling in the newlib printf machinery.
+*******************************************************************************/
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdint.h>
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void Csv_PutInt(int32_t value);
+void Csv_PutLine(const int32_t *values, uint8_t count);
+void Csv_BeginLine(void);
+void Csv_PutValue(int32_t value);
+void Csv_EndLine(void);
+
+#endif /* CSV_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,215 @@
+/*******************************************************************************
+* File Name: csx.c
+*
+* Description: Scan method selection, widget sequencing and conversion of the
+*              mutual-capacitance nodes into normal and shear counts. See
+*              csx.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "globals.h"
+#include "csx.h"
+#include "frame.h"
+#if defined(CROSSTALK_COMPENSATION) || defined(CONTACT_LOCALIZATION) || defined(SLIP_DETECTION)
+#include "baseline.h"
+#endif
+#ifdef SLIP_DETECTION
+#include "slip.h"
+#endif
+
+#include <string.h>
+
+#ifdef CSX_MODE
+
+#define CSX_NO_PENDING      (0xFFu)
+
+/* Normal and shear counts of the last mutual scan */
+static uint16_t csx_raw[SENSOR_MODE_COUNT][SENSOR_COUNT];
+
+static uint8_t csx_method = CSX_DEFAULT_METHOD;    /* method of the running scan */
+static uint8_t csx_pending = CSX_NO_PENDING;       /* method requested by the host */
+
+
+/*******************************************************************************
+* Function Name: Csx_SendAck
+********************************************************************************
+* Summary:
+* Sends a FRAME_TYPE_METHOD_ACK frame.
+*
+* Parameters:
+* method: Method in effect, or the one refused.
+* status: CSX_OK or CSX_BAD_METHOD.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Csx_SendAck(uint8_t method, uint8_t status)
+{
+    Frame_Begin(FRAME_TYPE_METHOD_ACK, CSX_ACK_SIZE);
+    Frame_PutByte(method);
+    Frame_PutByte(status);
+    Frame_End();
+}
+
+
+/*******************************************************************************
+* Function Name: Csx_ApplyPending
+********************************************************************************
+* Summary:
+* Switches to the method the host asked for. The counts of the two methods
+* are on different scales, so the filters and baselines start over.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+static void Csx_ApplyPending(void)
+{
+    if (csx_pending != csx_method)
+    {
+        csx_method = csx_pending;
+        memset(channel_state, 0, sizeof(channel_state));
+        #if defined(CROSSTALK_COMPENSATION) || defined(CONTACT_LOCALIZATION) || defined(SLIP_DETECTION)
+        Baseline_Reset();
+        #endif
+        #ifdef SLIP_DETECTION
+        Slip_Reset();
+        #endif
+    }
+    csx_pending = CSX_NO_PENDING;
+    Csx_SendAck(csx_method, CSX_OK);
+}
+
+
+/*******************************************************************************
+* Function Name: Csx_Scan
+********************************************************************************
+* Summary:
+* Starts the next scan of the selected method: the top_plate widget for the
+* mode in mode_flag, or the mutual widget for every mode. A method change
+* requested by the host takes effect here, at a cycle boundary. Replaces
+* CapSense_ScanAllWidgets() in the main loop.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Csx_Scan(void)
+{
+    if ((csx_pending != CSX_NO_PENDING) && (mode_flag == SENSOR_MODE_NORMAL))
+    {
+        Csx_ApplyPending();
+    }
+
+    if (csx_method == CSX_METHOD_MUTUAL)
+    {
+        CapSense_SetupWidget(CapSense_MUTUAL_WDGT_ID);
+    }
+    else
+    {
+        // the bottom_plate widget only lends its pins to the callback
+        CapSense_SetupWidget(CapSense_TOP_PLATE_WDGT_ID);
+    }
+    CapSense_Scan();
+}
+
+
+/*******************************************************************************
+* Function Name: Csx_ScanComplete
+********************************************************************************
+* Summary:
+* Takes in the scan that just completed. A mutual scan is converted into the
+* counts of every mode, available through Csx_GetRaw().
+*
+* Parameters:
+* None
+*
+* Return:
+* true if the scan holds every mode (mutual), false if it holds the mode in
+* mode_flag only (CSD).
+*******************************************************************************/
+bool Csx_ScanComplete(void)
+{
+    uint8_t i;
+
+    if (csx_method != CSX_METHOD_MUTUAL)
+    {
+        return false;
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        // raw counts fall as the coupling grows: turn them round
+        int32_t c0 = (int32_t)CSX_RAW_FULL_SCALE - CapSense_dsRam.snsList.mutual[CSX_NODE(0u, i)].raw[0];
+        int32_t c1 = (int32_t)CSX_RAW_FULL_SCALE - CapSense_dsRam.snsList.mutual[CSX_NODE(1u, i)].raw[0];
+
+        c0 = (c0 < 0) ? 0 : c0;
+        c1 = (c1 < 0) ? 0 : c1;
+
+        // normal: both bottom electrodes, as with both grounded under CSD
+        csx_raw[SENSOR_MODE_NORMAL][i] = (uint16_t)(c0 + c1);
+        #if (SENSOR_MODE_COUNT > 1u)
+        // shear: bottom electrode 0 alone, as with electrode 1 shielded
+        csx_raw[SENSOR_MODE_SHEAR][i] = (uint16_t)c0;
+        #endif
+    }
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: Csx_GetRaw
+********************************************************************************
+* Summary:
+* Returns the raw count of a sensor from the last scan: the top_plate raw
+* count under CSD, the converted node counts of the mode under mutual.
+*
+* Parameters:
+* mode: Mode of the count.
+* sensor: top_plate sensor index.
+*
+* Return:
+* Raw count.
+*******************************************************************************/
+uint16_t Csx_GetRaw(uint8_t mode, uint8_t sensor)
+{
+    if (csx_method == CSX_METHOD_MUTUAL)
+    {
+        return csx_raw[mode][sensor];
+    }
+    return CapSense_dsRam.snsList.top_plate[sensor].raw[0];
+}
+
+
+/*******************************************************************************
+* Function Name: Csx_OnSetMethod
+********************************************************************************
+* Summary:
+* Handles a METHOD_SET command. A valid method is applied at the next cycle
+* boundary, which sends the ack; an invalid one is refused at once.
+*
+* Parameters:
+* payload: method(u8).
+* length: Payload length.
+*
+* Return:
+* None
+*******************************************************************************/
+void Csx_OnSetMethod(const uint8_t *payload, uint8_t length)
+{
+    if ((length != CSX_COMMAND_SIZE) || (payload[0] >= CSX_METHOD_COUNT))
+    {
+        Csx_SendAck((length > 0u) ? payload[0] : 0xFFu, CSX_BAD_METHOD);
+        return;
+    }
+    csx_pending = payload[0];
+}
+
+#endif /* CSX_MODE */
+
+
+/* [] END OF FILE */
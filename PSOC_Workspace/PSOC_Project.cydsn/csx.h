@@ -0,0 +1,103 @@
+/*******************************************************************************
+* File Name: csx.h
+*
+* Description: Runtime choice between the self-capacitance (CSD) two-phase
+*              scan and a mutual-capacitance (CSX) scan of the plates.
+*
+*              CSX_METHOD_CSD is the original acquisition: the top_plate
+*              widget is scanned once per mode, with the bottom_plate pins
+*              both grounded (normal) or one of them driven as shield
+*              (shear) by CapSense_StartSampleCallback. A published cycle
+*              takes two full scans.
+*
+*              CSX_METHOD_MUTUAL scans the mutual widget instead: the
+*              bottom_plate electrodes are its transmitters and the
+*              top_plate electrodes its receivers, so every node measures
+*              the coupling of one top electrode to one bottom electrode. A
+*              single scan gives both modes, in the same meaning as the CSD
+*              phases:
+*                normal = coupling to bottom electrode 0 + bottom electrode 1
+*                shear  = coupling to bottom electrode 0 alone
+*              The component reports CSX raw counts that fall as the
+*              coupling grows; they are turned round against
+*              CSX_RAW_FULL_SCALE so that, as with CSD, a press raises the
+*              counts.
+*
+*              The host selects the method with a METHOD_SET frame on the
+*              command channel; the board switches at the next cycle
+*              boundary and answers with METHOD_ACK:
+*                METHOD_SET  host -> board  method(u8)
+*                METHOD_ACK  board -> host  method(u8) status(u8)
+*              The ack is sent when the new method is in effect, so every
+*              line after it comes from that method. A switch restarts the
+*              filters and baselines. Counts of the two methods are on
+*              different scales: crosstalk coefficients, linearization
+*              tables and thresholds tuned on one do not carry over.
+*              Host_Tools/scanbench compares the frame rate and SNR of both.
+*
+*              Needs a CSX widget named "mutual" in the CapSense customizer
+*              with CSX_NUM_TX transmitters on the bottom_plate pins and
+*              SENSOR_COUNT receivers on the top_plate pins, and the UART rx
+*              pin for the command channel.
+*******************************************************************************/
+
+#ifndef CSX_H
+#define CSX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+#define CSX_METHOD_CSD          (0u)    /* self-cap, one scan per mode */
+#define CSX_METHOD_MUTUAL       (1u)    /* mutual-cap, one scan for all modes */
+#define CSX_METHOD_COUNT        (2u)
+
+/* Method in effect after a reset */
+#define CSX_DEFAULT_METHOD      CSX_METHOD_CSD
+
+/* bottom_plate transmitters and top_plate receivers of the mutual widget */
+#define CSX_NUM_TX              (2u)
+#define CSX_NUM_RX              SENSOR_COUNT
+
+/* Node index of a transmitter / receiver pair, in the order of the
+*  customizer's CapSense_MUTUAL_SNS<n>_ID (receiver-major) */
+#define CSX_NODE(tx, rx)        (((rx) * CSX_NUM_TX) + (tx))
+
+/* Maximum raw count of the mutual widget, as shown in the customizer for its
+*  sub-conversions and Tx clock. Two nodes are summed for the normal mode, so
+*  it must stay below 32768. */
+#define CSX_RAW_FULL_SCALE      (4095u)
+
+/* METHOD_SET / METHOD_ACK payloads */
+#define CSX_COMMAND_SIZE        (1u)
+#define CSX_ACK_SIZE            (2u)
+
+/* METHOD_ACK status */
+#define CSX_OK                  (0u)
+#define CSX_BAD_METHOD          (1u)    /* unknown method, or a malformed command */
+
+#if (CSX_RAW_FULL_SCALE >= 32768u)
+#error "CSX_RAW_FULL_SCALE must be below 32768: the normal mode sums two nodes"
+#endif
+#if defined(CapSense_MUTUAL_NUM_TX) && (CapSense_MUTUAL_NUM_TX != CSX_NUM_TX)
+#error "CSX_NUM_TX does not match the mutual widget in the CapSense customizer"
+#endif
+#if defined(CapSense_MUTUAL_NUM_RX) && (CapSense_MUTUAL_NUM_RX != CSX_NUM_RX)
+#error "The mutual widget needs one receiver per top_plate electrode"
+#endif
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void     Csx_Scan(void);
+bool     Csx_ScanComplete(void);
+uint16_t Csx_GetRaw(uint8_t mode, uint8_t sensor);
+void     Csx_OnSetMethod(const uint8_t *payload, uint8_t length);
+
+#endif /* CSX_H */
+
+
+/* [] END OF FILE */
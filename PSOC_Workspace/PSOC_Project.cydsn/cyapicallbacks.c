@@ -71,6 +71,14 @@
 #include <stdint.h> // Required for uint_fast8_t and uint8_t
 #include "globals.h"
 #include "project.h"
+#ifdef CSX_MODE
+#include "csx.h"
+#endif
+
+#ifdef CALIBRATION_MODE
+// timer value at the start of the previous sensor scan
+static uint32_t current_count = 0;
+#endif
 
 // Helper functions
 // this was made before I realized that I could just not read the invalid sensor values(which I already do)
@@ -114,7 +122,12 @@ void CapSense_StartSampleCallback (uint32 currentWidgetIndex, uint32 currentSens
 {
    
     uint8 sensorIndex;
- 
+    
+    #if defined(RATE_ESTIMATOR) || defined(CALIBRATION_MODE)
+    // top_plate electrode whose scan starts here, for the time stamps
+    uint8 taxel_start = (currentWidgetIndex == CapSense_TOP_PLATE_WDGT_ID);
+    uint32 taxel = currentSensorIndex;
+    #endif
     
     if(currentWidgetIndex == CapSense_TOP_PLATE_WDGT_ID)
     {
@@ -140,6 +153,19 @@ void CapSense_StartSampleCallback (uint32 currentWidgetIndex, uint32 currentSens
     }
     
     // bottom plate stuff
+    #ifdef CSX_MODE
+    if(currentWidgetIndex == CapSense_MUTUAL_WDGT_ID)
+    {
+        // mutual scan: the component drives the bottom_plate pins as its
+        // transmitters, and each top_plate receiver is scanned against every
+        // transmitter in turn
+        #if defined(RATE_ESTIMATOR) || defined(CALIBRATION_MODE)
+        taxel_start = ((currentSensorIndex % CSX_NUM_TX) == 0u);
+        taxel = currentSensorIndex / CSX_NUM_TX;
+        #endif
+    }
+    else
+    #endif
     if(!(mode_flag))
     {
         // normal mode:
@@ -159,9 +185,16 @@ void CapSense_StartSampleCallback (uint32 currentWidgetIndex, uint32 currentSens
     //CapSense_SetPinState(CapSense_SHIELD_PIN_WDGT_ID, (0u), CapSense_SHIELD);
     
     
+    #ifdef RATE_ESTIMATOR
+    // scan instant for the rate estimator
+    if( taxel_start ){
+        scan_time[taxel] = My_Time_ReadCounter();
+    }
+    #endif
+    
     #ifdef CALIBRATION_MODE
     // storing stuff for sensor by sensor output
-    if( currentWidgetIndex == CapSense_TOP_PLATE_WDGT_ID ){
+    if( taxel_start ){
         
         // checks to see if delta is negative and rectifies it if it is
         //int delta = current_count - My_Time_ReadCounter();
@@ -171,9 +204,8 @@ void CapSense_StartSampleCallback (uint32 currentWidgetIndex, uint32 currentSens
         
         
         // time stamp stuff for calibration mode
-        processed_data_array[currentSensorIndex][0] = (My_Time_ReadCounter() - current_count); 
-        processed_data_array[currentSensorIndex][1] = mode_flag;  
-        processed_data_array[currentSensorIndex][2] = currentSensorIndex;
+        // (mode and sensor columns are filled in when the line is sent)
+        scan_ticks[taxel] = (My_Time_ReadCounter() - current_count); 
             
         current_count = My_Time_ReadCounter();
         
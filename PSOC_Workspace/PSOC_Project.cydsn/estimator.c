@@ -0,0 +1,139 @@
+/*******************************************************************************
+* File Name: estimator.c
+*
+* Description: Fixed-point alpha-beta value and rate estimator. See
+*              estimator.h.
+*
+*              Internal units: values in Q8 counts, rates in Q24 counts per
+*              timer tick, times in Clock_Now() ticks.
+*******************************************************************************/
+
+#include "project.h"
+#include "estimator.h"
+
+#ifdef RATE_ESTIMATOR
+
+/*******************************************************************************
+* Function Name: Estimator_Update
+********************************************************************************
+* Summary:
+* Corrects the estimators of one mode with the scan that just completed and
+* replaces the scan values by the filtered values at the scan instant.
+*
+* The rate correction divides by the time since the channel's last update.
+* The channels of a mode are scanned one after the other at the same cadence,
+* so they share that interval up to the timer resolution: the division is
+* done once, as a Q24 reciprocal of the mean interval, and each channel
+* multiplies by it.
+*
+* Parameters:
+* values: SENSOR_COUNT values of the scan, updated in place.
+* mode: Mode of the scan.
+*
+* Return:
+* None
+*******************************************************************************/
+void Estimator_Update(int32_t *values, uint8_t mode)
+{
+    uint32_t t[SENSOR_COUNT];
+    uint32_t dt_sum = 0;
+    uint32_t tracked = 0;
+    uint32_t recip_q24 = 0;     /* 2^24 / mean interval */
+    uint8_t i;
+
+    // scan instants, and the mean interval of the channels being tracked
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        const channel_state_t *ch = &channel_state[mode][i];
+        uint32_t dt;
+
+        t[i] = Clock_FromCounter(scan_time[i]);
+        dt = t[i] - ch->est_time;
+        if ((ch->flags & CHANNEL_FLAG_EST_INIT) && (dt <= ESTIMATOR_MAX_GAP_TICKS))
+        {
+            dt_sum += (dt == 0u) ? 1u : dt;
+            tracked++;
+        }
+    }
+    if (tracked > 0u)
+    {
+        recip_q24 = ((tracked << 24) + (dt_sum >> 1)) / dt_sum;
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        channel_state_t *ch = &channel_state[mode][i];
+        int32_t z_q8 = values[i] << 8;
+        uint32_t dt = t[i] - ch->est_time;
+        int32_t predicted;
+        int32_t residual;
+
+        if (!(ch->flags & CHANNEL_FLAG_EST_INIT) || (dt > ESTIMATOR_MAX_GAP_TICKS))
+        {
+            ch->est_value_q8 = z_q8;
+            ch->est_rate_q24 = 0;
+            ch->est_time = t[i];
+            ch->flags |= CHANNEL_FLAG_EST_INIT;
+            continue;
+        }
+
+        predicted = ch->est_value_q8 + (int32_t)(((int64_t)ch->est_rate_q24 * (int32_t)dt) >> 16);
+        residual = z_q8 - predicted;
+
+        ch->est_value_q8 = predicted + ((ESTIMATOR_ALPHA_Q8 * residual) >> 8);
+        ch->est_rate_q24 += (int32_t)(((int64_t)ESTIMATOR_BETA_Q8 * residual * (int32_t)recip_q24) >> 16);
+        ch->est_time = t[i];
+
+        values[i] = (ch->est_value_q8 + 128) >> 8;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Estimator_Predict
+********************************************************************************
+* Summary:
+* Returns a channel's value predicted forward to the present moment.
+*
+* Parameters:
+* mode: Scan mode.
+* sensor: top_plate sensor index.
+*
+* Return:
+* Value in counts, clamped to 0..65535.
+*******************************************************************************/
+int32_t Estimator_Predict(uint8_t mode, uint8_t sensor)
+{
+    const channel_state_t *ch = &channel_state[mode][sensor];
+    uint32_t ahead = Clock_Now() - ch->est_time;
+    int32_t value_q8 = ch->est_value_q8 + (int32_t)(((int64_t)ch->est_rate_q24 * (int32_t)ahead) >> 16);
+    int32_t value = (value_q8 + 128) >> 8;
+
+    return (value < 0) ? 0 : ((value > 0xFFFF) ? 0xFFFF : value);
+}
+
+
+/*******************************************************************************
+* Function Name: Estimator_GetRate
+********************************************************************************
+* Summary:
+* Returns a channel's estimated rate of change.
+*
+* Parameters:
+* mode: Scan mode.
+* sensor: top_plate sensor index.
+*
+* Return:
+* Rate in counts per second.
+*******************************************************************************/
+int32_t Estimator_GetRate(uint8_t mode, uint8_t sensor)
+{
+    int64_t rate = (int64_t)channel_state[mode][sensor].est_rate_q24 * CLOCK_HZ;
+
+    return (int32_t)((rate + (1 << 23)) >> 24);
+}
+
+#endif /* RATE_ESTIMATOR */
+
+
+/* [] END OF FILE */
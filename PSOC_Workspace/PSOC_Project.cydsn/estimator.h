@@ -0,0 +1,54 @@
+/*******************************************************************************
+* File Name: estimator.h
+*
+* Description: Per-channel alpha-beta estimator of value and rate.
+*
+*              Each channel tracks a value x and a rate v. At every scan the
+*              state is predicted to the scan instant, taken from the My_Time
+*              timestamp of the sensor scan, and corrected with the residual
+*              r = z - x:
+*                x += ESTIMATOR_ALPHA * r
+*                v += ESTIMATOR_BETA  * r / dt
+*              Because dt comes from the timer, uneven scan intervals
+*              (frequency hopping, self-test steps, UART back-pressure) do not
+*              bias the rate.
+*
+*              When a line is sent, the value is predicted forward from the
+*              scan instant to that moment, which removes the
+*              scan-to-publish latency of the main loop. The rate is sent
+*              alongside in counts per second: in the CALIB_COL_RATE column,
+*              or after the values in the VISUALIZATION_MODE line.
+*
+*              The estimator replaces the moving average (AVG_FILTER_SHIFT
+*              is 0).
+*******************************************************************************/
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <stdint.h>
+#include "globals.h"
+#include "clock.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Gains in Q8. beta = alpha^2 / (2 - alpha) gives a critically damped
+*  tracker; smaller alpha smooths more and lags more. */
+#define ESTIMATOR_ALPHA_Q8      (102)   /* 0.4 */
+#define ESTIMATOR_BETA_Q8       (26)    /* 0.1 */
+
+/* A channel not updated for this long restarts from its next sample */
+#define ESTIMATOR_MAX_GAP_TICKS (CLOCK_HZ)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void    Estimator_Update(int32_t *values, uint8_t mode);
+int32_t Estimator_Predict(uint8_t mode, uint8_t sensor);
+int32_t Estimator_GetRate(uint8_t mode, uint8_t sensor);
+
+#endif /* ESTIMATOR_H */
+
+
+/* [] END OF FILE */
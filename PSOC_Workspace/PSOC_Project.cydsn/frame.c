@@ -0,0 +1,174 @@
+/*******************************************************************************
+* File Name: frame.c
+*
+* Description: Streams binary frames (see frame.h) into the UART transmit
+*              path (tx.h), computing the CRC on the fly so no frame-sized buffer
+*              is needed on the stack.
+*******************************************************************************/
+
+#include "project.h"
+#include "frame.h"
+#include "tx.h"
+
+/* CRC of the frame currently being written */
+static uint8_t frame_crc;
+
+
+/*******************************************************************************
+* Function Name: Frame_Crc8Update
+********************************************************************************
+* Summary:
+* Folds one byte into a CRC-8 (polynomial 0x07). Bitwise, to avoid spending
+* 256 bytes of flash on a table.
+*
+* Parameters:
+* crc: Running CRC value.
+* value: Byte to add.
+*
+* Return:
+* Updated CRC.
+*******************************************************************************/
+uint8_t Frame_Crc8Update(uint8_t crc, uint8_t value)
+{
+    uint8_t bit;
+
+    crc ^= value;
+    for (bit = 0u; bit < 8u; bit++)
+    {
+        if (crc & 0x80u)
+        {
+            crc = (uint8_t)((crc << 1) ^ 0x07u);
+        }
+        else
+        {
+            crc = (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+
+/*******************************************************************************
+* Function Name: Frame_Begin
+********************************************************************************
+* Summary:
+* Writes the sync bytes and header of a new frame. Exactly 'length' payload
+* bytes must follow before Frame_End() is called.
+*
+* Parameters:
+* type: One of the FRAME_TYPE_* values.
+* length: Number of payload bytes.
+*
+* Return:
+* None
+*******************************************************************************/
+void Frame_Begin(uint8_t type, uint8_t length)
+{
+    Tx_PutByte(FRAME_SYNC_0);
+    Tx_PutByte(FRAME_SYNC_1);
+
+    frame_crc = 0u;
+    Frame_PutByte(type);
+    Frame_PutByte(length);
+}
+
+
+/*******************************************************************************
+* Function Name: Frame_PutByte
+********************************************************************************
+* Summary:
+* Appends one payload byte to the current frame.
+*
+* Parameters:
+* value: Byte to send.
+*
+* Return:
+* None
+*******************************************************************************/
+void Frame_PutByte(uint8_t value)
+{
+    frame_crc = Frame_Crc8Update(frame_crc, value);
+    Tx_PutByte(value);
+}
+
+
+/*******************************************************************************
+* Function Name: Frame_PutU16
+********************************************************************************
+* Summary:
+* Appends a 16-bit value to the current frame, least significant byte first.
+*
+* Parameters:
+* value: Value to send.
+*
+* Return:
+* None
+*******************************************************************************/
+void Frame_PutU16(uint16_t value)
+{
+    Frame_PutByte((uint8_t)(value & 0xFFu));
+    Frame_PutByte((uint8_t)(value >> 8));
+}
+
+
+/*******************************************************************************
+* Function Name: Frame_PutU32
+********************************************************************************
+* Summary:
+* Appends a 32-bit value to the current frame, least significant byte first.
+*
+* Parameters:
+* value: Value to send.
+*
+* Return:
+* None
+*******************************************************************************/
+void Frame_PutU32(uint32_t value)
+{
+    Frame_PutU16((uint16_t)(value & 0xFFFFu));
+    Frame_PutU16((uint16_t)(value >> 16));
+}
+
+
+/*******************************************************************************
+* Function Name: Frame_PutBytes
+********************************************************************************
+* Summary:
+* Appends a block of bytes to the current frame.
+*
+* Parameters:
+* data: Bytes to send.
+* length: Number of bytes.
+*
+* Return:
+* None
+*******************************************************************************/
+void Frame_PutBytes(const uint8_t *data, uint8_t length)
+{
+    while (length-- > 0u)
+    {
+        Frame_PutByte(*data++);
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Frame_End
+********************************************************************************
+* Summary:
+* Terminates the current frame by sending its CRC.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Frame_End(void)
+{
+    Tx_PutByte(frame_crc);
+    Tx_EndMessage();
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,64 @@
+/*******************************************************************************
+* File Name: frame.h
+*
+* Description: Binary frame format shared by every non-CSV message the
+*              firmware sends over the UART.
+*
+*              Wire layout (multi-byte fields are little-endian):
+*                SYNC0 SYNC1 TYPE LEN PAYLOAD[LEN] CRC8
+*              CRC8 uses polynomial 0x07 over TYPE, LEN and PAYLOAD.
+*
+*              Frames may be interleaved with the "\n...\r" CSV lines; a host
+*              parser resynchronizes on the two sync bytes. The host sends
+*              commands to the board in the same format (command.h).
+*******************************************************************************/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+#define FRAME_SYNC_0            (0xA5u)
+#define FRAME_SYNC_1            (0x5Au)
+#define FRAME_HEADER_SIZE       (4u)    /* sync0, sync1, type, length */
+#define FRAME_OVERHEAD          (5u)    /* header + crc */
+#define FRAME_MAX_PAYLOAD       (255u)
+
+/* Frame types */
+#define FRAME_TYPE_LAYOUT       (0x01u) /* SENSOR_LAYOUT_DESCRIPTOR, sent at start-up */
+#define FRAME_TYPE_CAPTURE_INFO (0x10u) /* capture dump header */
+#define FRAME_TYPE_CAPTURE_DATA (0x11u) /* one packed capture frame */
+#define FRAME_TYPE_CAPTURE_END  (0x12u) /* capture dump trailer */
+#define FRAME_TYPE_CONTACT      (0x20u) /* contact position, width, load (localize.h) */
+#define FRAME_TYPE_FAULTS       (0x21u) /* electrode fault bitmaps (selftest.h) */
+#define FRAME_TYPE_SLIP         (0x22u) /* slip alert, priority lane (slip.h) */
+#define FRAME_TYPE_SYNC_PING    (0x30u) /* host -> board: time sync request (timesync.h) */
+#define FRAME_TYPE_SYNC_PONG    (0x31u) /* board -> host: time sync reply */
+#define FRAME_TYPE_TIMESTAMP    (0x32u) /* synchronized time of the following data */
+#define FRAME_TYPE_LUT_WRITE    (0x40u) /* host -> board: linearization breakpoints (linearize.h) */
+#define FRAME_TYPE_LUT_COMMIT   (0x41u) /* host -> board: store a table in flash */
+#define FRAME_TYPE_LUT_ACK      (0x42u) /* board -> host: result of a LUT command */
+#define FRAME_TYPE_METHOD_SET   (0x50u) /* host -> board: select CSD or mutual scanning (csx.h) */
+#define FRAME_TYPE_METHOD_ACK   (0x51u) /* board -> host: scan method in effect */
+#define FRAME_TYPE_XT_WRITE     (0x60u) /* host -> board: crosstalk matrix row (crosstalk.h) */
+#define FRAME_TYPE_XT_COMMIT    (0x61u) /* host -> board: store the matrix in flash */
+#define FRAME_TYPE_XT_ACK       (0x62u) /* board -> host: result of a crosstalk command */
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+uint8_t Frame_Crc8Update(uint8_t crc, uint8_t value);
+void Frame_Begin(uint8_t type, uint8_t length);
+void Frame_PutByte(uint8_t value);
+void Frame_PutU16(uint16_t value);
+void Frame_PutU32(uint32_t value);
+void Frame_PutBytes(const uint8_t *data, uint8_t length);
+void Frame_End(void);
+
+#endif /* FRAME_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,397 @@
+/*******************************************************************************
+* File Name: freqhop.c
+*
+* Description: Sense-clock hopping, per-frequency gain and noise tracking
+*              and median combination of the top_plate raw counts. See
+*              freqhop.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "globals.h"
+#include "freqhop.h"
+
+#ifdef FREQHOP_MODE
+
+#if (CapSense_TOP_PLATE_SNS_CLK < 6u)
+#error "FREQHOP_MODE needs a top_plate sense clock divider of 6 or more in the CapSense customizer, so the three dividers differ"
+#endif
+
+#define FREQHOP_ALL_MASK    ((uint8_t)((1u << FREQHOP_NUM_FREQS) - 1u))
+
+static const uint16_t freqhop_dividers[FREQHOP_NUM_FREQS] = FREQHOP_SNS_CLK_DIVIDERS;
+
+/* Raw counts of the current mode scan, per frequency */
+static uint16_t freqhop_raw[FREQHOP_NUM_FREQS][FREQHOP_NUM_SENSORS];
+
+/* Gain of each frequency onto the common level, per mode (Q12) */
+static uint16_t freqhop_gain[SENSOR_MODE_COUNT][FREQHOP_NUM_FREQS][FREQHOP_NUM_SENSORS];
+
+/* Frequencies whose gains are valid, per mode */
+static uint8_t  freqhop_seeded[SENSOR_MODE_COUNT];
+
+/* Untouched level of the combined counts, per mode (Q4) */
+static int32_t  freqhop_rest[SENSOR_MODE_COUNT][FREQHOP_NUM_SENSORS];
+
+/* Mean deviation from the median, per frequency (Q4) */
+static int32_t  freqhop_noise[FREQHOP_NUM_FREQS];
+
+/* Cycles until a dropped frequency is probed again */
+static uint16_t freqhop_retry[FREQHOP_NUM_FREQS];
+
+static uint16_t freqhop_result[FREQHOP_NUM_SENSORS];
+static uint8_t  freqhop_active = FREQHOP_ALL_MASK;
+static uint8_t  freqhop_scanned = 0;    /* frequencies scanned this cycle */
+static uint8_t  freqhop_current = 0;    /* frequency of the running scan */
+
+
+/*******************************************************************************
+* Function Name: FreqHop_SetFrequency
+********************************************************************************
+* Summary:
+* Selects the sense clock divider used by the next top_plate scan.
+*
+* Parameters:
+* freq: Index into FREQHOP_SNS_CLK_DIVIDERS.
+*
+* Return:
+* None
+*******************************************************************************/
+static void FreqHop_SetFrequency(uint8_t freq)
+{
+    freqhop_current = freq;
+    CapSense_dsRam.wdgtList.top_plate.snsClk = freqhop_dividers[freq];
+
+    #if (CapSense_ENABLE == CapSense_TST_WDGT_CRC_EN)
+    // keep the self-test widget CRC in step with the changed parameter
+    CapSense_DsUpdateWidgetCrc(CapSense_TOP_PLATE_WDGT_ID);
+    #endif
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_Median
+********************************************************************************
+* Summary:
+* Median of up to three values; the mean for two.
+*
+* Parameters:
+* values: Candidate values.
+* count: Number of candidates, 1..3.
+*
+* Return:
+* Median.
+*******************************************************************************/
+static int32_t FreqHop_Median(const int32_t *values, uint8_t count)
+{
+    int32_t a = values[0];
+    int32_t b;
+    int32_t c;
+
+    if (count == 1u)
+    {
+        return a;
+    }
+    b = values[1];
+    if (count == 2u)
+    {
+        return (a + b) / 2;
+    }
+    c = values[2];
+
+    if (a > b) { int32_t t = a; a = b; b = t; }
+    if (b > c) { b = c; }
+    return (a > b) ? a : b;
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_Map
+********************************************************************************
+* Summary:
+* Scales a raw count of one frequency onto the common level.
+*
+* Parameters:
+* raw: Raw count.
+* gain: Gain of the frequency, Q12.
+*
+* Return:
+* Mapped count, Q4.
+*******************************************************************************/
+static int32_t FreqHop_Map(uint16_t raw, uint16_t gain)
+{
+    return (int32_t)(((uint32_t)raw * gain) >> 8);
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_Combine
+********************************************************************************
+* Summary:
+* Maps the raw counts of every scanned frequency onto the common level, takes
+* the median per sensor and updates the gains, noise levels and the set of
+* active frequencies.
+*
+* The gains track only while no sensor of the mode is touched, and no
+* frequency is dropped then either: a press that the gains do not fully
+* cancel would otherwise count as noise. Tracking costs one software divide
+* per sensor and non-anchor frequency, at most 2 * FREQHOP_NUM_SENSORS per
+* mode scan.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+static void FreqHop_Combine(void)
+{
+    uint8_t  mode = mode_flag;
+    uint8_t  measured = (uint8_t)(freqhop_scanned & freqhop_seeded[mode]);
+    uint32_t deviation[FREQHOP_NUM_FREQS] = { 0 };
+    int32_t  median[FREQHOP_NUM_SENSORS];
+    bool     touched = false;
+    uint8_t  f;
+    uint8_t  i;
+
+    // at start-up nothing is seeded yet: the first frequency defines the level
+    if (measured == 0u)
+    {
+        for (f = 0; (freqhop_scanned & (1u << f)) == 0u; f++) { }
+        for (i = 0; i < FREQHOP_NUM_SENSORS; i++)
+        {
+            freqhop_gain[mode][f][i] = 1u << 12;
+            freqhop_rest[mode][i] = (int32_t)freqhop_raw[f][i] << 4;
+        }
+        freqhop_seeded[mode] |= (uint8_t)(1u << f);
+        measured = (uint8_t)(1u << f);
+    }
+
+    for (i = 0; i < FREQHOP_NUM_SENSORS; i++)
+    {
+        int32_t candidate[FREQHOP_NUM_FREQS];
+        uint8_t count = 0;
+
+        for (f = 0; f < FREQHOP_NUM_FREQS; f++)
+        {
+            if (measured & (1u << f))
+            {
+                candidate[count++] = FreqHop_Map(freqhop_raw[f][i], freqhop_gain[mode][f][i]);
+            }
+        }
+        median[i] = FreqHop_Median(candidate, count);
+        freqhop_result[i] = (uint16_t)((median[i] + 8) >> 4);
+
+        // a press raises the counts; a level below rest is taken over at once
+        if (median[i] > (freqhop_rest[mode][i] + ((int32_t)FREQHOP_TOUCH_BAND << 4)))
+        {
+            touched = true;
+        }
+        else if (median[i] < (freqhop_rest[mode][i] - ((int32_t)FREQHOP_TOUCH_BAND << 4)))
+        {
+            freqhop_rest[mode][i] = median[i];
+        }
+    }
+
+    for (i = 0; i < FREQHOP_NUM_SENSORS; i++)
+    {
+        if (!touched)
+        {
+            freqhop_rest[mode][i] += (median[i] - freqhop_rest[mode][i]) >> FREQHOP_GAIN_SHIFT;
+        }
+
+        for (f = 0; f < FREQHOP_NUM_FREQS; f++)
+        {
+            uint16_t raw = freqhop_raw[f][i];
+
+            if (measured & (1u << f))
+            {
+                int32_t error = FreqHop_Map(raw, freqhop_gain[mode][f][i]) - median[i];
+
+                deviation[f] += (uint32_t)((error < 0) ? -error : error);
+
+                // the lowest measured frequency anchors the level; the others
+                // follow it by the relative error, error / raw in Q12
+                if (!touched && (raw != 0u) && ((measured & ((1u << f) - 1u)) != 0u))
+                {
+                    int32_t step = (error * 256) / (int32_t)raw;
+                    int32_t gain = (int32_t)freqhop_gain[mode][f][i] -
+                                   ((step + (1 << (FREQHOP_GAIN_SHIFT - 1u))) >> FREQHOP_GAIN_SHIFT);
+
+                    freqhop_gain[mode][f][i] = (uint16_t)((gain < 1) ? 1 : ((gain > 0xFFFF) ? 0xFFFF : gain));
+                }
+            }
+            else if ((freqhop_scanned & (1u << f)) && (raw != 0u))
+            {
+                // first scan after (re)joining: line it up with the median
+                uint32_t gain = (((uint32_t)median[i] << 8) + (raw >> 1)) / raw;
+
+                freqhop_gain[mode][f][i] = (uint16_t)((gain > 0xFFFFu) ? 0xFFFFu : gain);
+            }
+        }
+    }
+    freqhop_seeded[mode] |= freqhop_scanned;
+
+    // noise tracking and drop-out of the noisiest frequency
+    {
+        int32_t worst_noise = (int32_t)FREQHOP_NOISE_LIMIT << 4;
+        uint8_t worst = FREQHOP_NUM_FREQS;
+        uint8_t active_count = 0;
+
+        for (f = 0; f < FREQHOP_NUM_FREQS; f++)
+        {
+            if ((measured & (1u << f)) && !touched)
+            {
+                int32_t mean = (int32_t)(deviation[f] / FREQHOP_NUM_SENSORS);
+                freqhop_noise[f] += (mean - freqhop_noise[f]) >> FREQHOP_NOISE_SHIFT;
+            }
+            if (freqhop_active & (1u << f))
+            {
+                active_count++;
+                if (freqhop_noise[f] > worst_noise)
+                {
+                    worst_noise = freqhop_noise[f];
+                    worst = f;
+                }
+            }
+            else if ((mode == SENSOR_MODE_LAST) && (--freqhop_retry[f] == 0u))
+            {
+                // probe again with a clean slate (counted once per cycle)
+                freqhop_active |= (uint8_t)(1u << f);
+                for (i = 0; i < SENSOR_MODE_COUNT; i++)
+                {
+                    freqhop_seeded[i] &= (uint8_t)~(1u << f);
+                }
+                freqhop_noise[f] = 0;
+            }
+        }
+
+        if (!touched && (worst < FREQHOP_NUM_FREQS) && (active_count > 1u))
+        {
+            freqhop_active &= (uint8_t)~(1u << worst);
+            freqhop_retry[worst] = FREQHOP_RETRY_CYCLES;
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_Start
+********************************************************************************
+* Summary:
+* Begins a mode scan: selects the first active frequency. Call before
+* CapSense_ScanAllWidgets().
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void FreqHop_Start(void)
+{
+    uint8_t f = 0;
+
+    while ((freqhop_active & (1u << f)) == 0u)
+    {
+        f++;
+    }
+    freqhop_scanned = 0;
+    FreqHop_SetFrequency(f);
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_Accumulate
+********************************************************************************
+* Summary:
+* Stores the scan that just completed and selects the next active frequency.
+* After the last one, combines the frequencies into FreqHop_GetRaw().
+*
+* Parameters:
+* None
+*
+* Return:
+* true when all active frequencies of the mode scan are in, false otherwise.
+*******************************************************************************/
+bool FreqHop_Accumulate(void)
+{
+    uint8_t i;
+    uint8_t f;
+
+    for (i = 0; i < FREQHOP_NUM_SENSORS; i++)
+    {
+        freqhop_raw[freqhop_current][i] = CapSense_dsRam.snsList.top_plate[i].raw[0];
+    }
+    freqhop_scanned |= (uint8_t)(1u << freqhop_current);
+
+    for (f = (uint8_t)(freqhop_current + 1u); f < FREQHOP_NUM_FREQS; f++)
+    {
+        if (freqhop_active & (1u << f))
+        {
+            FreqHop_SetFrequency(f);
+            return false;
+        }
+    }
+
+    FreqHop_Combine();
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_GetRaw
+********************************************************************************
+* Summary:
+* Returns the combined raw count of one sensor from the last mode scan.
+*
+* Parameters:
+* sensor: top_plate sensor index.
+*
+* Return:
+* Median raw count.
+*******************************************************************************/
+uint16_t FreqHop_GetRaw(uint8_t sensor)
+{
+    return freqhop_result[sensor];
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_GetNoise
+********************************************************************************
+* Summary:
+* Returns the tracked noise level of one frequency.
+*
+* Parameters:
+* freq: Index into FREQHOP_SNS_CLK_DIVIDERS.
+*
+* Return:
+* Mean deviation from the median, in raw counts.
+*******************************************************************************/
+uint16_t FreqHop_GetNoise(uint8_t freq)
+{
+    return (uint16_t)((freqhop_noise[freq] + 8) >> 4);
+}
+
+
+/*******************************************************************************
+* Function Name: FreqHop_GetActiveMask
+********************************************************************************
+* Summary:
+* Returns the set of frequencies currently scanned, one bit per frequency.
+*
+* Parameters:
+* None
+*
+* Return:
+* Active frequency mask.
+*******************************************************************************/
+uint8_t FreqHop_GetActiveMask(void)
+{
+    return freqhop_active;
+}
+
+#endif /* FREQHOP_MODE */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,67 @@
+/*******************************************************************************
+* File Name: freqhop.h
+*
+* Description: Multi-frequency scanning with outlier rejection.
+*
+*              Each mode scan is repeated at FREQHOP_NUM_FREQS sense-clock
+*              dividers. Raw counts, and the size of a press in them, scale
+*              with the sense clock, so every frequency keeps a slowly
+*              tracked gain per mode and sensor that maps it onto the common
+*              level. The published value is the median of the mapped values.
+*
+*              Each frequency also tracks a noise level: the mean distance
+*              of its mapped values from the median. The noisiest frequency
+*              above FREQHOP_NOISE_LIMIT is dropped from the sequence (which
+*              also shortens the cycle) and probed again after
+*              FREQHOP_RETRY_CYCLES cycles. While any sensor of a mode is more
+*              than FREQHOP_TOUCH_BAND above its rest level, the gains, the
+*              noise levels and the drop-out of that mode are frozen.
+*******************************************************************************/
+
+#ifndef FREQHOP_H
+#define FREQHOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+#define FREQHOP_NUM_SENSORS     SENSOR_COUNT
+#define FREQHOP_NUM_FREQS       (3u)
+
+/* Sense clock dividers for the top_plate widget: the customizer value and one
+*  sixth of it either side. Both the dividers and the frequencies they give
+*  stay within 20% of the customizer's, so the modulator IDAC stays in range. */
+#define FREQHOP_SNS_CLK_BASE        (CapSense_TOP_PLATE_SNS_CLK)
+#define FREQHOP_SNS_CLK_STEP        (FREQHOP_SNS_CLK_BASE / 6u)
+#define FREQHOP_SNS_CLK_DIVIDERS    { FREQHOP_SNS_CLK_BASE - FREQHOP_SNS_CLK_STEP, \
+                                      FREQHOP_SNS_CLK_BASE,                        \
+                                      FREQHOP_SNS_CLK_BASE + FREQHOP_SNS_CLK_STEP }
+
+/* Gain and rest level tracking speed: 1/2^N of the error per cycle */
+#define FREQHOP_GAIN_SHIFT      (5u)
+/* Rise above the rest level, in raw counts, that counts as touched */
+#define FREQHOP_TOUCH_BAND      (40)
+/* Noise averaging speed: 1/2^N per cycle */
+#define FREQHOP_NOISE_SHIFT     (3u)
+/* Mean deviation from the median, in raw counts, above which a frequency
+*  is dropped */
+#define FREQHOP_NOISE_LIMIT     (20u)
+/* Cycles a dropped frequency stays out before it is probed again */
+#define FREQHOP_RETRY_CYCLES    (500u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void     FreqHop_Start(void);
+bool     FreqHop_Accumulate(void);
+uint16_t FreqHop_GetRaw(uint8_t sensor);
+uint16_t FreqHop_GetNoise(uint8_t freq);
+uint8_t  FreqHop_GetActiveMask(void);
+
+#endif /* FREQHOP_H */
+
+
+/* [] END OF FILE */
@@ -9,18 +9,149 @@
 #define CALIBRATION_MODE
 //#define VISUALIZATION_MODE
 
+// records full-rate raw frames into an SRAM ring and dumps them on a trigger
+// instead of streaming CSV lines (see capture.h)
+//#define CAPTURE_MODE
+
+// builds each published normal/shear pair from chopped sub-scans instead of
+// one full scan per mode (see oversample.h)
+//#define OVERSAMPLE_MODE
+
+// scans each mode at several sense clock frequencies and publishes the
+// median, dropping frequencies that get noisy (see freqhop.h)
+//#define FREQHOP_MODE
+
+// removes the ghost signal that a press couples into the neighbouring
+// electrodes, using the per-unit matrix stored in flash (see crosstalk.h).
+// Needs the UART rx pin to load the matrix.
+//#define CROSSTALK_COMPENSATION
+
+// sends contact position, width, load and shear once per cycle as a binary
+// frame instead of the CSV lines (see localize.h)
+//#define CONTACT_LOCALIZATION
+
+// checks the electrodes for opens, shorts and out-of-range counts between
+// scan cycles, reports a fault bitmap and masks faulty channels (see selftest.h)
+//#define SELF_TEST
+
+// shortens the CALIBRATION_MODE moving average on fast changes and lengthens
+// it at rest, adding the window to every line (see adaptive.h)
+//#define ADAPTIVE_FILTER
+
+// replaces the moving average by an alpha-beta estimator that also sends the
+// rate of every channel and predicts values to the send time (see estimator.h)
+//#define RATE_ESTIMATOR
+
+// answers host time sync pings on the UART receive line and stamps the data
+// with the synchronized host time (see timesync.h). Needs the UART rx pin.
+//#define TIME_SYNC
+
+// converts the processed counts of every channel into load units with a
+// piecewise-linear table per channel, loaded by the host into flash (see
+// linearize.h). Needs the UART rx pin.
+//#define LINEARIZATION
+
+// watches the shear scans for incipient slip and sends an alert frame ahead of
+// the queued data stream (see slip.h)
+//#define SLIP_DETECTION
+
+// adds a mutual-capacitance scan method, the bottom_plate electrodes driving
+// and the top_plate electrodes receiving, that gives both modes in one scan.
+// The host switches between it and the CSD two-phase scan at runtime (see
+// csx.h). Needs the mutual widget in the CapSense customizer and the UART rx pin.
+//#define CSX_MODE
+
+// host-to-board commands, for the features that take them (see command.h)
+#if defined(TIME_SYNC) || defined(LINEARIZATION) || defined(CSX_MODE) || \
+    defined(CROSSTALK_COMPENSATION)
+#define COMMAND_CHANNEL
+#endif
+
+// transmit queue with a priority lane, for the features that send alerts (see tx.h)
+#if defined(SLIP_DETECTION)
+#define TX_PRIORITY_QUEUE
+#endif
+
+#if defined(CAPTURE_MODE) && (defined(OVERSAMPLE_MODE) || defined(FREQHOP_MODE))
+#error "CAPTURE_MODE records single raw scans and cannot be combined with OVERSAMPLE_MODE or FREQHOP_MODE"
+#endif
+#if defined(CAPTURE_MODE) && (defined(CONTACT_LOCALIZATION) || defined(SELF_TEST) || \
+                              defined(RATE_ESTIMATOR) || defined(LINEARIZATION) || defined(SLIP_DETECTION))
+#error "CAPTURE_MODE bypasses Post_Process, where CONTACT_LOCALIZATION, SELF_TEST, RATE_ESTIMATOR, LINEARIZATION and SLIP_DETECTION run"
+#endif
+#if defined(CSX_MODE) && (defined(CAPTURE_MODE) || defined(OVERSAMPLE_MODE) || defined(FREQHOP_MODE))
+#error "CSX_MODE sequences its own widget scans and cannot be combined with CAPTURE_MODE, OVERSAMPLE_MODE or FREQHOP_MODE"
+#endif
+#if defined(ADAPTIVE_FILTER) && defined(RATE_ESTIMATOR)
+#error "ADAPTIVE_FILTER and RATE_ESTIMATOR are both the smoothing stage; select only one"
+#endif
+#if defined(OVERSAMPLE_MODE) && defined(FREQHOP_MODE)
+#error "OVERSAMPLE_MODE and FREQHOP_MODE both sequence sub-scans; select only one"
+#endif
+
+// sensor count, modes and the array/frame layouts derived from them
+#include "sensor_config.h"
+
     
-// Declare the variable as 'extern'.
-// This tells other files: "This variable exists, but it's defined elsewhere."
+// Moving average depth per channel. A power of two, so the average is a shift:
+// the Cortex-M0+ has no divide instruction, and every division is a library
+// call of tens of cycles. The firmware keeps them out of the per-sample paths.
+#if defined(CAPTURE_MODE) || defined(RATE_ESTIMATOR)
+#define AVG_FILTER_SHIFT        (0u)    /* not published / estimator smooths */
+#elif defined(OVERSAMPLE_MODE)
+#define AVG_FILTER_SHIFT        (4u)    /* 16 cycles: the sense periods of the 8-scan boxcar (oversample.h) */
+#elif defined(ADAPTIVE_FILTER)
+#define AVG_FILTER_SHIFT        (4u)    /* window at rest; shortens on a step */
+#else
+#define AVG_FILTER_SHIFT        (3u)    /* 8 scans of the same mode. Adjust as needed. */
+#endif
+#define AVG_FILTER_NUM_SAMPLES  (1u << AVG_FILTER_SHIFT)
+
+// channel_state_t flags
+#define CHANNEL_FLAG_FILTER_INIT    (0x01u)     /* avg_history holds samples */
+#define CHANNEL_FLAG_EST_INIT       (0x02u)     /* estimator state is valid */
+
+// Processing state of one channel (one sensor in one mode). Fields are
+// ordered by size so the struct has no padding holes. Only the main loop
+// touches it, so it is not volatile.
+typedef struct
+{
+    #ifdef RATE_ESTIMATOR
+    int32_t  est_value_q8;      /* value at est_time, Q8 (estimator.c) */
+    int32_t  est_rate_q24;      /* counts per timer tick, Q24 */
+    uint32_t est_time;          /* timer ticks of the last update */
+    #endif
+    #if defined(CROSSTALK_COMPENSATION) || defined(CONTACT_LOCALIZATION) || defined(SLIP_DETECTION)
+    int32_t  baseline_q8;       /* rest level in Q8 (baseline.c) */
+    #endif
+    #ifdef SELF_TEST
+    int32_t  held;              /* last good value where faults are masked (selftest.c) */
+    #endif
+    uint32_t avg_sum;           /* running sum of avg_history */
+    uint16_t raw;               /* raw count of the last scan */
+    uint16_t value;             /* processed output of the last scan */
+    uint16_t avg_history[AVG_FILTER_NUM_SAMPLES];
+    uint8_t  avg_index;         /* oldest entry of avg_history */
+    #ifdef ADAPTIVE_FILTER
+    uint8_t  window_shift;      /* log2 of the averaging window (adaptive.c) */
+    uint8_t  settled_scans;     /* scans since the last step (adaptive.c) */
+    #endif
+    uint8_t  flags;             /* CHANNEL_FLAG_* */
+} channel_state_t;
+
+extern channel_state_t channel_state[SENSOR_MODE_COUNT][SENSOR_COUNT];
+
+// Read by the CapSense scan callback in interrupt context, hence volatile.
 extern volatile uint8_t mode_flag;
     
 #ifdef CALIBRATION_MODE
-extern volatile int32_t processed_data_array[8][4];
-extern volatile uint32_t current_count;
+// timer ticks between the start of the previous sensor scan and this one
+extern volatile uint32_t scan_ticks[SENSOR_COUNT];
 #endif
 
-#ifdef VISUALIZATION_MODE
-extern volatile int32_t processed_data_array[16];
+#ifdef RATE_ESTIMATOR
+// My_Time reading at the start of each sensor's last scan
+extern volatile uint32_t scan_time[SENSOR_COUNT];
 #endif
 
 
@@ -0,0 +1,295 @@
+/*******************************************************************************
+* File Name: linearize.c
+*
+* Description: Per-channel lookup tables from counts to load units, stored in
+*              flash. See linearize.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "linearize.h"
+#include "frame.h"
+
+#include <stdbool.h>
+
+#ifdef LINEARIZATION
+
+#define LINEARIZE_NONE          (0xFFu)     /* no channel staged */
+
+/* One channel. 8 bytes per breakpoint with no padding, so a whole number of
+*  tables fills a flash row. */
+typedef struct
+{
+    uint16_t counts[LINEARIZE_POINTS];          /* ascending */
+    uint16_t loads[LINEARIZE_POINTS];
+    int32_t  slopes_q16[LINEARIZE_POINTS - 1u]; /* of the segment starting at each point */
+    uint8_t  points;                            /* 0: no table */
+    uint8_t  reserved[3];
+} linearize_table_t;
+
+/* The tables, row aligned so every table lies within one row. Rewritten by
+*  CySysFlashWriteRow behind the compiler's back, hence volatile. Until a table
+*  is loaded every channel passes its counts through. */
+static volatile const linearize_table_t linearize_tables[SENSOR_MODE_COUNT][SENSOR_COUNT]
+    CY_ALIGN(CY_FLASH_SIZEOF_ROW) = {{{{0u}, {0u}, {0}, 0u, {0u}}}};
+
+/* Flash row holding the table being edited, read back from flash by the first
+*  LUT_WRITE and written by LUT_COMMIT */
+static uint32_t linearize_row[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+static uint8_t  linearize_staged = LINEARIZE_NONE;
+
+
+/*******************************************************************************
+* Function Name: Linearize_Eval
+********************************************************************************
+* Summary:
+* Looks up one value in a channel's table.
+*
+* Parameters:
+* table: Table of the channel.
+* value: Count.
+*
+* Return:
+* Load, or the count itself if the channel has no table.
+*******************************************************************************/
+static int32_t Linearize_Eval(volatile const linearize_table_t *table, int32_t value)
+{
+    uint8_t lo = 0u;
+    uint8_t hi = table->points;
+
+    if ((hi < 2u) || (hi > LINEARIZE_POINTS))
+    {
+        return value;
+    }
+    hi--;
+
+    // last breakpoint at or below the value, stopping one short of the end so
+    // values beyond the table use the end segments
+    while ((uint8_t)(hi - lo) > 1u)
+    {
+        uint8_t mid = (uint8_t)((lo + hi) >> 1);
+
+        if (value >= (int32_t)table->counts[mid])
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (int32_t)table->loads[lo] +
+           (int32_t)((((int64_t)(value - (int32_t)table->counts[lo]) * table->slopes_q16[lo]) +
+                      (1 << (LINEARIZE_SLOPE_Q - 1u))) >> LINEARIZE_SLOPE_Q);
+}
+
+
+/*******************************************************************************
+* Function Name: Linearize_Apply
+********************************************************************************
+* Summary:
+* Converts one scan from counts to load units.
+*
+* Parameters:
+* values: SENSOR_COUNT values of the scan, converted in place.
+* mode: Mode of the scan.
+*
+* Return:
+* None
+*******************************************************************************/
+void Linearize_Apply(int32_t *values, uint8_t mode)
+{
+    uint8_t i;
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        values[i] = Linearize_Eval(&linearize_tables[mode][i], values[i]);
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Linearize_Ack
+********************************************************************************
+* Summary:
+* Sends a LUT_ACK frame.
+*
+* Parameters:
+* payload: Command payload, whose mode and sensor are echoed.
+* length: Command payload length.
+* status: LINEARIZE_OK or an error.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Linearize_Ack(const uint8_t *payload, uint8_t length, uint8_t status)
+{
+    Frame_Begin(FRAME_TYPE_LUT_ACK, LINEARIZE_ACK_SIZE);
+    Frame_PutByte((length > 0u) ? payload[0] : 0xFFu);
+    Frame_PutByte((length > 1u) ? payload[1] : 0xFFu);
+    Frame_PutByte(status);
+    Frame_End();
+}
+
+
+/*******************************************************************************
+* Function Name: Linearize_Stage
+********************************************************************************
+* Summary:
+* Makes a channel's table editable: copies its flash row into linearize_row,
+* discarding edits of another channel that were not committed.
+*
+* Parameters:
+* channel: mode * SENSOR_COUNT + sensor.
+*
+* Return:
+* Table of the channel inside linearize_row.
+*******************************************************************************/
+static linearize_table_t *Linearize_Stage(uint8_t channel)
+{
+    uint32_t offset = ((uint32_t)(uintptr_t)&linearize_tables[0][0] + ((uint32_t)channel * sizeof(linearize_table_t))) %
+                      CY_FLASH_SIZEOF_ROW;
+
+    if (channel != linearize_staged)
+    {
+        volatile const uint8_t *row = (volatile const uint8_t *)&linearize_tables[0][0] +
+                                      ((uint32_t)channel * sizeof(linearize_table_t)) - offset;
+        uint8_t *copy = (uint8_t *)linearize_row;
+        uint32_t i;
+
+        for (i = 0u; i < CY_FLASH_SIZEOF_ROW; i++)
+        {
+            copy[i] = row[i];
+        }
+        linearize_staged = channel;
+    }
+    return (linearize_table_t *)((uint8_t *)linearize_row + offset);
+}
+
+
+/*******************************************************************************
+* Function Name: Linearize_OnWrite
+********************************************************************************
+* Summary:
+* Handles a LUT_WRITE: stores breakpoints in the table being edited.
+*
+* Parameters:
+* payload: Command payload.
+* length: Payload length.
+*
+* Return:
+* None
+*******************************************************************************/
+void Linearize_OnWrite(const uint8_t *payload, uint8_t length)
+{
+    uint8_t first;
+    uint8_t count;
+    uint8_t i;
+    linearize_table_t *table;
+
+    if ((length < (LINEARIZE_WRITE_HEADER + 4u)) || (((length - LINEARIZE_WRITE_HEADER) % 4u) != 0u))
+    {
+        Linearize_Ack(payload, length, LINEARIZE_BAD_LENGTH);
+        return;
+    }
+    if ((payload[0] >= SENSOR_MODE_COUNT) || (payload[1] >= SENSOR_COUNT))
+    {
+        Linearize_Ack(payload, length, LINEARIZE_BAD_CHANNEL);
+        return;
+    }
+    first = payload[2];
+    count = (uint8_t)((length - LINEARIZE_WRITE_HEADER) / 4u);
+    if ((first >= LINEARIZE_POINTS) || (count > (LINEARIZE_POINTS - first)))
+    {
+        Linearize_Ack(payload, length, LINEARIZE_BAD_LENGTH);
+        return;
+    }
+
+    table = Linearize_Stage((uint8_t)((payload[0] * SENSOR_COUNT) + payload[1]));
+    for (i = 0u; i < count; i++)
+    {
+        const uint8_t *p = &payload[LINEARIZE_WRITE_HEADER + (4u * i)];
+
+        table->counts[first + i] = (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+        table->loads[first + i] = (uint16_t)(p[2] | ((uint16_t)p[3] << 8));
+    }
+    Linearize_Ack(payload, length, LINEARIZE_OK);
+}
+
+
+/*******************************************************************************
+* Function Name: Linearize_OnCommit
+********************************************************************************
+* Summary:
+* Handles a LUT_COMMIT: checks the table being edited, works out its slopes
+* and writes it to flash once the scan in progress has finished.
+*
+* Parameters:
+* payload: Command payload.
+* length: Payload length.
+*
+* Return:
+* None
+*******************************************************************************/
+void Linearize_OnCommit(const uint8_t *payload, uint8_t length)
+{
+    uint8_t channel;
+    uint8_t points;
+    uint8_t i;
+    uint32_t row;
+    linearize_table_t *table;
+
+    if ((length != LINEARIZE_COMMIT_SIZE) || (payload[2] > LINEARIZE_POINTS) || (payload[2] == 1u))
+    {
+        Linearize_Ack(payload, length, LINEARIZE_BAD_LENGTH);
+        return;
+    }
+    if ((payload[0] >= SENSOR_MODE_COUNT) || (payload[1] >= SENSOR_COUNT))
+    {
+        Linearize_Ack(payload, length, LINEARIZE_BAD_CHANNEL);
+        return;
+    }
+    channel = (uint8_t)((payload[0] * SENSOR_COUNT) + payload[1]);
+    points = payload[2];
+
+    // the breakpoints must have been written, unless the table is removed
+    if ((points != 0u) && (channel != linearize_staged))
+    {
+        Linearize_Ack(payload, length, LINEARIZE_BAD_LENGTH);
+        return;
+    }
+    table = Linearize_Stage(channel);
+
+    for (i = 0u; (i + 1u) < points; i++)
+    {
+        int32_t dx = (int32_t)table->counts[i + 1u] - (int32_t)table->counts[i];
+        int32_t dy = (int32_t)table->loads[i + 1u] - (int32_t)table->loads[i];
+
+        if ((dx <= 0) || (dy >= (dx << 15)) || (dy <= -(dx << 15)))
+        {
+            linearize_staged = LINEARIZE_NONE;
+            Linearize_Ack(payload, length, LINEARIZE_BAD_TABLE);
+            return;
+        }
+        // rounded; at most LINEARIZE_POINTS - 1 library 64-bit divides of a
+        // few hundred cycles each, next to the 20 ms row write that follows
+        table->slopes_q16[i] = (int32_t)((((int64_t)dy << LINEARIZE_SLOPE_Q) + ((dy < 0) ? -(dx / 2) : (dx / 2))) / dx);
+    }
+    table->points = points;
+
+    // the CPU stalls during the write: let the scan in progress complete
+    // first, so its result and the scan callback timing are not disturbed
+    while (CapSense_IsBusy() != CapSense_NOT_BUSY)
+    {
+    }
+    row = ((uint32_t)(uintptr_t)&linearize_tables[0][0] + ((uint32_t)channel * sizeof(linearize_table_t)) - CY_FLASH_BASE) /
+          CY_FLASH_SIZEOF_ROW;
+    linearize_staged = LINEARIZE_NONE;
+    Linearize_Ack(payload, length, (CySysFlashWriteRow(row, (const uint8 *)linearize_row) == CY_SYS_FLASH_SUCCESS) ?
+                                   LINEARIZE_OK : LINEARIZE_FLASH_ERROR);
+}
+
+#endif /* LINEARIZATION */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,84 @@
+/*******************************************************************************
+* File Name: linearize.h
+*
+* Description: Per-channel linearization of counts into load units.
+*
+*              The count of a taxel is far from proportional to the applied
+*              load. Each channel (sensor and mode) has a piecewise-linear
+*              table of up to LINEARIZE_POINTS breakpoints (count, load),
+*              ascending in count. A value is located in the table by binary
+*              search and interpolated on its segment; beyond the first and
+*              last breakpoints the end segments are extended. The segment
+*              slopes are worked out when the table is stored, so evaluating
+*              it takes a multiply and no divide. A channel without a table
+*              (fewer than two points) passes its counts through.
+*
+*              The stage runs on the processed values after crosstalk
+*              compensation and contact localization, which work on counts,
+*              and before the rate estimator, so the published values and
+*              rates are in load units. Calibrate against the same stages.
+*
+*              Tables live in flash, several to a flash row, and survive a
+*              reset. The host loads a channel with LUT_WRITE frames over the
+*              command channel and stores it with LUT_COMMIT; the board
+*              answers every command with a LUT_ACK:
+*                LUT_WRITE  host -> board  mode(u8) sensor(u8) first(u8)
+*                                          { count(u16) load(u16) } x 1..3
+*                           breakpoints first, first + 1, ... of the table
+*                           being edited; a write to another channel discards
+*                           the edits not committed
+*                LUT_COMMIT host -> board  mode(u8) sensor(u8) points(u8)
+*                           checks the first points breakpoints and writes
+*                           them to flash; points = 0 removes the table
+*                LUT_ACK    board -> host  mode(u8) sensor(u8) status(u8)
+*              The flash write stalls the CPU for about 20 ms and waits for
+*              the scan in progress, so load tables while the data is not
+*              needed. Host_Tools/lutload loads a table from a CSV file.
+*******************************************************************************/
+
+#ifndef LINEARIZE_H
+#define LINEARIZE_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Breakpoints per channel. The table takes 8 bytes per point and must fit a
+*  flash row an even number of times: 2, 4, 8 or 16. */
+#define LINEARIZE_POINTS        (8u)
+
+/* Slopes are load units per count, Q16 */
+#define LINEARIZE_SLOPE_Q       (16u)
+
+/* Breakpoints carried by one LUT_WRITE */
+#define LINEARIZE_WRITE_POINTS  (3u)
+#define LINEARIZE_WRITE_HEADER  (3u)
+#define LINEARIZE_COMMIT_SIZE   (3u)
+#define LINEARIZE_ACK_SIZE      (3u)
+
+/* LUT_ACK status */
+#define LINEARIZE_OK            (0u)
+#define LINEARIZE_BAD_CHANNEL   (1u)    /* mode or sensor out of range */
+#define LINEARIZE_BAD_LENGTH    (2u)    /* malformed command, or points beyond the table */
+#define LINEARIZE_BAD_TABLE     (3u)    /* counts not strictly ascending, or a
+                                           segment of 32768 units per count or more */
+#define LINEARIZE_FLASH_ERROR   (4u)    /* CySysFlashWriteRow failed */
+
+#if (LINEARIZE_POINTS != 2u) && (LINEARIZE_POINTS != 4u) && \
+    (LINEARIZE_POINTS != 8u) && (LINEARIZE_POINTS != 16u)
+#error "LINEARIZE_POINTS must be 2, 4, 8 or 16"
+#endif
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void Linearize_Apply(int32_t *values, uint8_t mode);
+void Linearize_OnWrite(const uint8_t *payload, uint8_t length);
+void Linearize_OnCommit(const uint8_t *payload, uint8_t length);
+
+#endif /* LINEARIZE_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,277 @@
+/*******************************************************************************
+* File Name: localize.c
+*
+* Description: Centroid, width and load of a contact on the top_plate array.
+*              See localize.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "localize.h"
+#include "baseline.h"
+#include "frame.h"
+
+#include <stdbool.h>
+
+#ifdef CONTACT_LOCALIZATION
+
+static localize_contact_t localize_contact;
+static uint8_t localize_peak = 0;   /* peak electrode of the last normal scan */
+
+
+/*******************************************************************************
+* Function Name: Localize_Signal
+********************************************************************************
+* Summary:
+* Converts one scan into signal above the baseline, clipped at zero.
+*
+* Parameters:
+* values: SENSOR_COUNT values of the scan.
+* mode: Mode of the scan.
+* signal: SENSOR_COUNT results.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Localize_Signal(const int32_t *values, uint8_t mode, int32_t *signal)
+{
+    uint8_t i;
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        int32_t s = values[i] - Baseline_Get(mode, i);
+        signal[i] = (s > 0) ? s : 0;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Localize_Centroid
+********************************************************************************
+* Summary:
+* Weighted average position of the peak electrode and its neighbours.
+*
+* Parameters:
+* signal: SENSOR_COUNT signal values.
+* peak: Centre electrode of the window.
+* sum: Receives the signal summed over the window.
+*
+* Return:
+* Position in electrode pitches (Q8), the peak itself if the window is empty.
+*******************************************************************************/
+static int32_t Localize_Centroid(const int32_t *signal, uint8_t peak, int32_t *sum)
+{
+    uint8_t first = (peak > 0u) ? (uint8_t)(peak - 1u) : 0u;
+    uint8_t last = (peak < (SENSOR_COUNT - 1u)) ? (uint8_t)(peak + 1u) : (uint8_t)(SENSOR_COUNT - 1u);
+    int32_t weighted = 0;
+    uint8_t i;
+
+    *sum = 0;
+    for (i = first; i <= last; i++)
+    {
+        weighted += (int32_t)i * signal[i];
+        *sum += signal[i];
+    }
+
+    if (*sum == 0)
+    {
+        return (int32_t)peak << 8;
+    }
+    return ((weighted << 8) + (*sum / 2)) / *sum;
+}
+
+
+/*******************************************************************************
+* Function Name: Localize_Width
+********************************************************************************
+* Summary:
+* Distance between the half-peak crossings on both sides of the peak, each
+* interpolated linearly between the electrodes around it. A contact that
+* reaches the end of the array is cut at the outer edge of the last
+* electrode.
+*
+* Parameters:
+* signal: SENSOR_COUNT signal values.
+* peak: Peak electrode.
+*
+* Return:
+* Width in electrode pitches (Q8).
+*******************************************************************************/
+static int32_t Localize_Width(const int32_t *signal, uint8_t peak)
+{
+    int32_t half = signal[peak] / 2;
+    int32_t left;
+    int32_t right;
+    uint8_t j;
+
+    j = peak;
+    while ((j > 0u) && (signal[j - 1u] >= half))
+    {
+        j--;
+    }
+    if (j == 0u)
+    {
+        left = -128;
+    }
+    else
+    {
+        // crossing between j - 1 (below half) and j (at or above)
+        left = ((int32_t)(j - 1u) << 8) +
+               (((half - signal[j - 1u]) << 8) / (signal[j] - signal[j - 1u]));
+    }
+
+    j = peak;
+    while ((j < (SENSOR_COUNT - 1u)) && (signal[j + 1u] >= half))
+    {
+        j++;
+    }
+    if (j == (SENSOR_COUNT - 1u))
+    {
+        right = ((int32_t)j << 8) + 128;
+    }
+    else
+    {
+        right = ((int32_t)(j + 1u) << 8) -
+                (((half - signal[j + 1u]) << 8) / (signal[j] - signal[j + 1u]));
+    }
+
+    return right - left;
+}
+
+
+/*******************************************************************************
+* Function Name: Localize_Saturate
+********************************************************************************
+* Summary:
+* Clamps a non-negative value to 16 bits.
+*
+* Parameters:
+* value: Value to clamp.
+*
+* Return:
+* Value, or 0xFFFF if it does not fit.
+*******************************************************************************/
+static uint16_t Localize_Saturate(int32_t value)
+{
+    return (value > 0xFFFF) ? 0xFFFFu : (uint16_t)value;
+}
+
+
+/*******************************************************************************
+* Function Name: Localize_Scan
+********************************************************************************
+* Summary:
+* Feeds one processed scan into the localization. A normal-mode scan updates
+* the contact; the following shear-mode scan adds the shear vector. The
+* baselines of the mode must already hold this scan.
+*
+* Parameters:
+* values: SENSOR_COUNT processed values of the scan.
+* mode: Mode of the scan.
+*
+* Return:
+* None
+*******************************************************************************/
+void Localize_Scan(const int32_t *values, uint8_t mode)
+{
+    int32_t signal[SENSOR_COUNT];
+    int32_t window_sum;
+    int32_t position;
+    uint8_t i;
+
+    Localize_Signal(values, mode, signal);
+
+    if (mode == SENSOR_MODE_NORMAL)
+    {
+        int32_t load = 0;
+        int32_t on_level;
+        uint8_t peak = 0;
+
+        for (i = 0; i < SENSOR_COUNT; i++)
+        {
+            if (signal[i] > signal[peak])
+            {
+                peak = i;
+            }
+            if (signal[i] >= LOCALIZE_NOISE_FLOOR)
+            {
+                load += signal[i];
+            }
+        }
+        localize_peak = peak;
+
+        // the shear scan that follows fills these in again
+        localize_contact.shear_offset_q8 = 0;
+        localize_contact.shear_load = 0u;
+
+        // hysteresis on the peak level
+        on_level = (localize_contact.flags & LOCALIZE_FLAG_CONTACT) ? LOCALIZE_CONTACT_OFF : LOCALIZE_CONTACT_ON;
+        localize_contact.flags = 0u;
+        if (signal[peak] < on_level)
+        {
+            localize_contact.position_q8 = 0u;
+            localize_contact.width_q8 = 0u;
+            localize_contact.load = 0u;
+            return;
+        }
+
+        localize_contact.flags = LOCALIZE_FLAG_CONTACT;
+        localize_contact.position_q8 = (uint16_t)Localize_Centroid(signal, peak, &window_sum);
+        localize_contact.width_q8 = Localize_Saturate(Localize_Width(signal, peak));
+        localize_contact.load = Localize_Saturate(load);
+    }
+    else if ((localize_contact.flags & LOCALIZE_FLAG_CONTACT) != 0u)
+    {
+        position = Localize_Centroid(signal, localize_peak, &window_sum);
+        localize_contact.shear_offset_q8 = (int16_t)(position - (int32_t)localize_contact.position_q8);
+        localize_contact.shear_load = Localize_Saturate(window_sum);
+        localize_contact.flags |= LOCALIZE_FLAG_SHEAR;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Localize_GetContact
+********************************************************************************
+* Summary:
+* Returns the contact of the latest cycle.
+*
+* Parameters:
+* None
+*
+* Return:
+* Pointer to the contact record.
+*******************************************************************************/
+const localize_contact_t *Localize_GetContact(void)
+{
+    return &localize_contact;
+}
+
+
+/*******************************************************************************
+* Function Name: Localize_Send
+********************************************************************************
+* Summary:
+* Sends the contact of the latest cycle as a FRAME_TYPE_CONTACT frame.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Localize_Send(void)
+{
+    Frame_Begin(FRAME_TYPE_CONTACT, LOCALIZE_PAYLOAD_SIZE);
+    Frame_PutByte(localize_contact.flags);
+    Frame_PutU16(localize_contact.position_q8);
+    Frame_PutU16(localize_contact.width_q8);
+    Frame_PutU16(localize_contact.load);
+    Frame_PutU16((uint16_t)localize_contact.shear_offset_q8);
+    Frame_PutU16(localize_contact.shear_load);
+    Frame_End();
+}
+
+#endif /* CONTACT_LOCALIZATION */
+
+
+/* [] END OF FILE */
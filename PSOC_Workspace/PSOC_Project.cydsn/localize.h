@@ -0,0 +1,65 @@
+/*******************************************************************************
+* File Name: localize.h
+*
+* Description: Contact localization along the top_plate electrode array.
+*
+*              From the normal-mode scan, relative to its baseline, the stage
+*              finds the peak electrode and reports:
+*                position  weighted average of the peak and its two
+*                          neighbours, in electrode pitches (Q8)
+*                width     distance between the interpolated half-peak
+*                          crossings on either side of the peak (Q8)
+*                load      sum of the signal over the whole array
+*              The shear-mode scan of the same cycle adds a shear vector
+*              along the array: how far its centroid, over the same window,
+*              sits from the normal-mode position, and its load.
+*
+*              Once per cycle the result is sent as a FRAME_TYPE_CONTACT frame
+*              in place of the CSV lines:
+*                flags(u8) position(u16) width(u16) load(u16)
+*                shear_offset(i16) shear_load(u16)
+*******************************************************************************/
+
+#ifndef LOCALIZE_H
+#define LOCALIZE_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Peak signal, in counts, that starts and ends a contact */
+#define LOCALIZE_CONTACT_ON     (60)
+#define LOCALIZE_CONTACT_OFF    (40)
+
+/* Signal below this, in counts, does not count towards the load */
+#define LOCALIZE_NOISE_FLOOR    (10)
+
+/* flags */
+#define LOCALIZE_FLAG_CONTACT   (0x01u)
+#define LOCALIZE_FLAG_SHEAR     (0x02u) /* shear fields are valid */
+
+#define LOCALIZE_PAYLOAD_SIZE   (11u)
+
+typedef struct
+{
+    uint8_t  flags;
+    uint16_t position_q8;       /* electrode pitches from sensor 0 */
+    uint16_t width_q8;          /* electrode pitches */
+    uint16_t load;              /* counts, saturated */
+    int16_t  shear_offset_q8;   /* electrode pitches, towards higher indices */
+    uint16_t shear_load;        /* counts, saturated */
+} localize_contact_t;
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void Localize_Scan(const int32_t *values, uint8_t mode);
+const localize_contact_t *Localize_GetContact(void);
+void Localize_Send(void);
+
+#endif /* LOCALIZE_H */
+
+
+/* [] END OF FILE */
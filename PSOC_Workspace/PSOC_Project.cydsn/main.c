@@ -6,7 +6,51 @@
 *******************************************************************************/
 #include "project.h"
 #include "globals.h"
-#include <stdio.h>
+#include "frame.h"
+#include "csv.h"
+#include "tx.h"
+#ifdef CAPTURE_MODE
+#include "capture.h"
+#endif
+#ifdef OVERSAMPLE_MODE
+#include "oversample.h"
+#endif
+#ifdef FREQHOP_MODE
+#include "freqhop.h"
+#endif
+#ifdef CSX_MODE
+#include "csx.h"
+#endif
+#if defined(CROSSTALK_COMPENSATION) || defined(CONTACT_LOCALIZATION) || defined(SLIP_DETECTION)
+#include "baseline.h"
+#endif
+#ifdef CROSSTALK_COMPENSATION
+#include "crosstalk.h"
+#endif
+#ifdef CONTACT_LOCALIZATION
+#include "localize.h"
+#endif
+#ifdef SELF_TEST
+#include "selftest.h"
+#endif
+#ifdef ADAPTIVE_FILTER
+#include "adaptive.h"
+#endif
+#ifdef RATE_ESTIMATOR
+#include "estimator.h"
+#endif
+#ifdef SLIP_DETECTION
+#include "slip.h"
+#endif
+#ifdef LINEARIZATION
+#include "linearize.h"
+#endif
+#ifdef COMMAND_CHANNEL
+#include "command.h"
+#endif
+#ifdef TIME_SYNC
+#include "timesync.h"
+#endif
 #include <string.h>
 #include <stdint.h>     // for fixed width types
 #include <stdbool.h>    // for bool
@@ -18,16 +62,12 @@
 #define LED_ON          (0u)
 #define LED_OFF         (1u)
 
-/* Define the size for the serial message buffer */
-#define TX_MESSAGE_SIZE  128
-
 /* Calibration Constants */
 #define CALIB_NUM_SAMPLES 50
 #define CALIB_DELAY_MS
 
-/* Moving Average filter configuration */
-#define AVG_NUM_SENSORS        8u     /* number of proximity sensors */
-#define AVG_FILTER_NUM_SAMPLES 10u    /* Number of samples to average. Adjust as needed. */
+/* Moving Average filter configuration: see AVG_FILTER_SHIFT in globals.h */
+#define AVG_NUM_SENSORS        SENSOR_COUNT /* number of proximity sensors */
 
 
 /*****************************************************************************
@@ -37,31 +77,57 @@ void UART_PutString(const char *s);
 void Post_Process(void);
 void CalibrateCapSense(uint32 widgetID);
 void DetectTouchAndDriveLed(void);
+void Send_Layout_Descriptor(void);
+static uint16_t Read_Sensor_Raw(uint8_t sensor);
 
 // global definitions
-uint16 raw_count; 
 volatile uint8_t mode_flag = 0; // positive = shear, zero = normal
 
+/* Raw, filtered and baseline state of every sensor in every mode */
+channel_state_t channel_state[SENSOR_MODE_COUNT][SENSOR_COUNT];
+
 #ifdef CALIBRATION_MODE
-volatile int32_t processed_data_array[8][4] = {0};
-volatile uint32_t current_count = 0;
+volatile uint32_t scan_ticks[SENSOR_COUNT] = {0};
 #endif
 
-#ifdef VISUALIZATION_MODE
-volatile int32_t processed_data_array[16] = {0};
+#ifdef RATE_ESTIMATOR
+volatile uint32_t scan_time[SENSOR_COUNT] = {0};
 #endif
-/* Moving Average filter internal state */
-static uint16_t avg_history_buffer[AVG_NUM_SENSORS][AVG_FILTER_NUM_SAMPLES];
-static uint32_t avg_current_sum[AVG_NUM_SENSORS] = { 0 };
-static uint8_t  avg_current_index[AVG_NUM_SENSORS] = { 0 };
-static bool     avg_initialized[AVG_NUM_SENSORS] = { false };
+
+
+/*******************************************************************************
+* Function Name: Read_Sensor_Raw()
+********************************************************************************
+* Summary:
+* Returns the raw count of a top_plate sensor for the mode in mode_flag, taken
+* from the last scan, the last oversampled cycle, the frequency median or the
+* mutual scan.
+*
+* Parameters:
+* sensor: top_plate sensor index.
+*
+* Return:
+* Raw count
+*******************************************************************************/
+static uint16_t Read_Sensor_Raw(uint8_t sensor)
+{
+    #if defined(OVERSAMPLE_MODE)
+    return Oversample_GetRaw(mode_flag, sensor);
+    #elif defined(FREQHOP_MODE)
+    return FreqHop_GetRaw(sensor);
+    #elif defined(CSX_MODE)
+    return Csx_GetRaw(mode_flag, sensor);
+    #else
+    return CapSense_dsRam.snsList.top_plate[sensor].raw[0];
+    #endif
+}
 
 
 /*******************************************************************************
 * Function Name: Post_Process()
 ********************************************************************************
 * Summary:
-* Changes the processed_data_array depending on the mode
+* Updates the channel_state of every sensor for the mode in mode_flag
 *
 * Parameters:
 *
@@ -71,75 +137,104 @@ static bool     avg_initialized[AVG_NUM_SENSORS] = { false };
 
 /**
  * @brief Processes CapSense raw counts and applies an N-sample moving
- * average filter per sensor.
+ * average filter per channel (sensor and mode).
  *
- * Writes filtered output to processed_data_array[i][0] and raw count to
- * processed_data_array[i][3].
+ * Stores the raw count and the filtered output (CALIBRATION_MODE) or raw
+ * count (VISUALIZATION_MODE) in channel_state, after the optional self-test
+ * masking and crosstalk compensation.
  */
 void Post_Process(void)
 {
     uint8_t i;
+    uint8_t mode = mode_flag;
+    int32_t scan_values[SENSOR_COUNT];  /* this scan, before the output stages */
     
-    #ifdef CALIBRATION_MODE
     for (i = 0; i < AVG_NUM_SENSORS; i++)
     {
+        channel_state_t *ch = &channel_state[mode][i];
+
         /* Read raw sensor value — adjust path if your CapSense RAM layout differs */
-        uint16_t sensor_raw = CapSense_dsRam.snsList.top_plate[i].raw[0];
-        
-        /* Store raw in column 3 (as original code used) */
-        processed_data_array[i][3] = (int32_t)sensor_raw;
+        uint16_t sensor_raw = Read_Sensor_Raw(i);
+        ch->raw = sensor_raw;
 
-        /* Initialize filter state on first sample for this sensor */
-        if (!avg_initialized[i])
+        #if defined(CALIBRATION_MODE) && defined(ADAPTIVE_FILTER)
+        scan_values[i] = Adaptive_Update(ch, sensor_raw);
+        #elif defined(CALIBRATION_MODE)
+        /* Initialize filter state on first sample for this channel */
+        if (!(ch->flags & CHANNEL_FLAG_FILTER_INIT))
         {
             // Pre-fill the history buffer with the first sample
             for(uint8_t j = 0; j < AVG_FILTER_NUM_SAMPLES; j++)
             {
-                avg_history_buffer[i][j] = sensor_raw;
+                ch->avg_history[j] = sensor_raw;
             }
             // Set the initial sum
-            avg_current_sum[i] = (uint32_t)sensor_raw * AVG_FILTER_NUM_SAMPLES;
-            avg_current_index[i] = 0;
-            avg_initialized[i] = true;
+            ch->avg_sum = (uint32_t)sensor_raw << AVG_FILTER_SHIFT;
+            ch->avg_index = 0;
+            ch->flags |= CHANNEL_FLAG_FILTER_INIT;
         }
         else
         {
             /* Implement the efficient moving average (running sum) */
             
             // 1. Subtract the oldest sample (which is at the current index)
-            avg_current_sum[i] -= avg_history_buffer[i][avg_current_index[i]];
+            ch->avg_sum -= ch->avg_history[ch->avg_index];
             
             // 2. Add the new sample
-            avg_current_sum[i] += sensor_raw;
+            ch->avg_sum += sensor_raw;
             
             // 3. Replace the oldest sample with the new one
-            avg_history_buffer[i][avg_current_index[i]] = sensor_raw;
+            ch->avg_history[ch->avg_index] = sensor_raw;
             
             // 4. Increment and wrap the circular buffer index
-            avg_current_index[i]++;
-            if (avg_current_index[i] >= AVG_FILTER_NUM_SAMPLES)
-            {
-                avg_current_index[i] = 0;
-            }
+            ch->avg_index = (uint8_t)((ch->avg_index + 1u) & (AVG_FILTER_NUM_SAMPLES - 1u));
         }
 
-        /* Store filtered value into processed_data_array[i][0] */
         /* Calculate average, adding (N/2) for proper integer rounding */
-        uint32_t rounded_avg = (avg_current_sum[i] + (AVG_FILTER_NUM_SAMPLES / 2)) / AVG_FILTER_NUM_SAMPLES;
-        processed_data_array[i][3] = (int32_t)rounded_avg;
-        
-        /* processed_data_array[i][1] and processed_data_array[i][2] are left unchanged */
+        scan_values[i] = (int32_t)((ch->avg_sum + (AVG_FILTER_NUM_SAMPLES / 2u)) >> AVG_FILTER_SHIFT);
+        #else
+        scan_values[i] = sensor_raw;
+        #endif
     }
+
+    #ifdef SELF_TEST
+    // range check, and faulty channels hold their last good value
+    SelfTest_ProcessScan(scan_values, mode);
     #endif
-    
-    #ifdef VISUALIZATION_MODE
-    //insert averaging shit here
-    uint8_t mode_offset = 8*mode_flag;
-    for(i = 0; i<8; i++)
+
+    #if defined(CROSSTALK_COMPENSATION) || defined(CONTACT_LOCALIZATION) || defined(SLIP_DETECTION)
+    Baseline_Update(scan_values, mode);
+    #endif
+
+    #ifdef CROSSTALK_COMPENSATION
+    Crosstalk_Apply(scan_values, mode);
+    #endif
+
+    #ifdef CONTACT_LOCALIZATION
+    Localize_Scan(scan_values, mode);
+    #endif
+
+    #ifdef SLIP_DETECTION
+    // alerts go out ahead of the data already queued
+    Slip_Scan(scan_values, mode);
+    #endif
+
+    #ifdef LINEARIZATION
+    // counts to load units, for the output and the estimator
+    Linearize_Apply(scan_values, mode);
+    #endif
+
+    #ifdef RATE_ESTIMATOR
+    // smoothing and rate, at the scan instant
+    Estimator_Update(scan_values, mode);
+    #endif
+
+    for (i = 0; i < SENSOR_COUNT; i++)
     {
-        processed_data_array[i+mode_offset] = CapSense_dsRam.snsList.top_plate[i].raw[0];
+        // counts are unsigned; compensation may overshoot slightly
+        int32_t v = scan_values[i];
+        channel_state[mode][i].value = (v < 0) ? 0u : ((v > 0xFFFF) ? 0xFFFFu : (uint16_t)v);
     }
-    #endif
 }
 
 
@@ -181,9 +276,6 @@ void UART_PutString(const char *s)
 *******************************************************************************/
 void DetectTouchAndDriveLed(void)
 {
-    // Reduce buffer size to just the raw number and necessary characters
-    char txMessage[TX_MESSAGE_SIZE]; 
-    
     // calculates the time that passed between publishing
 
     //if(delta < 0){delta = delta + My_Time_TC_PERIOD_VALUE;}
@@ -193,50 +285,84 @@ void DetectTouchAndDriveLed(void)
     // prints each value in the processed array with the corresponding electrode
         // Format the string with the mode, electrode index, and processed count
     
-        #ifdef CALIBRATION_MODE
-        for( int i = 0; i<8; i++)
+        #if defined(CONTACT_LOCALIZATION)
+        // a few bytes per cycle instead of the CSV lines
+        if(mode_flag == SENSOR_MODE_LAST)
         {
-            // creates message: filtered, raw, unused, raw (we keep original 4 columns)
-            sprintf(txMessage, "\n%d,%d,%d,%d\r",
-            processed_data_array[i][0], /* filtered */
-            processed_data_array[i][1],
-            processed_data_array[i][2],
-            processed_data_array[i][3]); /* raw */
-            UART_PutString(txMessage);
+            #ifdef TIME_SYNC
+            TimeSync_SendStamp();
+            #endif
+            Localize_Send();
+        }
+        #elif defined(CALIBRATION_MODE)
+        #ifdef TIME_SYNC
+        // one stamp for the rows of this scan
+        TimeSync_SendStamp();
+        #endif
+        for( uint8_t i = 0; i<SENSOR_COUNT; i++)
+        {
+            int32_t row[CALIB_NUM_COLUMNS];
+
+            // creates message: time, mode, sensor, filtered (we keep original 4 columns,
+            // plus the window with ADAPTIVE_FILTER or the rate with RATE_ESTIMATOR)
+            row[CALIB_COL_TIME] = (int32_t)scan_ticks[i];
+            row[CALIB_COL_MODE] = mode_flag;
+            row[CALIB_COL_SENSOR] = i;
+            #ifdef RATE_ESTIMATOR
+            row[CALIB_COL_VALUE] = Estimator_Predict(mode_flag, i);
+            row[CALIB_COL_RATE] = Estimator_GetRate(mode_flag, i);
+            #else
+            row[CALIB_COL_VALUE] = channel_state[mode_flag][i].value;
+            #endif
+            #ifdef ADAPTIVE_FILTER
+            row[CALIB_COL_WINDOW] = 1 << channel_state[mode_flag][i].window_shift;
+            #endif
+
+            // "\n%d,%d,%d,%d\r", written straight into the UART buffer
+            Csv_PutLine(row, CALIB_NUM_COLUMNS);
             
         }
         // small delay to slow datarate
-        if(mode_flag == 1)
+        if(mode_flag == SENSOR_MODE_LAST)
         {
             //CyDelay(100);
             
         }
         #endif
         
-        #ifdef VISUALIZATION_MODE
+        #if defined(VISUALIZATION_MODE) && !defined(CONTACT_LOCALIZATION)
             
         // small delay to slow datarate
-        if(mode_flag == 1)
+        if(mode_flag == SENSOR_MODE_LAST)
         {
-            sprintf(txMessage, "\n%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\r", 
-                processed_data_array[0],
-                processed_data_array[1],
-                processed_data_array[2],
-                processed_data_array[3],
-                processed_data_array[4],
-                processed_data_array[5],
-                processed_data_array[6],
-                processed_data_array[7],
-                processed_data_array[8],
-                processed_data_array[9],
-                processed_data_array[10],
-                processed_data_array[11],
-                processed_data_array[12],
-                processed_data_array[13],
-                processed_data_array[14],
-                processed_data_array[15]
-            );
-            UART_PutString(txMessage);
+            #ifdef TIME_SYNC
+            TimeSync_SendStamp();
+            #endif
+
+            // one line with every sensor of every mode: "\n%d,%d,...,%d\r",
+            // followed by the rates with RATE_ESTIMATOR
+            Csv_BeginLine();
+            for (uint8_t m = 0; m < SENSOR_MODE_COUNT; m++)
+            {
+                for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+                {
+                    #ifdef RATE_ESTIMATOR
+                    Csv_PutValue(Estimator_Predict(m, i));
+                    #else
+                    Csv_PutValue(channel_state[m][i].value);
+                    #endif
+                }
+            }
+            #ifdef RATE_ESTIMATOR
+            for (uint8_t m = 0; m < SENSOR_MODE_COUNT; m++)
+            {
+                for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+                {
+                    Csv_PutValue(Estimator_GetRate(m, i));
+                }
+            }
+            #endif
+            Csv_EndLine();
             //CyDelay(1000);
         }
         // Send the fully formatted string over the UART       
@@ -245,6 +371,28 @@ void DetectTouchAndDriveLed(void)
      
 }
 
+/*******************************************************************************
+* Function Name: Send_Layout_Descriptor
+********************************************************************************
+* Summary:
+* Sends the FRAME_TYPE_LAYOUT frame describing the sensor count, modes and CSV
+* line layout of this build, so host decoders can configure themselves.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Send_Layout_Descriptor(void)
+{
+    static const uint8_t layout[SENSOR_LAYOUT_SIZE] = SENSOR_LAYOUT_DESCRIPTOR;
+    
+    Frame_Begin(FRAME_TYPE_LAYOUT, SENSOR_LAYOUT_SIZE);
+    Frame_PutBytes(layout, SENSOR_LAYOUT_SIZE);
+    Frame_End();
+}
+
 /*******************************************************************************
 * Function Name: main()
 ********************************************************************************
@@ -266,16 +414,47 @@ int main(void)
     /* Send a start message to confirm the link */
     UART_PutString("--- PSoC CapSense Logger Initialized ---\r\n");
     
+    /* Tell the host how the following data is laid out */
+    Send_Layout_Descriptor();
+    
     /* Start the CapSense block */
     CapSense_Start();
     
+    #ifdef CROSSTALK_COMPENSATION
+    // checks the stored matrix; without one the stage passes through
+    Crosstalk_Init();
+    #endif
+    
+    #ifdef CAPTURE_MODE
+    // start recording into the capture ring, waiting for the trigger
+    Capture_Arm();
+    #endif
+    
     /* Calibrate CapSense block */
     //CalibrateCapSense(CapSense_PROXIMITY0_WDGT_ID);
 
     
     //CapSense_CalibrateAllWidgets();
+    
+    #ifdef OVERSAMPLE_MODE
+    // shortens the sub-scans and selects the bottom plate mode of the first
+    Oversample_Init();
+    Oversample_Start();
+    #endif
+    
+    #ifdef FREQHOP_MODE
+    // selects the sense clock of the first scan
+    FreqHop_Start();
+    #endif
+    
     /* Initiate the first scan of all enabled widgets */
+    #ifdef CSX_MODE
+    Csx_Scan();
+    #elif defined(OVERSAMPLE_MODE)
+    Oversample_Scan();
+    #else
     CapSense_ScanAllWidgets();
+    #endif
 
     for (;;)
     {
@@ -285,19 +464,122 @@ int main(void)
             /* Process the raw sensor data (filtering, baseline, detection) */
             CapSense_ProcessAllWidgets();
             
+            #if defined(CAPTURE_MODE)
+            // record the raw scan; the UART only carries the capture dump
+            Capture_RecordScan();
+            #elif defined(OVERSAMPLE_MODE)
+            // publish both modes once every sub-scan of the cycle is in
+            if (Oversample_Accumulate())
+            {
+                for (uint8_t mode = 0; mode < SENSOR_MODE_COUNT; mode++)
+                {
+                    mode_flag = mode;
+                    Post_Process();
+                    DetectTouchAndDriveLed();
+                }
+                #ifdef SELF_TEST
+                SelfTest_Service();
+                #endif
+                Oversample_Start();
+            }
+            #elif defined(FREQHOP_MODE)
+            // publish once the mode has been scanned at every active frequency
+            if (FreqHop_Accumulate())
+            {
+                Post_Process();
+                DetectTouchAndDriveLed();
+                
+                // toggles the mode we are in after succesfully writing
+                mode_flag = (mode_flag + 1u) % SENSOR_MODE_COUNT;
+                
+                #ifdef SELF_TEST
+                if (mode_flag == SENSOR_MODE_NORMAL)
+                {
+                    SelfTest_Service();
+                }
+                #endif
+                FreqHop_Start();
+            }
+            #elif defined(CSX_MODE)
+            if (Csx_ScanComplete())
+            {
+                // one mutual scan holds every mode
+                for (uint8_t mode = 0; mode < SENSOR_MODE_COUNT; mode++)
+                {
+                    mode_flag = mode;
+                    Post_Process();
+                    DetectTouchAndDriveLed();
+                    
+                    #ifdef CALIBRATION_MODE
+                    // the rows of the other modes come from the same scan
+                    for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+                    {
+                        scan_ticks[i] = 0u;
+                    }
+                    #endif
+                }
+                mode_flag = SENSOR_MODE_NORMAL;
+            }
+            else
+            {
+                Post_Process();
+                DetectTouchAndDriveLed();
+                
+                // toggles the mode we are in after succesfully writing
+                mode_flag = (mode_flag + 1u) % SENSOR_MODE_COUNT;
+            }
+            
+            #ifdef SELF_TEST
+            if (mode_flag == SENSOR_MODE_NORMAL)
+            {
+                SelfTest_Service();
+            }
+            #endif
+            #else
             // Post process the sensor data. currently commented out so that each sensor reading is handled seperately
             Post_Process(); 
             
             /* Handle LED control and send the debug message over UART */
             DetectTouchAndDriveLed();
+            #endif
 
+            #if !defined(OVERSAMPLE_MODE) && !defined(FREQHOP_MODE) && !defined(CSX_MODE)
             // toggles the mode we are in after succesfully writing
-            if( mode_flag == 1){mode_flag = 0;}
-            else               {mode_flag = 1;}
+            mode_flag = (mode_flag + 1u) % SENSOR_MODE_COUNT;
+            
+            #ifdef SELF_TEST
+            // the CapSense block is idle between cycles: run the background checks
+            if (mode_flag == SENSOR_MODE_NORMAL)
+            {
+                SelfTest_Service();
+            }
+            #endif
+            #endif
             
             /* Start the next scan of all enabled widgets */
+            #ifdef CSX_MODE
+            Csx_Scan();
+            #elif defined(OVERSAMPLE_MODE)
+            Oversample_Scan();
+            #else
             CapSense_ScanAllWidgets();
+            #endif
         }
+        
+        #ifdef CAPTURE_MODE
+        // feed the capture dump to the UART while the next scan runs
+        Capture_Service();
+        #endif
+        
+        #ifdef COMMAND_CHANNEL
+        // host commands; polled every pass so sync pings are timed closely
+        Command_Poll();
+        #endif
+        
+        #ifdef TX_PRIORITY_QUEUE
+        // keep the UART FIFO filled from the transmit queues
+        Tx_Service();
+        #endif
     }
 }
 
@@ -0,0 +1,161 @@
+/*******************************************************************************
+* File Name: oversample.c
+*
+* Description: Sub-scan sequencing and accumulation for the oversampled,
+*              chopped acquisition mode. See oversample.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "globals.h"
+#include "oversample.h"
+
+#ifdef OVERSAMPLE_MODE
+
+/* Bottom-plate mode of each sub-scan within one A-B-B-A group */
+static const uint8_t oversample_chop_pattern[4] = { 0u, 1u, 1u, 0u };
+
+/* Running sums of the current cycle, per mode and sensor */
+static uint32_t oversample_sum[2][OVERSAMPLE_NUM_SENSORS];
+
+/* Averages of the last completed cycle */
+static uint16_t oversample_result[2][OVERSAMPLE_NUM_SENSORS];
+
+/* Index of the sub-scan currently running */
+static uint8_t oversample_phase = 0;
+
+
+/*******************************************************************************
+* Function Name: Oversample_Init
+********************************************************************************
+* Summary:
+* Lowers the top_plate resolution to OVERSAMPLE_SUBSCAN_RESOLUTION. Call once,
+* after CapSense_Start().
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Oversample_Init(void)
+{
+    CapSense_dsRam.wdgtList.top_plate.resolution = OVERSAMPLE_SUBSCAN_RESOLUTION;
+
+    #if (CapSense_ENABLE == CapSense_TST_WDGT_CRC_EN)
+    // keep the self-test widget CRC in step with the changed parameter
+    CapSense_DsUpdateWidgetCrc(CapSense_TOP_PLATE_WDGT_ID);
+    #endif
+}
+
+
+/*******************************************************************************
+* Function Name: Oversample_Start
+********************************************************************************
+* Summary:
+* Clears the accumulators and sets mode_flag for the first sub-scan. Call
+* before Oversample_Scan() starts a new cycle.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Oversample_Start(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < OVERSAMPLE_NUM_SENSORS; i++)
+    {
+        oversample_sum[0][i] = 0;
+        oversample_sum[1][i] = 0;
+    }
+    oversample_phase = 0;
+    mode_flag = oversample_chop_pattern[0];
+}
+
+
+/*******************************************************************************
+* Function Name: Oversample_Scan
+********************************************************************************
+* Summary:
+* Starts the next sub-scan. Only the top_plate widget is converted; the
+* bottom_plate widget just lends its pins to the scan callback. Replaces
+* CapSense_ScanAllWidgets() in the main loop.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Oversample_Scan(void)
+{
+    CapSense_SetupWidget(CapSense_TOP_PLATE_WDGT_ID);
+    CapSense_Scan();
+}
+
+
+/*******************************************************************************
+* Function Name: Oversample_Accumulate
+********************************************************************************
+* Summary:
+* Adds the sub-scan that just completed to the sums of its mode and sets
+* mode_flag for the next sub-scan. When the last sub-scan of the cycle has
+* been added, the averages become available through Oversample_GetRaw().
+*
+* Parameters:
+* None
+*
+* Return:
+* true when the cycle is complete, false otherwise.
+*******************************************************************************/
+bool Oversample_Accumulate(void)
+{
+    uint8_t i;
+    uint32_t *sum = oversample_sum[mode_flag ? 1u : 0u];
+
+    for (i = 0; i < OVERSAMPLE_NUM_SENSORS; i++)
+    {
+        sum[i] += CapSense_dsRam.snsList.top_plate[i].raw[0];
+    }
+
+    oversample_phase++;
+    if (oversample_phase < OVERSAMPLE_SUBSCANS)
+    {
+        mode_flag = oversample_chop_pattern[oversample_phase & 3u];
+        return false;
+    }
+
+    // cycle complete: the sum of the short sub-scans, on the full-resolution scale
+    for (i = 0; i < OVERSAMPLE_NUM_SENSORS; i++)
+    {
+        oversample_result[0][i] = (uint16_t)(oversample_sum[0][i] << OVERSAMPLE_SCALE_SHIFT);
+        oversample_result[1][i] = (uint16_t)(oversample_sum[1][i] << OVERSAMPLE_SCALE_SHIFT);
+    }
+    return true;
+}
+
+
+/*******************************************************************************
+* Function Name: Oversample_GetRaw
+********************************************************************************
+* Summary:
+* Returns the averaged raw count of one sensor from the last completed cycle.
+*
+* Parameters:
+* mode: 0 = normal, non-zero = shear.
+* sensor: top_plate sensor index.
+*
+* Return:
+* Averaged raw count.
+*******************************************************************************/
+uint16_t Oversample_GetRaw(uint8_t mode, uint8_t sensor)
+{
+    return oversample_result[mode ? 1u : 0u][sensor];
+}
+
+#endif /* OVERSAMPLE_MODE */
+
+
+/* [] END OF FILE */
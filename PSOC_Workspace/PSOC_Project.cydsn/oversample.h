@@ -0,0 +1,100 @@
+/*******************************************************************************
+* File Name: oversample.h
+*
+* Description: Oversampled, chopped acquisition of the normal and shear modes.
+*
+*              Each scan cycle is built from several short sub-scans. The
+*              bottom-plate configuration (normal / shear) is chopped in an
+*              A-B-B-A order, so both modes sample the same mean instant and
+*              a linear drift between sub-scans cancels out of the
+*              normal-shear pair. The results go into a running sum per mode.
+*
+*              Sub-scans are short: only the top_plate widget is scanned (the
+*              bottom_plate pins are set by the scan callback, as in the
+*              normal acquisition), at OVERSAMPLE_SUBSCAN_RESOLUTION bits
+*              instead of the customizer's OVERSAMPLE_FULL_RESOLUTION. A
+*              conversion takes 2^resolution sense clock periods, so with the
+*              defaults a cycle takes as long as one full-resolution scan and
+*              gives each mode 8 * 2^12 = 2^15 sense periods, half of one
+*              full-resolution scan. The sums are scaled back to the
+*              full-resolution range, so thresholds and tables still apply.
+*              The widget must use manual tuning so that CapSense_Start()
+*              keeps the resolution set here.
+*
+*              Oversampling alone does not improve the noise: the sense
+*              periods per mode and per unit of time are those of the normal
+*              two-scan acquisition. The CALIBRATION_MODE boxcar therefore
+*              keeps running over the cycle results, 2^AVG_FILTER_SHIFT
+*              cycles deep, so that an output integrates at least the
+*              2^(OVERSAMPLE_BOXCAR_SHIFT + OVERSAMPLE_FULL_RESOLUTION) sense
+*              periods of the 8-scan boxcar in the same time. By that
+*              budget the white-noise SNR equals the boxcar's; it has not been
+*              measured on hardware. What the chopping adds is that drift
+*              during a cycle cancels between the modes. With RATE_ESTIMATOR
+*              the estimator does the smoothing instead of the boxcar.
+*
+*              Not implemented: alternating the drive polarity of the sensor
+*              and demodulating the sub-scans synchronously. The CSD block
+*              always charges the sensor the same way and the component
+*              gives no firmware control over it, so offsets that follow the
+*              drive, such as the modulator's own, are not removed; only the
+*              bottom-plate configuration is chopped.
+*******************************************************************************/
+
+#ifndef OVERSAMPLE_H
+#define OVERSAMPLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+#define OVERSAMPLE_NUM_SENSORS      SENSOR_COUNT
+
+#if defined(OVERSAMPLE_MODE) && (SENSOR_MODE_COUNT != 2u)
+#error "OVERSAMPLE_MODE chops between the normal and shear modes and needs both"
+#endif
+
+/* A-B-B-A groups per cycle. Must be a power of two. */
+#define OVERSAMPLE_CHOP_CYCLES      (4u)
+#define OVERSAMPLE_CHOP_SHIFT       (2u)    /* log2(OVERSAMPLE_CHOP_CYCLES) */
+
+#define OVERSAMPLE_SUBSCANS         (4u * OVERSAMPLE_CHOP_CYCLES)
+#define OVERSAMPLE_PER_MODE         (2u * OVERSAMPLE_CHOP_CYCLES)
+#define OVERSAMPLE_PER_MODE_SHIFT   (OVERSAMPLE_CHOP_SHIFT + 1u)
+
+/* top_plate resolution in bits: as set in the customizer, and of a sub-scan */
+#define OVERSAMPLE_FULL_RESOLUTION      (16u)
+#define OVERSAMPLE_SUBSCAN_RESOLUTION   (12u)
+
+/* Left shift that turns the per-mode sum of sub-scans into a full-resolution
+*  count */
+#define OVERSAMPLE_SCALE_SHIFT      (OVERSAMPLE_FULL_RESOLUTION - OVERSAMPLE_SUBSCAN_RESOLUTION - OVERSAMPLE_PER_MODE_SHIFT)
+
+/* log2 of the scans in the boxcar of the normal acquisition, whose sense
+*  periods the oversampled boxcar must reach */
+#define OVERSAMPLE_BOXCAR_SHIFT     (3u)
+
+#if defined(OVERSAMPLE_MODE) && !defined(RATE_ESTIMATOR) && \
+    ((AVG_FILTER_SHIFT + OVERSAMPLE_PER_MODE_SHIFT + OVERSAMPLE_SUBSCAN_RESOLUTION) < (OVERSAMPLE_BOXCAR_SHIFT + OVERSAMPLE_FULL_RESOLUTION))
+#error "The AVG_FILTER_SHIFT boxcar over the oversampled cycles integrates fewer sense periods than the normal boxcar"
+#endif
+#if ((OVERSAMPLE_SUBSCAN_RESOLUTION + OVERSAMPLE_PER_MODE_SHIFT) > OVERSAMPLE_FULL_RESOLUTION)
+#error "The sub-scans of a mode add up to more than the full-resolution range: lower OVERSAMPLE_SUBSCAN_RESOLUTION or OVERSAMPLE_CHOP_CYCLES"
+#endif
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void     Oversample_Init(void);
+void     Oversample_Start(void);
+void     Oversample_Scan(void);
+bool     Oversample_Accumulate(void);
+uint16_t Oversample_GetRaw(uint8_t mode, uint8_t sensor);
+
+#endif /* OVERSAMPLE_H */
+
+
+/* [] END OF FILE */
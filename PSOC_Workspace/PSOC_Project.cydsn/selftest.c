@@ -0,0 +1,288 @@
+/*******************************************************************************
+* File Name: selftest.c
+*
+* Description: Background open / short / Cmod / raw-range checks of the
+*              top_plate electrodes. See selftest.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "selftest.h"
+#include "frame.h"
+
+#include <stdbool.h>
+
+#ifdef SELF_TEST
+
+#if (CapSense_SELF_TEST_EN != CapSense_ENABLE)
+#error "SELF_TEST needs the Self-test library enabled in the CapSense customizer"
+#endif
+
+/* Hardware test steps: short per sensor, capacitance per sensor, Cmod */
+#define SELFTEST_STEP_SHORT     (0u)
+#define SELFTEST_STEP_CP        (SENSOR_COUNT)
+#define SELFTEST_STEP_CMOD      (2u * SENSOR_COUNT)
+#define SELFTEST_NUM_STEPS      (SELFTEST_STEP_CMOD + 1u)
+
+/* fault bitmaps, bit n = top_plate sensor n */
+static uint32_t selftest_open = 0;
+static uint32_t selftest_short = 0;
+static uint32_t selftest_range[SENSOR_MODE_COUNT];    /* per mode */
+static bool     selftest_cmod_fault = false;
+static uint16_t selftest_cmod_pf = 0;
+
+/* consecutive scans against the current range state, per mode and sensor */
+static uint8_t  selftest_range_count[SENSOR_MODE_COUNT][SENSOR_COUNT];
+
+static uint16_t selftest_cycle = 0;
+static uint8_t  selftest_step = 0;
+static uint16_t selftest_report_cycle = 0;
+static uint32_t selftest_reported = 0;
+static bool     selftest_cmod_reported = false;
+static bool     selftest_sent = false;
+
+
+/*******************************************************************************
+* Function Name: SelfTest_SetBit
+********************************************************************************
+* Summary:
+* Sets or clears one sensor's bit in a fault bitmap.
+*
+* Parameters:
+* bitmap: Bitmap to change.
+* sensor: top_plate sensor index.
+* fault: true to set the bit.
+*
+* Return:
+* None
+*******************************************************************************/
+static void SelfTest_SetBit(uint32_t *bitmap, uint8_t sensor, bool fault)
+{
+    if (fault)
+    {
+        *bitmap |= (1uL << sensor);
+    }
+    else
+    {
+        *bitmap &= ~(1uL << sensor);
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: SelfTest_RangeMask
+********************************************************************************
+* Summary:
+* Returns the sensors out of range in any mode. A fault may show in one mode
+* only (e.g. an open on one bottom_plate pin affects the shear scan alone),
+* so each mode keeps its own state and counters.
+*
+* Parameters:
+* None
+*
+* Return:
+* Bitmap, bit n = top_plate sensor n.
+*******************************************************************************/
+static uint32_t SelfTest_RangeMask(void)
+{
+    uint32_t mask = 0;
+    uint8_t mode;
+
+    for (mode = 0; mode < SENSOR_MODE_COUNT; mode++)
+    {
+        mask |= selftest_range[mode];
+    }
+    return mask;
+}
+
+
+/*******************************************************************************
+* Function Name: SelfTest_RunStep
+********************************************************************************
+* Summary:
+* Runs the next hardware test step. The CapSense block must be idle.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+static void SelfTest_RunStep(void)
+{
+    uint8_t step = selftest_step;
+
+    if (step < SELFTEST_STEP_CP)
+    {
+        uint8_t sensor = (uint8_t)(step - SELFTEST_STEP_SHORT);
+        bool fault = (CapSense_CheckSensorShort(CapSense_TOP_PLATE_WDGT_ID, sensor) != CapSense_TST_SUCCESS) ||
+                     (CapSense_CheckSns2SnsShort(CapSense_TOP_PLATE_WDGT_ID, sensor) != CapSense_TST_SUCCESS);
+
+        SelfTest_SetBit(&selftest_short, sensor, fault);
+    }
+    else if (step < SELFTEST_STEP_CMOD)
+    {
+        uint8_t sensor = (uint8_t)(step - SELFTEST_STEP_CP);
+        uint32 cp = CapSense_GetSensorCapacitance(CapSense_TOP_PLATE_WDGT_ID, sensor);
+
+        SelfTest_SetBit(&selftest_open, sensor, (cp < SELFTEST_CP_MIN_FF) || (cp > SELFTEST_CP_MAX_FF));
+    }
+    else
+    {
+        uint32 cmod = CapSense_GetExtCapCapacitance(CapSense_TST_CMOD_ID);
+
+        selftest_cmod_pf = (cmod > 0xFFFFu) ? 0xFFFFu : (uint16_t)cmod;
+        selftest_cmod_fault = (cmod < SELFTEST_CMOD_MIN_PF) || (cmod > SELFTEST_CMOD_MAX_PF);
+    }
+
+    selftest_step++;
+    if (selftest_step >= SELFTEST_NUM_STEPS)
+    {
+        selftest_step = 0;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: SelfTest_Report
+********************************************************************************
+* Summary:
+* Sends the fault bitmaps as a FRAME_TYPE_FAULTS frame.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+static void SelfTest_Report(void)
+{
+    Frame_Begin(FRAME_TYPE_FAULTS, SELFTEST_PAYLOAD_SIZE);
+    Frame_PutU32(SelfTest_GetFaultMask());
+    Frame_PutU32(selftest_open);
+    Frame_PutU32(selftest_short);
+    Frame_PutU32(SelfTest_RangeMask());
+    Frame_PutByte(selftest_cmod_fault ? 1u : 0u);
+    Frame_PutU16(selftest_cmod_pf);
+    Frame_End();
+
+    selftest_reported = SelfTest_GetFaultMask();
+    selftest_cmod_reported = selftest_cmod_fault;
+    selftest_report_cycle = 0;
+    selftest_sent = true;
+}
+
+
+/*******************************************************************************
+* Function Name: SelfTest_ProcessScan
+********************************************************************************
+* Summary:
+* Checks the raw counts of the scan that just completed against the range
+* window and replaces the values of faulty channels by their last good value
+* (the value still stored in channel_state).
+*
+* Parameters:
+* values: SENSOR_COUNT processed values of the scan, updated in place.
+* mode: Mode of the scan.
+*
+* Return:
+* None
+*******************************************************************************/
+void SelfTest_ProcessScan(int32_t *values, uint8_t mode)
+{
+    uint32_t faults;
+    uint8_t i;
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        uint16_t raw = channel_state[mode][i].raw;
+        bool out_of_range = (raw < SELFTEST_RAW_MIN) || (raw > SELFTEST_RAW_MAX);
+        bool flagged = ((selftest_range[mode] >> i) & 1u) != 0u;
+
+        // count scans that disagree with the current state, flip after enough
+        if (out_of_range != flagged)
+        {
+            selftest_range_count[mode][i]++;
+            if (selftest_range_count[mode][i] >= SELFTEST_RANGE_SCANS)
+            {
+                SelfTest_SetBit(&selftest_range[mode], i, out_of_range);
+                selftest_range_count[mode][i] = 0;
+            }
+        }
+        else
+        {
+            selftest_range_count[mode][i] = 0;
+        }
+    }
+
+    faults = SelfTest_GetFaultMask();
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        // a faulty channel holds its last good value from this point of the
+        // pipeline, so the later stages see it once, like any other value
+        if ((faults >> i) & 1u)
+        {
+            values[i] = channel_state[mode][i].held;
+        }
+        else
+        {
+            channel_state[mode][i].held = values[i];
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: SelfTest_Service
+********************************************************************************
+* Summary:
+* Call once per scan cycle, after the last mode has been processed and before
+* the next scan is started. Runs a hardware test step every
+* SELFTEST_STEP_INTERVAL cycles and reports the bitmaps when needed.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void SelfTest_Service(void)
+{
+    selftest_cycle++;
+    if (selftest_cycle >= SELFTEST_STEP_INTERVAL)
+    {
+        selftest_cycle = 0;
+        SelfTest_RunStep();
+    }
+
+    selftest_report_cycle++;
+    if (!selftest_sent ||
+        (SelfTest_GetFaultMask() != selftest_reported) ||
+        (selftest_cmod_fault != selftest_cmod_reported) ||
+        (selftest_report_cycle >= SELFTEST_REPORT_CYCLES))
+    {
+        SelfTest_Report();
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: SelfTest_GetFaultMask
+********************************************************************************
+* Summary:
+* Returns the sensors currently flagged by any check.
+*
+* Parameters:
+* None
+*
+* Return:
+* Bitmap, bit n = top_plate sensor n.
+*******************************************************************************/
+uint32_t SelfTest_GetFaultMask(void)
+{
+    return selftest_open | selftest_short | SelfTest_RangeMask();
+}
+
+#endif /* SELF_TEST */
+
+
+/* [] END OF FILE */
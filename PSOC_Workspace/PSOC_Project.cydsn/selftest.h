@@ -0,0 +1,75 @@
+/*******************************************************************************
+* File Name: selftest.h
+*
+* Description: Background electrode self-test.
+*
+*              Two kinds of checks run while streaming:
+*
+*              - Hardware checks through the CapSense self-test library, one
+*                step in the gap between two scan cycles every
+*                SELFTEST_STEP_INTERVAL cycles, so their cost is spread thin:
+*                  short  sensor pin shorted to ground, supply or another pin
+*                  open   sensor capacitance below SELFTEST_CP_MIN_FF (broken
+*                         trace), or above SELFTEST_CP_MAX_FF
+*                  Cmod   modulator capacitor outside its range
+*              - A raw-count range check on every scan, which costs nothing
+*                extra: a sensor whose raw count stays outside
+*                SELFTEST_RAW_MIN..SELFTEST_RAW_MAX for SELFTEST_RANGE_SCANS
+*                scans of one mode is flagged, and cleared after as many good
+*                scans of that mode. The range bitmap is flagged in any mode.
+*
+*              The Self-test library must be enabled in the CapSense
+*              customizer (Advanced > Self-test), with the sensor short,
+*              sensor capacitance and external capacitor tests selected.
+*
+*              A faulty channel holds its last good value in the processed
+*              data, so downstream stages see it at rest. The fault bitmaps
+*              are sent as a FRAME_TYPE_FAULTS frame whenever they change and
+*              every SELFTEST_REPORT_CYCLES cycles:
+*                faults(u32) open(u32) short(u32) range(u32)
+*                cmod_fault(u8) cmod_pf(u16)
+*              bit n of a bitmap belongs to top_plate sensor n.
+*******************************************************************************/
+
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Scan cycles between two hardware test steps */
+#define SELFTEST_STEP_INTERVAL  (64u)
+
+/* Sensor capacitance window, in fF */
+#define SELFTEST_CP_MIN_FF      (3000u)
+#define SELFTEST_CP_MAX_FF      (45000u)
+
+/* Modulator capacitor window, in pF (2.2 nF fitted) */
+#define SELFTEST_CMOD_MIN_PF    (1800u)
+#define SELFTEST_CMOD_MAX_PF    (2600u)
+
+/* Raw count window; the upper limit sits just below full scale of the
+*  top_plate scan resolution (16 bits) */
+#define SELFTEST_RAW_MIN        (20u)
+#define SELFTEST_RAW_MAX        (65000u)
+#define SELFTEST_RANGE_SCANS    (8u)
+
+/* Cycles between repeated reports of unchanged bitmaps */
+#define SELFTEST_REPORT_CYCLES  (1024u)
+
+#define SELFTEST_PAYLOAD_SIZE   (19u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void     SelfTest_ProcessScan(int32_t *values, uint8_t mode);
+void     SelfTest_Service(void);
+uint32_t SelfTest_GetFaultMask(void);
+
+#endif /* SELFTEST_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,104 @@
+/*******************************************************************************
+* File Name: sensor_config.h
+*
+* Description: Single place that sets the electrode count, the scan modes and
+*              the layout of every data structure and output frame derived
+*              from them. All loop bounds and array sizes in the firmware come
+*              from here, so a board variant only changes this file (and the
+*              top_plate widget in the CapSense customizer) and every loop
+*              gets a constant trip count the compiler can unroll.
+*
+*              The same numbers are sent to the host at start-up in a
+*              FRAME_TYPE_LAYOUT frame (see SENSOR_LAYOUT_DESCRIPTOR), so
+*              host decoders do not hard-code them either.
+*******************************************************************************/
+
+#ifndef SENSOR_CONFIG_H
+#define SENSOR_CONFIG_H
+
+/*******************************************************************************
+* Board variant
+*******************************************************************************/
+/* Number of top_plate electrodes. Must be even (pairs are packed together). */
+#define SENSOR_COUNT            (8u)
+
+/* Scan modes alternated by mode_flag: 2 = normal + shear, 1 = normal only */
+#define SENSOR_MODE_COUNT       (2u)
+
+#define SENSOR_MODE_NORMAL      (0u)
+#define SENSOR_MODE_SHEAR       (1u)
+#define SENSOR_MODE_LAST        (SENSOR_MODE_COUNT - 1u)
+
+/*******************************************************************************
+* Derived layout
+*******************************************************************************/
+/* Samples in one full frame: every sensor in every mode (VISUALIZATION_MODE) */
+#define SENSOR_FRAME_SAMPLES    (SENSOR_COUNT * SENSOR_MODE_COUNT)
+
+/* CALIBRATION_MODE rows: one per sensor, with these columns */
+#define CALIB_COL_TIME          (0u)    /* ticks since previous sensor scan */
+#define CALIB_COL_MODE          (1u)
+#define CALIB_COL_SENSOR        (2u)
+#define CALIB_COL_VALUE         (3u)    /* filtered count */
+#if defined(ADAPTIVE_FILTER)
+#define CALIB_COL_WINDOW        (4u)    /* scans in the averaging window */
+#define CALIB_NUM_COLUMNS       (5u)
+#elif defined(RATE_ESTIMATOR)
+#define CALIB_COL_RATE          (4u)    /* counts per second */
+#define CALIB_NUM_COLUMNS       (5u)
+#else
+#define CALIB_NUM_COLUMNS       (4u)
+#endif
+
+/* Values per CSV line and lines per published scan, for the host decoder.
+*  CONTACT_LOCALIZATION sends FRAME_TYPE_CONTACT frames instead of lines. */
+#if defined(CONTACT_LOCALIZATION)
+#define SENSOR_STREAM_FORMAT    (3u)
+#define SENSOR_LINE_VALUES      (0u)
+#define SENSOR_LINES_PER_SCAN   (0u)
+#elif defined(CALIBRATION_MODE)
+#define SENSOR_STREAM_FORMAT    (1u)
+#define SENSOR_LINE_VALUES      (CALIB_NUM_COLUMNS)
+#define SENSOR_LINES_PER_SCAN   (SENSOR_COUNT)
+#elif defined(VISUALIZATION_MODE)
+#define SENSOR_STREAM_FORMAT    (2u)
+#ifdef RATE_ESTIMATOR
+#define SENSOR_LINE_VALUES      (2u * SENSOR_FRAME_SAMPLES)    /* values, then rates */
+#else
+#define SENSOR_LINE_VALUES      (SENSOR_FRAME_SAMPLES)
+#endif
+#define SENSOR_LINES_PER_SCAN   (1u)
+#else
+#define SENSOR_STREAM_FORMAT    (0u)
+#define SENSOR_LINE_VALUES      (0u)
+#define SENSOR_LINES_PER_SCAN   (0u)
+#endif
+
+/* Longest CSV line: "\n", values of up to 11 characters plus separators, "\r",
+*  terminating zero. Sizes host-side line buffers. */
+#define SENSOR_LINE_MAX_CHARS   ((SENSOR_LINE_VALUES * 12u) + 3u)
+
+/* Payload of the FRAME_TYPE_LAYOUT frame:
+*  version, sensors, modes, stream format, values per line, lines per scan */
+#define SENSOR_LAYOUT_VERSION   (1u)
+#define SENSOR_LAYOUT_SIZE      (6u)
+#define SENSOR_LAYOUT_DESCRIPTOR { SENSOR_LAYOUT_VERSION, SENSOR_COUNT, SENSOR_MODE_COUNT, \
+                                   SENSOR_STREAM_FORMAT, SENSOR_LINE_VALUES, SENSOR_LINES_PER_SCAN }
+
+/*******************************************************************************
+* Consistency checks
+*******************************************************************************/
+#if ((SENSOR_COUNT % 2u) != 0u) || (SENSOR_COUNT > 32u)
+#error "SENSOR_COUNT must be even and at most 32"
+#endif
+#if (SENSOR_MODE_COUNT < 1u) || (SENSOR_MODE_COUNT > 2u)
+#error "SENSOR_MODE_COUNT must be 1 or 2"
+#endif
+#if defined(CapSense_TOP_PLATE_NUM_SENSORS) && (CapSense_TOP_PLATE_NUM_SENSORS != SENSOR_COUNT)
+#error "SENSOR_COUNT does not match the top_plate widget in the CapSense customizer"
+#endif
+
+#endif /* SENSOR_CONFIG_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,225 @@
+/*******************************************************************************
+* File Name: slip.c
+*
+* Description: Shear-to-normal ratio and micro-vibration slip detector.
+*              See slip.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "slip.h"
+#include "baseline.h"
+#include "frame.h"
+#include "tx.h"
+
+#include <stdbool.h>
+
+#ifdef SLIP_DETECTION
+
+#if ((FRAME_OVERHEAD + SLIP_PAYLOAD_SIZE) >= TX_PRIORITY_SIZE)
+#error "A slip alert does not fit the priority queue (TX_PRIORITY_SIZE)"
+#endif
+
+static int32_t  slip_normal_sum = 0;        /* normal signal of the last normal scan */
+
+/* Shear values of the two previous shear scans, for the second difference */
+static uint16_t slip_history[2][SENSOR_COUNT];
+static uint8_t  slip_history_scans = 0;
+
+static uint32_t slip_floor = 0;             /* vibration noise floor */
+static uint8_t  slip_vib_scans = 0;         /* consecutive scans above it */
+static uint8_t  slip_reported = 0;          /* SLIP_FLAG_* sent in the last alert */
+static uint8_t  slip_hold = 0;              /* shear scans until the alert is cleared */
+
+
+/*******************************************************************************
+* Function Name: Slip_Send
+********************************************************************************
+* Summary:
+* Sends a FRAME_TYPE_SLIP frame in the priority lane.
+*
+* Parameters:
+* flags: SLIP_FLAG_* seen, 0 to clear the alert.
+* shear_sum: Shear signal of the scan.
+* energy: Vibration energy of the scan.
+* sensor: Taxel with the most shear.
+*
+* Return:
+* None
+*******************************************************************************/
+static void Slip_Send(uint8_t flags, int32_t shear_sum, uint32_t energy, uint8_t sensor)
+{
+    uint32_t ratio = 0xFFFFu;
+
+    // sent when a flag is first seen and when the alert clears, a few times
+    // per slip: a 32-bit library divide (~100 cycles) against the ~1.5 ms the
+    // frame takes on the wire
+    if (slip_normal_sum > 0)
+    {
+        ratio = ((uint32_t)shear_sum << 8) / (uint32_t)slip_normal_sum;
+        if (ratio > 0xFFFFu)
+        {
+            ratio = 0xFFFFu;
+        }
+    }
+
+    Tx_BeginPriority();
+    Frame_Begin(FRAME_TYPE_SLIP, SLIP_PAYLOAD_SIZE);
+    Frame_PutByte(flags);
+    Frame_PutU16((uint16_t)ratio);
+    Frame_PutU32(energy);
+    Frame_PutU32(slip_floor);
+    Frame_PutByte(sensor);
+    Frame_End();
+}
+
+
+/*******************************************************************************
+* Function Name: Slip_Scan
+********************************************************************************
+* Summary:
+* Takes the normal signal from a normal scan, and checks a shear scan for
+* slip, sending or clearing the alert.
+*
+* Parameters:
+* values: SENSOR_COUNT values of the scan, in counts.
+* mode: Mode of the scan.
+*
+* Return:
+* None
+*******************************************************************************/
+void Slip_Scan(const int32_t *values, uint8_t mode)
+{
+    int32_t  shear_sum = 0;
+    int32_t  shear_peak = -1;
+    uint32_t energy = 0u;
+    uint8_t  sensor = 0u;
+    uint8_t  flags = 0u;
+    bool     contact;
+    uint8_t  i;
+
+    if (mode == SENSOR_MODE_NORMAL)
+    {
+        slip_normal_sum = 0;
+        for (i = 0; i < SENSOR_COUNT; i++)
+        {
+            int32_t s = values[i] - Baseline_Get(mode, i);
+            slip_normal_sum += (s > 0) ? s : 0;
+        }
+        return;
+    }
+
+    for (i = 0; i < SENSOR_COUNT; i++)
+    {
+        int32_t  s = values[i] - Baseline_Get(mode, i);
+        uint16_t v = (values[i] < 0) ? 0u : ((values[i] > 0xFFFF) ? 0xFFFFu : (uint16_t)values[i]);
+
+        s = (s < 0) ? -s : s;
+        shear_sum += s;
+        if (s > shear_peak)
+        {
+            shear_peak = s;
+            sensor = i;
+        }
+
+        if (slip_history_scans >= 2u)
+        {
+            int32_t d2 = (int32_t)v - (2 * (int32_t)slip_history[1][i]) + (int32_t)slip_history[0][i];
+
+            d2 = (d2 > SLIP_DIFF_LIMIT) ? SLIP_DIFF_LIMIT : ((d2 < -SLIP_DIFF_LIMIT) ? -SLIP_DIFF_LIMIT : d2);
+            energy += (uint32_t)(d2 * d2);
+        }
+        slip_history[0][i] = slip_history[1][i];
+        slip_history[1][i] = v;
+    }
+
+    // the first energy seeds the floor
+    if (slip_history_scans < 3u)
+    {
+        slip_history_scans++;
+        slip_floor = energy;
+        return;
+    }
+
+    contact = (slip_normal_sum >= SLIP_CONTACT_MIN);
+
+    if (contact && ((shear_sum << 8) >= (SLIP_RATIO_Q8 * slip_normal_sum)))
+    {
+        flags |= SLIP_FLAG_RATIO;
+    }
+
+    if ((energy > SLIP_VIB_MIN) && ((energy >> SLIP_VIB_FACTOR_SHIFT) > slip_floor))
+    {
+        if (slip_vib_scans < SLIP_VIB_SCANS)
+        {
+            slip_vib_scans++;
+        }
+        if (contact && (slip_vib_scans >= SLIP_VIB_SCANS))
+        {
+            flags |= SLIP_FLAG_VIBRATION;
+        }
+    }
+    else
+    {
+        slip_vib_scans = 0u;
+    }
+
+    // the floor follows the energy while there is no alert, too slowly to
+    // learn a burst of a few scans
+    if (slip_hold == 0u)
+    {
+        if (energy > slip_floor)
+        {
+            slip_floor += (energy - slip_floor) >> SLIP_FLOOR_SHIFT;
+        }
+        else
+        {
+            slip_floor -= (slip_floor - energy) >> SLIP_FLOOR_SHIFT;
+        }
+    }
+
+    if (flags != 0u)
+    {
+        slip_hold = SLIP_HOLD_SCANS;
+        if ((flags & (uint8_t)~slip_reported) != 0u)
+        {
+            slip_reported |= flags;
+            Slip_Send(slip_reported, shear_sum, energy, sensor);
+        }
+    }
+    else if (slip_hold > 0u)
+    {
+        slip_hold--;
+        if (slip_hold == 0u)
+        {
+            slip_reported = 0u;
+            Slip_Send(0u, shear_sum, energy, sensor);
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Slip_Reset
+********************************************************************************
+* Summary:
+* Forgets the scan history and noise floor, for a step in the counts that is
+* not a movement (a change of scan method). An alert in progress is cleared
+* as usual once its hold time runs out.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Slip_Reset(void)
+{
+    slip_normal_sum = 0;
+    slip_history_scans = 0u;
+    slip_vib_scans = 0u;
+}
+
+#endif /* SLIP_DETECTION */
+
+
+/* [] END OF FILE */
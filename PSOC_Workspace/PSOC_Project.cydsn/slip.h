@@ -0,0 +1,86 @@
+/*******************************************************************************
+* File Name: slip.h
+*
+* Description: Incipient slip detection on the shear scans.
+*
+*              Two signs of an object starting to slide are watched, both
+*              gated on contact (normal signal, summed over the array, of at
+*              least SLIP_CONTACT_MIN counts):
+*                ratio      the shear signal summed over the array reaches
+*                           SLIP_RATIO_Q8 of the normal signal: the grip is
+*                           close to the friction limit. Checked on every
+*                           shear scan, so it alerts one cycle after the load
+*                           gets there.
+*                vibration  the micro-vibration of stick-slip: the energy of
+*                           the second difference of the shear channels from
+*                           scan to scan, which ignores steady loading ramps,
+*                           exceeds 2^SLIP_VIB_FACTOR_SHIFT times its noise
+*                           floor for SLIP_VIB_SCANS shear scans in a row (a
+*                           press step lasts two). The floor follows the
+*                           energy slowly while there is no alert.
+*              Signals are measured from the per-mode baselines (baseline.h).
+*
+*              An alert is sent at once as a FRAME_TYPE_SLIP frame in the
+*              priority lane of the transmit queue (tx.h), ahead of the data
+*              still waiting, and again with flags 0 when neither sign has
+*              been seen for SLIP_HOLD_SCANS shear scans:
+*                flags(u8) ratio_q8(u16) energy(u32) floor(u32) sensor(u8)
+*              flags holds SLIP_FLAG_*, ratio_q8 the shear-to-normal ratio
+*              (256 = 1.0, saturated), energy and floor the vibration
+*              measure in counts^2, sensor the taxel with the most shear.
+*
+*              The thresholds depend on the skin and the object surface;
+*              tune SLIP_RATIO_Q8 to a little below the measured ratio at
+*              which slip starts.
+*******************************************************************************/
+
+#ifndef SLIP_H
+#define SLIP_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+#if defined(SLIP_DETECTION) && (SENSOR_MODE_COUNT != 2u)
+#error "SLIP_DETECTION compares the shear and normal modes and needs both"
+#endif
+
+/* Normal signal, in counts over the whole array, that counts as contact */
+#define SLIP_CONTACT_MIN        (200)
+
+/* Shear-to-normal ratio that raises the ratio alert, Q8 (154 = 0.6) */
+#define SLIP_RATIO_Q8           (154)
+
+/* Vibration alert: energy above 2^SLIP_VIB_FACTOR_SHIFT times the floor, and
+*  above SLIP_VIB_MIN, for SLIP_VIB_SCANS shear scans in a row */
+#define SLIP_VIB_FACTOR_SHIFT   (3u)
+#define SLIP_VIB_MIN            (64u)
+#define SLIP_VIB_SCANS          (3u)
+
+/* Noise floor tracking speed: 1/2^N of the difference per shear scan */
+#define SLIP_FLOOR_SHIFT        (7u)
+
+/* Second differences are clipped to this, so the energy of up to 32 sensors
+*  fits 32 bits */
+#define SLIP_DIFF_LIMIT         (8191)
+
+/* Shear scans without either sign before the alert is cleared */
+#define SLIP_HOLD_SCANS         (16u)
+
+#define SLIP_FLAG_RATIO         (0x01u)
+#define SLIP_FLAG_VIBRATION     (0x02u)
+
+#define SLIP_PAYLOAD_SIZE       (12u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void Slip_Scan(const int32_t *values, uint8_t mode);
+void Slip_Reset(void);
+
+#endif /* SLIP_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,360 @@
+/*******************************************************************************
+* File Name: timesync.c
+*
+* Description: Host clock model and the board side of the sync exchange.
+*              See timesync.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "timesync.h"
+#include "frame.h"
+
+#include <stdbool.h>
+
+#ifdef TIME_SYNC
+
+/* Host clock model: host time at anchor_ticks, and host us per tick (Q16) */
+static uint32_t sync_anchor_ticks = 0;
+static uint32_t sync_anchor_us = 0;
+static uint32_t sync_rate_q16 = TIMESYNC_US_PER_TICK_Q16;
+
+static uint8_t  sync_state = TIMESYNC_FREE;
+static uint16_t sync_min_delay_us = 0xFFFFu;
+static int16_t  sync_residual_us = 0;
+
+/* Accepted exchanges the model is fitted to, oldest first from fit_first */
+static uint32_t fit_ticks[TIMESYNC_FIT_POINTS];
+static uint32_t fit_us[TIMESYNC_FIT_POINTS];
+static uint8_t  fit_first = 0;
+static uint8_t  fit_count = 0;
+
+/* Exchange waiting for the host receive time t4 */
+static bool     sync_pending = false;
+static uint8_t  sync_pending_seq;
+static uint32_t sync_pending_t1;            /* host us */
+static uint32_t sync_pending_t2;            /* ticks */
+static uint32_t sync_pending_t3;            /* ticks */
+
+
+/*******************************************************************************
+* Function Name: TimeSync_GetU32
+********************************************************************************
+* Summary:
+* Reads a little-endian 32-bit field of a payload.
+*
+* Parameters:
+* data: First byte of the field.
+*
+* Return:
+* Field value.
+*******************************************************************************/
+static uint32_t TimeSync_GetU32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_Map
+********************************************************************************
+* Summary:
+* Converts a board time to host time with the current model.
+*
+* Parameters:
+* ticks: Clock_Now() time.
+*
+* Return:
+* Host time in us.
+*******************************************************************************/
+static uint32_t TimeSync_Map(uint32_t ticks)
+{
+    int32_t since = (int32_t)(ticks - sync_anchor_ticks);
+
+    return sync_anchor_us + (uint32_t)(int32_t)(((int64_t)since * sync_rate_q16) >> 16);
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_AddPoint
+********************************************************************************
+* Summary:
+* Appends an exchange to the fit, dropping the oldest point when the buffer is
+* full and every point older than TIMESYNC_FIT_SPAN_TICKS.
+*
+* Parameters:
+* ticks: Board midpoint of the exchange.
+* host_us: Host midpoint of the exchange.
+*
+* Return:
+* None
+*******************************************************************************/
+static void TimeSync_AddPoint(uint32_t ticks, uint32_t host_us)
+{
+    uint8_t slot;
+
+    if (fit_count == TIMESYNC_FIT_POINTS)
+    {
+        fit_first = (uint8_t)((fit_first + 1u) % TIMESYNC_FIT_POINTS);
+        fit_count--;
+    }
+    slot = (uint8_t)((fit_first + fit_count) % TIMESYNC_FIT_POINTS);
+    fit_ticks[slot] = ticks;
+    fit_us[slot] = host_us;
+    fit_count++;
+
+    while ((ticks - fit_ticks[fit_first]) > TIMESYNC_FIT_SPAN_TICKS)
+    {
+        fit_first = (uint8_t)((fit_first + 1u) % TIMESYNC_FIT_POINTS);
+        fit_count--;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_Fit
+********************************************************************************
+* Summary:
+* Fits the model to the buffered exchanges by least squares and anchors it at
+* the newest one. The fit is done relative to the newest point and to the
+* nominal rate, so the sums stay within 64 bits over the whole span.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+static void TimeSync_Fit(void)
+{
+    uint8_t  newest = (uint8_t)((fit_first + fit_count - 1u) % TIMESYNC_FIT_POINTS);
+    int64_t  sx = 0;
+    int64_t  sy = 0;
+    int64_t  sxx = 0;
+    int64_t  sxy = 0;
+    int64_t  n = fit_count;
+    int64_t  den;
+    int64_t  num;
+    int32_t  slope_q16 = 0;
+    uint8_t  i;
+
+    for (i = 0u; i < fit_count; i++)
+    {
+        uint8_t slot = (uint8_t)((fit_first + i) % TIMESYNC_FIT_POINTS);
+        int32_t x = (int32_t)(fit_ticks[slot] - fit_ticks[newest]);
+        int32_t y = (int32_t)(fit_us[slot] - fit_us[newest]) -
+                    (int32_t)(((int64_t)x * TIMESYNC_US_PER_TICK_Q16) >> 16);
+
+        sx += x;
+        sy += y;
+        sxx += (int64_t)x * x;
+        sxy += (int64_t)x * y;
+    }
+
+    // slope = num / den in Q16, split so num * 65536 cannot overflow
+    den = (n * sxx) - (sx * sx);
+    num = (n * sxy) - (sx * sy);
+    if (den > 0)
+    {
+        slope_q16 = (int32_t)(((num / den) * 65536) + (((num % den) * 65536) / den));
+    }
+    if (slope_q16 > (int32_t)TIMESYNC_RATE_LIMIT_Q16)
+    {
+        slope_q16 = (int32_t)TIMESYNC_RATE_LIMIT_Q16;
+    }
+    else if (slope_q16 < -(int32_t)TIMESYNC_RATE_LIMIT_Q16)
+    {
+        slope_q16 = -(int32_t)TIMESYNC_RATE_LIMIT_Q16;
+    }
+
+    sync_anchor_ticks = fit_ticks[newest];
+    sync_anchor_us = fit_us[newest] + (uint32_t)(int32_t)((sy - ((slope_q16 * sx) >> 16)) / n);
+    if (fit_count > 1u)
+    {
+        sync_rate_q16 = (uint32_t)((int32_t)TIMESYNC_US_PER_TICK_Q16 + slope_q16);
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_Sample
+********************************************************************************
+* Summary:
+* Filters one complete exchange by its round-trip delay and refits the model
+* with it.
+*
+* Parameters:
+* t1: Host time the PING was sent, us.
+* t2: Board time the PING was parsed, ticks.
+* t3: Board time the PONG was queued, ticks.
+* t4: Host time the PONG was received, us.
+*
+* Return:
+* None
+*******************************************************************************/
+static void TimeSync_Sample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4)
+{
+    uint32_t hold_us = (uint32_t)(((uint64_t)(t3 - t2) * sync_rate_q16) >> 16);
+    int32_t  delay = (int32_t)(t4 - t1) - (int32_t)hold_us;
+    uint32_t mid_ticks = t2 + ((t3 - t2) >> 1);
+    uint32_t mid_us = t1 + ((t4 - t1) >> 1);
+    int32_t  residual;
+
+    if (delay < 0)
+    {
+        delay = 0;  /* board tick granularity */
+    }
+    if (delay > 0xFFFF)
+    {
+        return;
+    }
+
+    // the fastest recent exchange sets the bar
+    if (sync_min_delay_us <= (0xFFFFu - TIMESYNC_DELAY_AGING_US))
+    {
+        sync_min_delay_us += TIMESYNC_DELAY_AGING_US;
+    }
+    if ((uint16_t)delay < sync_min_delay_us)
+    {
+        sync_min_delay_us = (uint16_t)delay;
+    }
+    if ((uint32_t)delay > (uint32_t)sync_min_delay_us + TIMESYNC_DELAY_MARGIN_US)
+    {
+        return;
+    }
+
+    residual = (int32_t)(mid_us - TimeSync_Map(mid_ticks));
+
+    if ((sync_state == TIMESYNC_FREE) ||
+        (residual > TIMESYNC_STEP_US) || (residual < -TIMESYNC_STEP_US))
+    {
+        fit_count = 0u;     /* start over */
+        residual = 0;
+    }
+    else if ((int32_t)(mid_ticks - sync_anchor_ticks) <= 0)
+    {
+        return;             /* not newer than the last point */
+    }
+    TimeSync_AddPoint(mid_ticks, mid_us);
+    TimeSync_Fit();
+
+    sync_residual_us = (residual > INT16_MAX) ? INT16_MAX :
+                       ((residual < INT16_MIN) ? INT16_MIN : (int16_t)residual);
+    sync_state = (fit_count >= TIMESYNC_LOCK_POINTS) ? TIMESYNC_LOCKED : TIMESYNC_ACQUIRING;
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_OnPing
+********************************************************************************
+* Summary:
+* Handles a SYNC_PING: completes the previous exchange with the host receive
+* time it carries, and answers with a SYNC_PONG.
+*
+* Parameters:
+* payload: PING payload.
+* length: Payload length.
+* rx_time: Clock_Now() time at which the PING was parsed (t2).
+*
+* Return:
+* None
+*******************************************************************************/
+void TimeSync_OnPing(const uint8_t *payload, uint8_t length, uint32_t rx_time)
+{
+    uint8_t  seq;
+    uint32_t t1;
+    uint32_t prev_t4;
+    uint32_t t3;
+
+    if (length != TIMESYNC_PING_SIZE)
+    {
+        return;
+    }
+    seq = payload[0];
+    t1 = TimeSync_GetU32(&payload[1]);
+    prev_t4 = TimeSync_GetU32(&payload[6]);
+
+    if (sync_pending && (prev_t4 != 0u) && (payload[5] == sync_pending_seq))
+    {
+        TimeSync_Sample(sync_pending_t1, sync_pending_t2, sync_pending_t3, prev_t4);
+    }
+
+    t3 = Clock_Now();
+
+    Frame_Begin(FRAME_TYPE_SYNC_PONG, TIMESYNC_PONG_SIZE);
+    Frame_PutByte(seq);
+    Frame_PutU32(TimeSync_Map(t3));
+    Frame_PutU16((uint16_t)sync_residual_us);
+    Frame_PutU16(sync_min_delay_us);
+    Frame_PutByte(sync_state);
+    Frame_End();
+
+    sync_pending = true;
+    sync_pending_seq = seq;
+    sync_pending_t1 = t1;
+    sync_pending_t2 = rx_time;
+    sync_pending_t3 = t3;
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_Now
+********************************************************************************
+* Summary:
+* Returns the synchronized time.
+*
+* Parameters:
+* None
+*
+* Return:
+* Host time in us; time since reset while TIMESYNC_FREE.
+*******************************************************************************/
+uint32_t TimeSync_Now(void)
+{
+    return TimeSync_Map(Clock_Now());
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_GetState
+********************************************************************************
+* Summary:
+* Returns the sync state (TIMESYNC_FREE ... TIMESYNC_LOCKED).
+*
+* Parameters:
+* None
+*
+* Return:
+* Sync state.
+*******************************************************************************/
+uint8_t TimeSync_GetState(void)
+{
+    return sync_state;
+}
+
+
+/*******************************************************************************
+* Function Name: TimeSync_SendStamp
+********************************************************************************
+* Summary:
+* Sends a TIMESTAMP frame with the synchronized time, to be followed by the
+* data it stamps.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void TimeSync_SendStamp(void)
+{
+    Frame_Begin(FRAME_TYPE_TIMESTAMP, TIMESYNC_STAMP_SIZE);
+    Frame_PutU32(TimeSync_Now());
+    Frame_PutByte(sync_state);
+    Frame_End();
+}
+
+#endif /* TIME_SYNC */
+
+
+/* [] END OF FILE */
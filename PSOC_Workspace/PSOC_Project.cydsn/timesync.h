@@ -0,0 +1,101 @@
+/*******************************************************************************
+* File Name: timesync.h
+*
+* Description: Synchronization of the board clock to the host clock.
+*
+*              Every board runs its own My_Time counter from the on-chip
+*              oscillator, so boards drift apart by up to a few percent. The
+*              host pings each board a few times per second and the board
+*              models the host clock as
+*                host_us = anchor_us + rate * (ticks - anchor_ticks)
+*              which it refines with every exchange (NTP-style, four
+*              timestamps):
+*                t1  host sends PING           (host us, in the PING)
+*                t2  board parses PING         (Clock_Now() ticks)
+*                t3  board queues PONG         (Clock_Now() ticks)
+*                t4  host receives PONG        (host us, in the next PING)
+*              The host midpoint (t1 + t4) / 2 and the board midpoint
+*              (t2 + t3) / 2 are the same instant, give or take the path
+*              asymmetry. PING and PONG have the same length so both
+*              directions spend the same time on the wire.
+*
+*              An exchange is used only when its round-trip delay is within
+*              TIMESYNC_DELAY_MARGIN_US of the smallest delay seen recently:
+*              exchanges delayed by USB latency, a full transmit buffer or a
+*              slow main loop pass are dropped. The model is a least-squares
+*              line through the recent accepted exchanges, anchored at the
+*              newest: the slope follows the oscillator drift and the jitter
+*              of single exchanges averages out. A line fit rather than a
+*              tracking loop, because on a jittery link only a few exchanges
+*              pass the delay filter and a loop tuned for the regular case
+*              then rings.
+*
+*              Frames:
+*                SYNC_PING  host -> board  seq(u8) t1(u32) prev_seq(u8)
+*                                          prev_t4(u32)
+*                           prev_* describe the last PONG the host received;
+*                           prev_t4 = 0 when there is none.
+*                SYNC_PONG  board -> host  seq(u8) now(u32) residual(i16)
+*                                          min_delay(u16) state(u8)
+*                           now is the synchronized time at t3, residual the
+*                           correction of the last accepted exchange, in us.
+*                TIMESTAMP  board -> host  time(u32) state(u8)
+*                           synchronized time of the data that follows
+*              All times are host microseconds modulo 2^32.
+*******************************************************************************/
+
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include <stdint.h>
+#include "globals.h"
+#include "clock.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Nominal host microseconds per Clock_Now() tick, Q16 */
+#define TIMESYNC_US_PER_TICK_Q16    ((uint32_t)((1000000ull << 16) / CLOCK_HZ))
+/* The oscillator is trimmed to +/-2 %; the rate estimate stays within 4 % */
+#define TIMESYNC_RATE_LIMIT_Q16     (TIMESYNC_US_PER_TICK_Q16 / 25u)
+
+/* Delay filter: accepted exchanges are at most this much slower than the
+*  fastest recent one, whose delay ages upward by TIMESYNC_DELAY_AGING_US per
+*  exchange so a lasting change of the link is adopted */
+#define TIMESYNC_DELAY_MARGIN_US    (400u)
+#define TIMESYNC_DELAY_AGING_US     (25u)
+
+/* Model fit: the last TIMESYNC_FIT_POINTS accepted exchanges, none older than
+*  TIMESYNC_FIT_SPAN_TICKS, so a change of oscillator temperature is followed
+*  within a minute. 8 bytes of SRAM per point. */
+#define TIMESYNC_FIT_POINTS         (32u)
+#define TIMESYNC_FIT_SPAN_TICKS     (60u * CLOCK_HZ)
+
+/* Locked once the fit holds this many points */
+#define TIMESYNC_LOCK_POINTS        (8u)
+
+/* A residual beyond this restarts the fit (host clock reset, long gap) */
+#define TIMESYNC_STEP_US            (50000)
+
+/* Payload sizes */
+#define TIMESYNC_PING_SIZE          (10u)
+#define TIMESYNC_PONG_SIZE          (10u)
+#define TIMESYNC_STAMP_SIZE         (5u)
+
+/* Sync states */
+#define TIMESYNC_FREE               (0u)    /* no exchange yet: time since reset */
+#define TIMESYNC_ACQUIRING          (1u)
+#define TIMESYNC_LOCKED             (2u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+void     TimeSync_OnPing(const uint8_t *payload, uint8_t length, uint32_t rx_time);
+uint32_t TimeSync_Now(void);
+uint8_t  TimeSync_GetState(void);
+void     TimeSync_SendStamp(void);
+
+#endif /* TIMESYNC_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,208 @@
+/*******************************************************************************
+* File Name: tx.c
+*
+* Description: Bulk and priority transmit queues in front of the UART FIFO.
+*              See tx.h.
+*******************************************************************************/
+
+#include "project.h"
+#include "tx.h"
+
+#include <stdbool.h>
+
+#ifdef TX_PRIORITY_QUEUE
+
+#if ((TX_BULK_SIZE & (TX_BULK_SIZE - 1u)) != 0u) || ((TX_PRIORITY_SIZE & (TX_PRIORITY_SIZE - 1u)) != 0u) || \
+    ((TX_BULK_MESSAGES & (TX_BULK_MESSAGES - 1u)) != 0u)
+#error "TX_BULK_SIZE, TX_PRIORITY_SIZE and TX_BULK_MESSAGES must be powers of two"
+#endif
+
+/* Read and write positions run freely and are masked on access */
+static uint8_t  tx_bulk[TX_BULK_SIZE];
+static uint16_t tx_bulk_read = 0;
+static uint16_t tx_bulk_write = 0;
+
+/* Write positions at which queued bulk messages end */
+static uint16_t tx_bulk_ends[TX_BULK_MESSAGES];
+static uint8_t  tx_ends_read = 0;
+static uint8_t  tx_ends_write = 0;
+
+static uint8_t  tx_priority[TX_PRIORITY_SIZE];
+static uint16_t tx_priority_read = 0;
+static uint16_t tx_priority_write = 0;
+static uint16_t tx_priority_end = 0;        /* end of the last complete message */
+static bool     tx_priority_overflow = false;   /* the message being written did not fit */
+static uint16_t tx_priority_dropped = 0;    /* messages discarded for that, saturating */
+
+static bool     tx_at_boundary = true;      /* no bulk message is half sent */
+static bool     tx_in_priority = false;     /* the message being written is priority */
+
+
+/*******************************************************************************
+* Function Name: Tx_Service
+********************************************************************************
+* Summary:
+* Moves queued bytes into the UART until its FIFO is full: priority messages
+* first whenever the bulk stream is between messages.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Tx_Service(void)
+{
+    while (UART_SpiUartGetTxBufferSize() < UART_FIFO_SIZE)
+    {
+        if ((tx_ends_read != tx_ends_write) &&
+            (tx_bulk_read == tx_bulk_ends[tx_ends_read & (TX_BULK_MESSAGES - 1u)]))
+        {
+            // the bulk message in progress is complete
+            tx_ends_read++;
+            tx_at_boundary = true;
+        }
+        else if (tx_at_boundary && (tx_priority_read != tx_priority_end))
+        {
+            UART_SpiUartWriteTxData(tx_priority[tx_priority_read & (TX_PRIORITY_SIZE - 1u)]);
+            tx_priority_read++;
+        }
+        else if (tx_bulk_read != tx_bulk_write)
+        {
+            UART_SpiUartWriteTxData(tx_bulk[tx_bulk_read & (TX_BULK_SIZE - 1u)]);
+            tx_bulk_read++;
+            tx_at_boundary = false;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Tx_PutByte
+********************************************************************************
+* Summary:
+* Queues one byte of the current message, waiting for room if needed.
+*
+* Parameters:
+* value: Byte to send.
+*
+* Return:
+* None
+*******************************************************************************/
+void Tx_PutByte(uint8_t value)
+{
+    if (tx_in_priority)
+    {
+        while ((uint16_t)(tx_priority_write - tx_priority_read) >= TX_PRIORITY_SIZE)
+        {
+            if (tx_priority_read == tx_priority_end)
+            {
+                // longer than the queue: discarded whole by Tx_EndMessage
+                tx_priority_overflow = true;
+                return;
+            }
+            Tx_Service();
+        }
+        tx_priority[tx_priority_write & (TX_PRIORITY_SIZE - 1u)] = value;
+        tx_priority_write++;
+    }
+    else
+    {
+        while ((uint16_t)(tx_bulk_write - tx_bulk_read) >= TX_BULK_SIZE)
+        {
+            Tx_Service();
+        }
+        tx_bulk[tx_bulk_write & (TX_BULK_SIZE - 1u)] = value;
+        tx_bulk_write++;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: Tx_BeginPriority
+********************************************************************************
+* Summary:
+* Sends the next message in the priority queue.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Tx_BeginPriority(void)
+{
+    tx_in_priority = true;
+}
+
+
+/*******************************************************************************
+* Function Name: Tx_EndMessage
+********************************************************************************
+* Summary:
+* Marks the end of the current message, which makes it a boundary a priority
+* message may be sent at, and starts transmitting.
+*
+* Parameters:
+* None
+*
+* Return:
+* None
+*******************************************************************************/
+void Tx_EndMessage(void)
+{
+    if (tx_in_priority)
+    {
+        if (tx_priority_overflow)
+        {
+            // nothing of it has been sent: the UART stops at tx_priority_end
+            tx_priority_write = tx_priority_end;
+            tx_priority_overflow = false;
+            if (tx_priority_dropped < 0xFFFFu)
+            {
+                tx_priority_dropped++;
+            }
+        }
+        tx_priority_end = tx_priority_write;
+        tx_in_priority = false;
+    }
+    else
+    {
+        while ((uint8_t)(tx_ends_write - tx_ends_read) >= TX_BULK_MESSAGES)
+        {
+            Tx_Service();
+        }
+        tx_bulk_ends[tx_ends_write & (TX_BULK_MESSAGES - 1u)] = tx_bulk_write;
+        tx_ends_write++;
+    }
+    Tx_Service();
+}
+
+
+
+/*******************************************************************************
+* Function Name: Tx_GetPriorityDropped
+********************************************************************************
+* Summary:
+* Returns the number of priority messages discarded because they were longer
+* than the priority queue.
+*
+* Parameters:
+* None
+*
+* Return:
+* Messages discarded since start-up, saturating at 0xFFFF.
+*******************************************************************************/
+uint16_t Tx_GetPriorityDropped(void)
+{
+    return tx_priority_dropped;
+}
+
+#endif /* TX_PRIORITY_QUEUE */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,66 @@
+/*******************************************************************************
+* File Name: tx.h
+*
+* Description: UART transmit path with a priority lane.
+*
+*              Every message the firmware sends (CSV line or binary frame)
+*              goes through Tx_PutByte and ends with Tx_EndMessage. Without
+*              TX_PRIORITY_QUEUE these are the plain UART writes.
+*
+*              With TX_PRIORITY_QUEUE, messages wait in one of two queues and
+*              Tx_Service feeds the UART FIFO from them, keeping no more than
+*              the FIFO in the UART component:
+*                bulk      the data stream, TX_BULK_SIZE bytes
+*                priority  alerts, TX_PRIORITY_SIZE bytes; a message written
+*                          after Tx_BeginPriority
+*              A priority message overtakes everything still waiting in the
+*              bulk queue, but only at a message boundary: the bulk message
+*              being transmitted is finished first, so the host parser never
+*              sees a frame or line cut in two. An alert then leaves within
+*              one bulk message plus the FIFO, however much data is queued.
+*
+*              Writers block while their queue is full, servicing the UART
+*              meanwhile, as they did on the UART component's buffer. The
+*              main loop calls Tx_Service on every pass so the FIFO keeps
+*              running between messages.
+*******************************************************************************/
+
+#ifndef TX_H
+#define TX_H
+
+#include <stdint.h>
+#include "globals.h"
+
+/*******************************************************************************
+* MACRO Definitions
+*******************************************************************************/
+/* Queue sizes in bytes; powers of two up to 256. A priority message must be
+*  shorter than TX_PRIORITY_SIZE; a longer one is discarded whole and counted
+*  (Tx_GetPriorityDropped), never sent cut short. */
+#define TX_BULK_SIZE            (128u)
+#define TX_PRIORITY_SIZE        (32u)
+
+/* Complete bulk messages the queue can hold */
+#define TX_BULK_MESSAGES        (16u)
+
+/*****************************************************************************
+* Function Prototypes
+*****************************************************************************/
+#ifdef TX_PRIORITY_QUEUE
+void Tx_PutByte(uint8_t value);
+void Tx_EndMessage(void);
+void Tx_BeginPriority(void);
+void Tx_Service(void);
+uint16_t Tx_GetPriorityDropped(void);
+#else
+#define Tx_PutByte(value)       UART_SpiUartWriteTxData((uint32)(value))
+#define Tx_EndMessage()         do { } while (0)
+#define Tx_BeginPriority()      do { } while (0)
+#define Tx_Service()            do { } while (0)
+#define Tx_GetPriorityDropped() (0u)
+#endif
+
+#endif /* TX_H */
+
+
+/* [] END OF FILE */